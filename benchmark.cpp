@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define GAME_OF_LIFE_BENCHMARK_FORK // run each benchmark in a child process, so peak memory is its own
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "src/Automaton.h"
+
+// Runs Automaton::tick over a set of standard workloads and prints how fast each went as JSON, for tracking
+// regressions across engine changes. Usage: game_of_life_benchmark [--threads N] [--only NAME]...
+
+namespace { // local to this file
+  // One workload: an automaton, some cells and how long to run it.
+  struct Benchmark {
+    std::string name;
+    std::string topology; // for the report
+    std::function<Topology*()> makeTopology;
+    std::function<NeighbourhoodType*()> makeNeighbourhoodType;
+    std::string rule;
+    std::function<void(Automaton&)> populate;
+    long long generations;
+    Automaton::Engine engine;
+  };
+  
+  // What came of running one.
+  struct Result {
+    long long generations = 0;
+    double seconds = 0;
+    double cellUpdates = 0; // cells in the chunks (or the whole grid, or HashLife's steps) ticked, summed
+    long long chunks = 0; // at the end
+    long long peakChunks = 0;
+    long long population = 0; // at the end
+    long long peakMemory = -1; // bytes, or -1 if we can't tell
+  };
+  
+  // Set the cells marked 'O' in rows, with the top-left at (x, y).
+  void place(Automaton& automaton, const std::vector<std::string>& rows, int x, int y) {
+    for (int dy = 0; dy < (int) rows.size(); dy++) {
+      for (int dx = 0; dx < (int) rows[dy].size(); dx++) {
+        if (rows[dy][dx] == 'O') {
+          automaton.setCell(x + dx, y + dy, true);
+        }
+      }
+    }
+  }
+  
+  const std::vector<std::string> R_PENTOMINO = {
+      ".OO",
+      "OO.",
+      ".O."};
+  const std::vector<std::string> ACORN = {
+      ".O.....",
+      "...O...",
+      "OO..OOO"};
+  const std::vector<std::string> GOSPER_GLIDER_GUN = {
+      "........................O...........",
+      "......................O.O...........",
+      "............OO......OO............OO",
+      "...........O...O....OO............OO",
+      "OO........O.....O...OO..............",
+      "OO........O...O.OO....O.O...........",
+      "..........O.....O.......O...........",
+      "...........O...O....................",
+      "............OO......................"};
+  const std::vector<std::string> GLIDER = {
+      ".O.",
+      "..O",
+      "OOO"};
+  
+  // Fill a width by height block of cells with the top-left at (x, y), each alive with probability density.
+  void soup(Automaton& automaton, int x, int y, int width, int height, double density) {
+    std::mt19937 random(20200101); // the same soup every run
+    std::bernoulli_distribution alive(density);
+    for (int dy = 0; dy < height; dy++) {
+      for (int dx = 0; dx < width; dx++) {
+        if (alive(random)) {
+          automaton.setCell(x + dx, y + dy, true);
+        }
+      }
+    }
+  }
+  
+  // Make a rule string with births for counts in [bornMin, bornMax] and survival for [surviveMin, surviveMax].
+  std::string rangeRule(unsigned int bornMin, unsigned int bornMax, unsigned int surviveMin, unsigned int surviveMax) {
+    std::string rule = "B";
+    for (unsigned int count = bornMin; count <= bornMax; count++) {
+      rule += std::to_string(count) + (count < bornMax ? "," : "");
+    }
+    rule += "/S";
+    for (unsigned int count = surviveMin; count <= surviveMax; count++) {
+      rule += std::to_string(count) + (count < surviveMax ? "," : "");
+    }
+    return rule;
+  }
+  
+  std::vector<Benchmark> benchmarks() {
+    auto unbounded = [] () -> Topology* { return new UnboundedTopology; };
+    auto fixed = [] () -> Topology* { return new FixedTopology(16, 16); };
+    auto wrapping = [] () -> Topology* { return new WrappingTopology(16, 16); };
+    auto moore1 = [] () -> NeighbourhoodType* { return new MooreNeighbourhoodType(1); };
+    const Automaton::Engine chunks = Automaton::Engine::CHUNKS, hashLife = Automaton::Engine::HASHLIFE,
+        grid = Automaton::Engine::GRID;
+    
+    auto pattern = [] (const std::vector<std::string>& rows) {
+      return [&rows] (Automaton& automaton) { place(automaton, rows, 0, 0); };
+    };
+    auto halfSoup = [] (Automaton& automaton) { soup(automaton, 0, 0, 16 * CHUNK_SIZE, 16 * CHUNK_SIZE, 0.5); };
+    auto gliderField = [] (Automaton& automaton) {
+      // 20 by 20 gliders, 50 cells apart, all heading the same way so they never meet
+      for (int y = 0; y < 20; y++) {
+        for (int x = 0; x < 20; x++) {
+          place(automaton, GLIDER, x * 50, y * 50);
+        }
+      }
+    };
+    
+    return {
+        {"r_pentomino", "unbounded", unbounded, moore1, "B3/S23", pattern(R_PENTOMINO), 1103, chunks},
+        {"acorn", "unbounded", unbounded, moore1, "B3/S23", pattern(ACORN), 5206, chunks},
+        {"gosper_glider_gun", "unbounded", unbounded, moore1, "B3/S23", pattern(GOSPER_GLIDER_GUN), 2000, chunks},
+        {"gosper_glider_gun_wrapping", "wrapping 16x16", wrapping, moore1, "B3/S23", pattern(GOSPER_GLIDER_GUN), 2000,
+            chunks},
+        {"gosper_glider_gun_wrapping_grid", "wrapping 16x16", wrapping, moore1, "B3/S23", pattern(GOSPER_GLIDER_GUN),
+            2000, grid},
+        {"gosper_glider_gun_hashlife", "unbounded", unbounded, moore1, "B3/S23", pattern(GOSPER_GLIDER_GUN), 2000,
+            hashLife},
+        {"random_soup_fixed", "fixed 16x16", fixed, moore1, "B3/S23", halfSoup, 500, chunks},
+        {"random_soup_fixed_grid", "fixed 16x16", fixed, moore1, "B3/S23", halfSoup, 500, grid},
+        {"random_soup_wrapping", "wrapping 16x16", wrapping, moore1, "B3/S23", halfSoup, 500, chunks},
+        {"random_soup_wrapping_grid", "wrapping 16x16", wrapping, moore1, "B3/S23", halfSoup, 500, grid},
+        {"random_soup_unbounded", "unbounded", unbounded, moore1, "B3/S23", halfSoup, 500, chunks},
+        {"glider_field", "unbounded", unbounded, moore1, "B3/S23", gliderField, 500, chunks},
+        // Bosco's rule, a well-known Larger than Life rule on the radius 5 Moore neighbourhood (120 cells)
+        {"moore_radius_5", "wrapping 16x16", wrapping, [] () -> NeighbourhoodType* {
+          return new MooreNeighbourhoodType(5);
+        }, rangeRule(34, 45, 33, 57), halfSoup, 100, chunks},
+        // The radius 5 von Neumann neighbourhood has 60 cells; this keeps a soup churning
+        {"von_neumann_radius_5", "wrapping 16x16", wrapping, [] () -> NeighbourhoodType* {
+          return new VonNeumannNeighbourhoodType(5);
+        }, rangeRule(17, 21, 15, 30), halfSoup, 100, chunks},
+    };
+  }
+  
+  // Get the engine's name, for the report.
+  const char* engineName(Automaton::Engine engine) {
+    switch (engine) {
+      case Automaton::Engine::HASHLIFE:
+        return "hashlife";
+      case Automaton::Engine::GRID:
+        return "grid";
+      case Automaton::Engine::CHUNKS:
+      default:
+        return "chunks";
+    }
+  }
+  
+  // Get the peak resident memory of this process so far, in bytes, or -1 if we can't tell.
+  long long peakMemory() {
+#ifdef GAME_OF_LIFE_BENCHMARK_FORK
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+      return -1;
+    }
+#if defined(__APPLE__) && defined(__MACH__)
+    return (long long) usage.ru_maxrss; // macOS counts bytes
+#else
+    return (long long) usage.ru_maxrss * 1024; // and Linux counts kilobytes
+#endif
+#else
+    return -1;
+#endif
+  }
+  
+  Result run(const Benchmark& benchmark, unsigned int threads) {
+    Automaton automaton(benchmark.makeTopology(), benchmark.makeNeighbourhoodType());
+    automaton.ruleset().setRules(benchmark.rule);
+    automaton.setThreadCount(threads);
+    benchmark.populate(automaton);
+    automaton.setEngine(benchmark.engine);
+    
+    // The grid ticks every cell on the board, and looking at its chunks would make it copy its cells out every tick.
+    // Neither does HashLife keep its chunks up to date, so it's counted by the cells it actually steps instead
+    bool onGrid = benchmark.engine == Automaton::Engine::GRID;
+    bool onHashLife = benchmark.engine == Automaton::Engine::HASHLIFE;
+    double boardCells = (double) automaton.topology().width() * automaton.topology().height() * CHUNK_SIZE * CHUNK_SIZE;
+    TickProfiler profiler;
+    if (onHashLife) {
+      automaton.setProfiler(&profiler);
+    }
+    
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    if (onHashLife) {
+      // Leap by each power of two in the count, as game_of_life_cli does
+      for (unsigned int bit = 0; bit <= HashLife::MAX_LOG2_STEP; bit++) {
+        if (benchmark.generations >> bit & 1) {
+          automaton.jump(bit);
+        }
+      }
+    } else {
+      for (long long generation = 0; generation < benchmark.generations; generation++) {
+        if (onGrid) {
+          result.cellUpdates += boardCells;
+        } else {
+          long long chunks = (long long) automaton.chunkArray().size();
+          result.cellUpdates += (double) chunks * CHUNK_SIZE * CHUNK_SIZE;
+          result.peakChunks = std::max(result.peakChunks, chunks);
+        }
+        automaton.tick();
+      }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    automaton.setProfiler(nullptr);
+    for (const TickProfiler::Tick& tick : profiler.ticks()) {
+      result.cellUpdates += (double) tick.counters.cellsEvaluated;
+    }
+    result.generations = benchmark.generations;
+    result.chunks = (long long) automaton.chunkArray().size();
+    result.peakChunks = std::max(result.peakChunks, result.chunks);
+    result.population = automaton.population();
+    result.peakMemory = peakMemory();
+    return result;
+  }
+  
+  // Run the benchmark in a child process if we can, so the peak memory is for it alone.
+  Result runIsolated(const Benchmark& benchmark, unsigned int threads) {
+#ifdef GAME_OF_LIFE_BENCHMARK_FORK
+    int fds[2];
+    if (pipe(fds) != 0) {
+      throw std::runtime_error("Cannot make a pipe to the benchmark process");
+    }
+    std::cout.flush();
+    pid_t child = fork();
+    if (child < 0) {
+      throw std::runtime_error("Cannot fork a benchmark process");
+    }
+    if (child == 0) {
+      close(fds[0]);
+      Result result = run(benchmark, threads);
+      ssize_t written = write(fds[1], &result, sizeof(result));
+      _exit(written == (ssize_t) sizeof(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(fds[1]);
+    Result result;
+    ssize_t got = 0;
+    while (got < (ssize_t) sizeof(result)) {
+      ssize_t count = read(fds[0], reinterpret_cast<char*>(&result) + got, sizeof(result) - got);
+      if (count <= 0) break;
+      got += count;
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (got != (ssize_t) sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      throw std::runtime_error("Benchmark " + benchmark.name + " failed");
+    }
+    return result;
+#else
+    return run(benchmark, threads);
+#endif
+  }
+  
+  // Quote and escape a string for JSON; ours never need more than the quotes, but just in case.
+  std::string quote(const std::string& string) {
+    std::string quoted = "\"";
+    for (char c : string) {
+      if (c == '"' || c == '\\') quoted += '\\';
+      quoted += c;
+    }
+    return quoted + '"';
+  }
+}
+
+int main(int argc, char* argv[]) {
+  unsigned int threads = 1;
+  std::vector<std::string> only;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if ((arg == "--threads" || arg == "--only") && i + 1 < argc) {
+      std::string value = argv[++i];
+      if (arg == "--threads") {
+        threads = (unsigned int) std::strtoul(value.c_str(), nullptr, 10);
+      } else {
+        only.push_back(value);
+      }
+    } else {
+      std::cerr << "Usage: game_of_life_benchmark [--threads N] [--only NAME]...\n";
+      return EXIT_FAILURE;
+    }
+  }
+  
+  std::ostringstream json;
+  json.precision(6);
+  json << "{\n  \"chunk_size\": " << CHUNK_SIZE << ",\n  \"threads\": " << threads << ",\n  \"benchmarks\": [";
+  bool first = true;
+  try {
+    for (const Benchmark& benchmark : benchmarks()) {
+      if (!only.empty() && std::find(only.begin(), only.end(), benchmark.name) == only.end()) {
+        continue;
+      }
+      std::cerr << "Running " << benchmark.name << "...\n";
+      Result result = runIsolated(benchmark, threads);
+      double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+      json << (first ? "\n" : ",\n") << "    {"
+           << "\"name\": " << quote(benchmark.name)
+           << ", \"topology\": " << quote(benchmark.topology)
+           << ", \"rule\": " << quote(benchmark.rule)
+           << ", \"engine\": " << quote(engineName(benchmark.engine))
+           << ", \"generations\": " << result.generations
+           << ", \"wall_time_s\": " << result.seconds
+           << ", \"generations_per_second\": " << (double) result.generations / seconds
+           << ", \"cells_per_second\": " << result.cellUpdates / seconds
+           << ", \"chunks\": " << result.chunks
+           << ", \"peak_chunks\": " << result.peakChunks
+           << ", \"population\": " << result.population
+           << ", \"peak_memory_bytes\": " << result.peakMemory << "}";
+      first = false;
+    }
+  } catch (std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+  json << "\n  ]\n}\n";
+  std::cout << json.str();
+  return EXIT_SUCCESS;
+}
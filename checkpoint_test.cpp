@@ -0,0 +1,316 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/Automaton.h"
+#include "src/Checkpoint.h"
+#include "src/util.h"
+#include "test_helpers.h"
+
+// Saves automata which have just been stepped on each engine, without looking at their cells first, and checks that
+// restoring them gives back the same cells, generation, rules, neighbourhood and topology, and that loading regions of
+// a checkpoint loads exactly the stored chunks inside them, and that truncated and corrupt checkpoints are refused.
+// Usage: game_of_life_checkpoint_test
+
+namespace { // local to this file
+  const char* const PATH = "game_of_life_checkpoint_test.ckpt"; // in the working directory, removed at the end
+  
+  // One save and restore to check.
+  struct Case {
+    std::string name;
+    Shape shape;
+    bool vonNeumann; // otherwise Moore
+    int radius;
+    std::string rule;
+    Automaton::Engine engine;
+  };
+  
+  // Step a soup a few generations on the case's engine, save it straight away and restore it. Return whether the
+  // restored automaton has the same cells and generation, and goes on to the same next generations.
+  bool checkRestore(const Case& run, unsigned int seed) {
+    std::unique_ptr<Automaton> automaton(new Automaton(makeTopology(run.shape),
+        makeNeighbourhoodType(run.vonNeumann, run.radius)));
+    automaton->ruleset().setRules(run.rule);
+    automaton->setEngine(run.engine);
+    
+    // Unbounded soups go over negative coordinates too
+    std::mt19937 random(seed);
+    const bool unbounded = run.shape == Shape::UNBOUNDED;
+    const int width = TEST_WIDTH * CHUNK_SIZE, height = TEST_HEIGHT * CHUNK_SIZE, left = unbounded ? -width / 2 : 0,
+        top = unbounded ? -height / 2 : 0;
+    for (int i = 0; i < 1500; i++) {
+      automaton->setCell(left + (int) (random() % width), top + (int) (random() % height), true);
+    }
+    automaton->jump(3);
+    
+    Checkpoint::save(PATH, *automaton);
+    Checkpoint checkpoint(PATH);
+    std::unique_ptr<Automaton> restored(checkpoint.restore());
+    
+    if (checkpoint.generation() != 8 || restored->generation() != 8) {
+      std::cout << "  restored at generation " << restored->generation() << ", not 8\n";
+      return false;
+    }
+    if (checkpoint.population() != automaton->population() || restored->population() != automaton->population()) {
+      std::cout << "  restored with a population of " << restored->population() << ", not "
+                << automaton->population() << "\n";
+      return false;
+    }
+    if (restored->ruleset().getRuleString() != automaton->ruleset().getRuleString()) {
+      std::cout << "  restored with the rule " << restored->ruleset().getRuleString() << "\n";
+      return false;
+    }
+    const Cells cells = liveCells(*automaton);
+    if (cells.empty() || liveCells(*restored) != cells) {
+      std::cout << "  the restored cells don't match the saved ones\n";
+      return false;
+    }
+    
+    // The neighbourhood and topology only show in what comes next
+    for (int generation = 0; generation < 5; generation++) {
+      automaton->tick();
+      restored->tick();
+    }
+    if (liveCells(*restored) != liveCells(*automaton)) {
+      std::cout << "  the restored automaton went somewhere else from the saved one\n";
+      return false;
+    }
+    return true;
+  }
+  
+  // Save scattered chunks and load regions of them, some with edges between the stored chunks and one with none in
+  // it. Return whether each region loaded just the stored chunks inside it.
+  bool checkRegions() {
+    const std::vector<int> columns = {-7, -3, 0, 4, 9}, rows = {-6, -1, 2, 8}; // in chunks
+    Automaton automaton(new UnboundedTopology, new MooreNeighbourhoodType(1));
+    for (int chunkY : rows) {
+      for (int chunkX : columns) {
+        // A different shape in each, so a chunk loaded in the wrong place shows
+        automaton.setCell(chunkX * CHUNK_SIZE + (chunkY & 7), chunkY * CHUNK_SIZE + 1, true);
+        automaton.setCell(chunkX * CHUNK_SIZE + 3, chunkY * CHUNK_SIZE + (chunkX & 15), true);
+      }
+    }
+    const Cells all = liveCells(automaton);
+    Checkpoint::save(PATH, automaton);
+    Checkpoint checkpoint(PATH);
+    if (checkpoint.chunkCount() != columns.size() * rows.size()) {
+      std::cout << "  " << checkpoint.chunkCount() << " chunks stored, not " << columns.size() * rows.size() << "\n";
+      return false;
+    }
+    
+    struct Region {
+      int left, top, right, bottom;
+    };
+    const Region regions[] = {
+        {-100, -100, 100, 100}, // everything
+        {-5, -4, 6, 5}, // every edge between stored chunks
+        {-3, -1, 4, 2}, // every edge on stored chunks
+        {1, -100, 3, 100}, // between two columns, so nothing
+        {-100, 3, 100, 7}, // between two rows, so nothing
+        {9, 8, 9, 8}, // the last chunk alone
+        {4, 2, 3, 2}, // backwards, so nothing
+    };
+    for (const Region& region : regions) {
+      Automaton loaded(new UnboundedTopology, new MooreNeighbourhoodType(1));
+      std::size_t count = checkpoint.loadRegion(loaded, region.left, region.top, region.right, region.bottom);
+      
+      Cells expected;
+      for (const auto& cell : all) {
+        int chunkX = floorDiv(cell.first, CHUNK_SIZE), chunkY = floorDiv(cell.second, CHUNK_SIZE);
+        if (chunkX >= region.left && chunkX <= region.right && chunkY >= region.top && chunkY <= region.bottom) {
+          expected.insert(cell);
+        }
+      }
+      std::size_t expectedCount = 0;
+      for (int chunkY : rows) {
+        for (int chunkX : columns) {
+          if (chunkX >= region.left && chunkX <= region.right && chunkY >= region.top && chunkY <= region.bottom) {
+            expectedCount++;
+          }
+        }
+      }
+      
+      if (count != expectedCount || liveCells(loaded) != expected) {
+        std::cout << "  the region (" << region.left << ", " << region.top << ") to (" << region.right << ", "
+                  << region.bottom << ") loaded " << count << " chunks, not " << expectedCount
+                  << (liveCells(loaded) != expected ? ", and the wrong cells" : "") << "\n";
+        return false;
+      }
+    }
+    return true;
+  }
+  
+  // Save over a checkpoint which is already there, and return whether the new one replaced it.
+  bool checkSaveOver() {
+    Automaton automaton(new UnboundedTopology, new MooreNeighbourhoodType(1));
+    automaton.setCell(0, 0, true);
+    Checkpoint::save(PATH, automaton);
+    automaton.setCell(1, 0, true);
+    automaton.setGeneration(5);
+    Checkpoint::save(PATH, automaton);
+    
+    Checkpoint checkpoint(PATH);
+    if (checkpoint.generation() != 5 || checkpoint.population() != 2) {
+      std::cout << "  the first checkpoint is still there\n";
+      return false;
+    }
+    return true;
+  }
+  
+  // Return whether opening a file which isn't a checkpoint, or isn't there, throws.
+  bool checkBadFiles() {
+    {
+      std::ofstream file(PATH, std::ios::binary);
+      file << "x = 3, y = 1, rule = B3/S23\n3o!\n";
+    }
+    try {
+      Checkpoint checkpoint(PATH);
+      std::cout << "  opened a pattern file as a checkpoint\n";
+      return false;
+    } catch (std::invalid_argument&) {}
+    
+    std::remove(PATH);
+    try {
+      Checkpoint checkpoint(PATH);
+      std::cout << "  opened a file which isn't there\n";
+      return false;
+    } catch (std::runtime_error&) {}
+    return true;
+  }
+  
+  // Where the fields of a checkpoint's header are, in bytes from the start of the file (see Checkpoint::Header)
+  const std::size_t BYTE_ORDER_AT = 8, VERSION_AT = 12, CHUNK_SIZE_AT = 16, NEIGHBOURHOOD_AT = 20, RADIUS_AT = 24,
+      TOPOLOGY_AT = 28, WIDTH_AT = 32, HEIGHT_AT = 36, RULE_COUNT_AT = 56, CHUNK_COUNT_AT = 64, INDEX_OFFSET_AT = 72,
+      ROWS_OFFSET_AT = 80, HEADER_SIZE = 88;
+  
+  template<typename T>
+  T getField(const std::string& bytes, std::size_t at) {
+    T value;
+    std::memcpy(&value, bytes.data() + at, sizeof value);
+    return value;
+  }
+  
+  template<typename T>
+  std::string withField(std::string bytes, std::size_t at, T value) {
+    std::memcpy(&bytes[at], &value, sizeof value);
+    return bytes;
+  }
+  
+  // Save a soup on the fixed board and return whether every truncation, extension and corruption of its header which
+  // would let loading a chunk read past the end of the file, or make an automaton which can't run, is refused when the
+  // checkpoint is opened.
+  bool checkCorruptFiles() {
+    Automaton automaton(makeTopology(Shape::FIXED), new MooreNeighbourhoodType(1));
+    std::mt19937 random(7);
+    for (int i = 0; i < 200; i++) {
+      automaton.setCell((int) (random() % (TEST_WIDTH * CHUNK_SIZE)), (int) (random() % (TEST_HEIGHT * CHUNK_SIZE)),
+          true);
+    }
+    Checkpoint::save(PATH, automaton);
+    std::string bytes;
+    {
+      std::ifstream file(PATH, std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    
+    // If these are wrong, so is every case below
+    const auto chunkCount = getField<std::uint64_t>(bytes, CHUNK_COUNT_AT);
+    const auto indexOffset = getField<std::uint64_t>(bytes, INDEX_OFFSET_AT);
+    const auto rowsOffset = getField<std::uint64_t>(bytes, ROWS_OFFSET_AT);
+    const auto ruleCount = getField<std::uint64_t>(bytes, RULE_COUNT_AT);
+    const std::uint64_t chunkBytes = CHUNK_SIZE * sizeof(std::uint32_t);
+    if (getField<std::uint32_t>(bytes, CHUNK_SIZE_AT) != CHUNK_SIZE || getField<std::int32_t>(bytes, RADIUS_AT) != 1
+        || getField<std::int32_t>(bytes, WIDTH_AT) != TEST_WIDTH || ruleCount != 9 || chunkCount == 0
+        || rowsOffset + chunkCount * chunkBytes != bytes.size()) {
+      std::cout << "  the header isn't laid out as this test expects\n";
+      return false;
+    }
+    
+    const std::uint64_t huge = std::uint64_t(1) << 62u;
+    const std::pair<std::string, std::string> corruptions[] = {
+        {"cut off by a byte", bytes.substr(0, bytes.size() - 1)},
+        {"cut off by a chunk", bytes.substr(0, bytes.size() - chunkBytes)},
+        {"cut off after the header", bytes.substr(0, HEADER_SIZE)},
+        {"cut off in the header", bytes.substr(0, HEADER_SIZE / 2)},
+        {"longer than its chunks", bytes + std::string(chunkBytes, '\0')},
+        {"in the other byte order", withField<std::uint32_t>(bytes, BYTE_ORDER_AT, 0x04030201)},
+        {"from another version", withField<std::uint32_t>(bytes, VERSION_AT, 2)},
+        {"with another chunk size", withField<std::uint32_t>(bytes, CHUNK_SIZE_AT, CHUNK_SIZE + 1)},
+        {"with an unknown neighbourhood", withField<std::uint32_t>(bytes, NEIGHBOURHOOD_AT, 2)},
+        {"with a radius of 0", withField<std::int32_t>(bytes, RADIUS_AT, 0)},
+        {"with a negative radius", withField<std::int32_t>(bytes, RADIUS_AT, -1)},
+        {"with too big a radius", withField<std::int32_t>(bytes, RADIUS_AT, SummedAreaKernel::MAX_RADIUS + 1)},
+        {"with an unknown topology", withField<std::uint32_t>(bytes, TOPOLOGY_AT, 3)},
+        {"with a width of 0", withField<std::int32_t>(bytes, WIDTH_AT, 0)},
+        {"with a negative height", withField<std::int32_t>(bytes, HEIGHT_AT, -1)},
+        {"with more rules than bytes", withField<std::uint64_t>(bytes, RULE_COUNT_AT, bytes.size() + 1)},
+        {"with rules running into the index",
+         withField<std::uint64_t>(bytes, RULE_COUNT_AT, (indexOffset - HEADER_SIZE) / 2 + 1)},
+        {"with the index inside the rules", withField<std::uint64_t>(bytes, INDEX_OFFSET_AT, HEADER_SIZE)},
+        {"with the index out of alignment", withField<std::uint64_t>(bytes, INDEX_OFFSET_AT, indexOffset + 1)},
+        {"with the index past the end", withField<std::uint64_t>(bytes, INDEX_OFFSET_AT, bytes.size())},
+        {"with the rows moved on", withField<std::uint64_t>(bytes, ROWS_OFFSET_AT, rowsOffset + 8)},
+        {"with the rows moved back", withField<std::uint64_t>(bytes, ROWS_OFFSET_AT, rowsOffset - 8)},
+        {"with a chunk too many", withField<std::uint64_t>(bytes, CHUNK_COUNT_AT, chunkCount + 1)},
+        {"with a chunk too few", withField<std::uint64_t>(bytes, CHUNK_COUNT_AT, chunkCount - 1)},
+        {"with a huge chunk count", withField<std::uint64_t>(bytes, CHUNK_COUNT_AT, huge)},
+    };
+    // Written back as it was, it still opens, so it's the corruptions which are refused and not the copying
+    {
+      std::ofstream file(PATH, std::ios::binary | std::ios::trunc);
+      file.write(bytes.data(), (std::streamsize) bytes.size());
+    }
+    try {
+      Checkpoint checkpoint(PATH);
+    } catch (std::exception& e) {
+      std::cout << "  couldn't open a copy of a checkpoint: " << e.what() << "\n";
+      return false;
+    }
+    
+    for (const auto& corruption : corruptions) {
+      {
+        std::ofstream file(PATH, std::ios::binary | std::ios::trunc);
+        file.write(corruption.second.data(), (std::streamsize) corruption.second.size());
+      }
+      try {
+        Checkpoint checkpoint(PATH);
+        std::cout << "  opened a checkpoint " << corruption.first << "\n";
+        return false;
+      } catch (std::invalid_argument&) {}
+    }
+    return true;
+  }
+  
+  std::vector<Case> cases() {
+    const Automaton::Engine chunks = Automaton::Engine::CHUNKS, grid = Automaton::Engine::GRID,
+        hashLife = Automaton::Engine::HASHLIFE;
+    return {
+        {"life_unbounded_chunks", Shape::UNBOUNDED, false, 1, "B3/S23", chunks},
+        {"life_unbounded_hashlife", Shape::UNBOUNDED, false, 1, "B3/S23", hashLife},
+        {"highlife_fixed_grid", Shape::FIXED, false, 1, "B36/S23", grid},
+        {"highlife_wrapping_grid", Shape::WRAPPING, false, 1, "B36/S23", grid},
+        {"moore2_fixed_chunks", Shape::FIXED, false, 2, "B6,7/S5,6,7,8", chunks},
+        {"von_neumann3_wrapping_chunks", Shape::WRAPPING, true, 3, "B3,4/S2,3,4,5", chunks},
+    };
+  }
+}
+
+int main() {
+  TestRunner runner;
+  runner.runCases(cases(), checkRestore);
+  runner.run("regions", checkRegions);
+  runner.run("save_over", checkSaveOver);
+  runner.run("bad_files", checkBadFiles);
+  runner.run("corrupt_files", checkCorruptFiles);
+  std::remove(PATH);
+  return runner.finish();
+}
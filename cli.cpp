@@ -0,0 +1,275 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "src/Automaton.h"
+#include "src/Checkpoint.h"
+#include "src/PatternIO.h"
+#include "src/TickProfiler.h"
+
+// A headless runner: load a pattern, run it for a number of generations as fast as possible without drawing
+// anything, and print the population, the generation rate and the wall time.
+
+namespace { // local to this file
+  const char* USAGE =
+      "Usage: game_of_life_cli [options] PATTERN\n"
+      "       game_of_life_cli [options] --resume CHECKPOINT\n"
+      "Run the RLE, Life 1.06 or Macrocell pattern (- for standard input), or carry on from a checkpoint, and print\n"
+      "its population, generation rate and wall time.\n"
+      "\n"
+      "Options:\n"
+      "  -g, --generations N      run N generations (default 1000)\n"
+      "  -r, --rule RULE          rules in B/S notation, like B3/S23 (default: the pattern's, or B3/S23)\n"
+      "  -n, --neighbourhood N    moore or vonneumann (default moore)\n"
+      "  -R, --radius R           the neighbourhood's radius, up to the chunk size (default 1)\n"
+      "  -T, --topology T         unbounded, fixed:WxH or wrapping:WxH, in chunks (default unbounded)\n"
+      "  -t, --threads N          threads to tick with; 0 is one per hardware thread (default 1)\n"
+      "      --hashlife           run on the HashLife engine\n"
+      "      --chunks             run on the chunks even in a fixed or wrapping topology, instead of on the grid\n"
+      "      --memo N             remember the next generations of up to N chunks, to copy into chunks which look\n"
+      "                           the same; 0 turns it off (default 4096)\n"
+      "  -o, --output FILE        write the final pattern to FILE, as Macrocell if it ends in .mc, Life 1.06 if it\n"
+      "                           ends in .lif or .life, and RLE otherwise\n"
+      "  -c, --checkpoint FILE    write a checkpoint of the final automaton to FILE\n"
+      "      --resume FILE        carry on from the checkpoint in FILE instead of running a pattern; its topology,\n"
+      "                           neighbourhood and rules are used unless --rule is given\n"
+      "      --trace FILE         write the last ticks' phase timings and counters to FILE as a Chrome trace\n"
+      "      --profile FILE       write every tick's phase timings and counters to FILE as CSV, as it goes\n"
+      "  -h, --help               print this and exit\n";
+  
+  struct Options {
+    std::string patternPath;
+    long long generations = 1000;
+    std::string rule; // empty for the pattern's
+    std::string neighbourhood = "moore";
+    int radius = 1;
+    std::string topology = "unbounded";
+    unsigned int threads = 1;
+    bool hashLife = false;
+    bool chunks = false;
+    std::size_t memo = ChunkMemo::DEFAULT_CAPACITY;
+    std::string outputPath; // empty for none
+    std::string checkpointPath; // empty for none
+    std::string resumePath; // empty to run a pattern
+    std::string tracePath; // empty for none
+    std::string profilePath; // empty for none
+  };
+  
+  // Parse a non-negative number out of an argument, throwing std::invalid_argument if it isn't one.
+  long long parseCount(const std::string& option, const std::string& value) {
+    std::size_t end = 0;
+    long long count = -1;
+    try {
+      count = std::stoll(value, &end);
+    } catch (std::exception&) {} // count stays -1
+    if (count < 0 || end != value.size()) {
+      throw std::invalid_argument(option + " needs a non-negative number, not \"" + value + "\"");
+    }
+    return count;
+  }
+  
+  // Parse the arguments into options. Return false if the help should be printed instead.
+  // Throw std::invalid_argument if they don't make sense.
+  bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      if (arg == "-h" || arg == "--help") {
+        return false;
+      }
+      if (arg == "--hashlife") {
+        options.hashLife = true;
+        continue;
+      }
+      if (arg == "--chunks") {
+        options.chunks = true;
+        continue;
+      }
+      if (arg.size() > 1 && arg[0] == '-') {
+        if (i + 1 == argc) {
+          throw std::invalid_argument(arg + " needs a value");
+        }
+        std::string value = argv[++i];
+        if (arg == "-g" || arg == "--generations") {
+          options.generations = parseCount(arg, value);
+        } else if (arg == "-r" || arg == "--rule") {
+          options.rule = value;
+        } else if (arg == "-n" || arg == "--neighbourhood") {
+          options.neighbourhood = value;
+        } else if (arg == "-R" || arg == "--radius") {
+          options.radius = (int) parseCount(arg, value); // the neighbourhood type checks it's one it can run
+        } else if (arg == "-T" || arg == "--topology") {
+          options.topology = value;
+        } else if (arg == "-t" || arg == "--threads") {
+          options.threads = (unsigned int) parseCount(arg, value);
+        } else if (arg == "--memo") {
+          options.memo = (std::size_t) parseCount(arg, value);
+        } else if (arg == "-o" || arg == "--output") {
+          options.outputPath = value;
+        } else if (arg == "-c" || arg == "--checkpoint") {
+          options.checkpointPath = value;
+        } else if (arg == "--resume") {
+          options.resumePath = value;
+        } else if (arg == "--trace") {
+          options.tracePath = value;
+        } else if (arg == "--profile") {
+          options.profilePath = value;
+        } else {
+          throw std::invalid_argument("Unknown option " + arg);
+        }
+      } else if (options.patternPath.empty()) {
+        options.patternPath = arg;
+      } else {
+        throw std::invalid_argument("Only one pattern can be run at a time");
+      }
+    }
+    if (options.patternPath.empty() == options.resumePath.empty()) {
+      throw std::invalid_argument(options.patternPath.empty() ? "No pattern given"
+          : "Give either a pattern or a checkpoint to resume, not both");
+    }
+    if (options.generations >> (HashLife::MAX_LOG2_STEP + 1) != 0) {
+      throw std::invalid_argument("That's too many generations");
+    }
+    return true;
+  }
+  
+  // Make the topology described by "unbounded", "fixed:WxH" or "wrapping:WxH".
+  Topology* makeTopology(const std::string& description) {
+    if (description == "unbounded") {
+      return new UnboundedTopology;
+    }
+    std::string::size_type colon = description.find(':'), x = description.find('x', colon);
+    if (colon != std::string::npos && x != std::string::npos) {
+      std::string kind = description.substr(0, colon);
+      int width = (int) parseCount("--topology", description.substr(colon + 1, x - colon - 1));
+      int height = (int) parseCount("--topology", description.substr(x + 1));
+      if (kind == "fixed") {
+        return new FixedTopology(width, height);
+      } else if (kind == "wrapping") {
+        return new WrappingTopology(width, height);
+      }
+    }
+    throw std::invalid_argument("Unknown topology \"" + description + "\"");
+  }
+  
+  NeighbourhoodType* makeNeighbourhoodType(const std::string& name, int radius) {
+    if (name == "moore") {
+      return new MooreNeighbourhoodType(radius);
+    } else if (name == "vonneumann") {
+      return new VonNeumannNeighbourhoodType(radius);
+    }
+    throw std::invalid_argument("Unknown neighbourhood \"" + name + "\"");
+  }
+  
+  // Make the automaton to run: the one in the checkpoint being resumed, or an empty one as the options describe.
+  Automaton* makeAutomaton(const Options& options) {
+    if (!options.resumePath.empty()) {
+      return Checkpoint(options.resumePath).restore();
+    }
+    return new Automaton(makeTopology(options.topology), makeNeighbourhoodType(options.neighbourhood, options.radius));
+  }
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  try {
+    if (!parseOptions(argc, argv, options)) {
+      std::cout << USAGE;
+      return EXIT_SUCCESS;
+    }
+  } catch (std::invalid_argument& e) {
+    std::cerr << e.what() << "\n\n" << USAGE;
+    return EXIT_FAILURE;
+  }
+  
+  try {
+    std::unique_ptr<Automaton> automatonOwner(makeAutomaton(options));
+    Automaton& automaton = *automatonOwner;
+    automaton.setThreadCount(options.threads);
+    automaton.setMemoCapacity(options.memo);
+    
+    std::string patternRule;
+    if (options.patternPath == "-") {
+      patternRule = PatternIO::read(std::cin, automaton).rule;
+    } else if (!options.patternPath.empty()) {
+      std::ifstream file(options.patternPath);
+      if (!file) {
+        throw std::invalid_argument("Cannot open " + options.patternPath);
+      }
+      patternRule = PatternIO::read(file, automaton).rule;
+    }
+    if (!options.rule.empty()) {
+      automaton.ruleset().setRules(options.rule);
+    } else if (options.resumePath.empty()) {
+      automaton.ruleset().setRules(!patternRule.empty() ? patternRule : "B3/S23");
+    }
+    if (options.hashLife) {
+      automaton.setEngine(Automaton::Engine::HASHLIFE);
+    } else if (options.chunks) {
+      automaton.setEngine(Automaton::Engine::CHUNKS);
+    }
+    
+    // Only profile if asked to, since counting costs a little
+    TickProfiler profiler;
+    std::ofstream profileFile;
+    if (!options.tracePath.empty() || !options.profilePath.empty()) {
+      automaton.setProfiler(&profiler);
+    }
+    if (!options.profilePath.empty()) {
+      profileFile.open(options.profilePath);
+      if (!profileFile) {
+        throw std::runtime_error("Cannot write " + options.profilePath);
+      }
+      profiler.setCsvOutput(&profileFile);
+    }
+    
+    // Jumping by each power of two in the count does the same work as ticking on the chunks or the grid, and lets
+    // HashLife leap
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int bit = 0; bit <= HashLife::MAX_LOG2_STEP; bit++) {
+      if (options.generations >> bit & 1) {
+        automaton.jump(bit);
+      }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    automaton.setProfiler(nullptr);
+    
+    std::cout << "generation: " << automaton.generation() << '\n'
+              << "population: " << automaton.population() << '\n'
+              << "chunks: " << automaton.chunkArray().size() << '\n'
+              << "wall time: " << seconds << " s\n"
+              << "rate: " << (seconds > 0 ? (double) options.generations / seconds : 0.0) << " generations/s\n";
+    
+    if (!options.outputPath.empty()) {
+      std::ofstream file(options.outputPath);
+      PatternIO::write(file, PatternIO::formatForFileName(options.outputPath), automaton);
+      if (!file) {
+        throw std::runtime_error("Cannot write " + options.outputPath);
+      }
+    }
+    if (!options.checkpointPath.empty()) {
+      Checkpoint::save(options.checkpointPath, automaton);
+    }
+    if (!options.tracePath.empty()) {
+      std::ofstream file(options.tracePath);
+      profiler.writeChromeTrace(file);
+      if (!file) {
+        throw std::runtime_error("Cannot write " + options.tracePath);
+      }
+    }
+    if (profileFile.is_open()) {
+      profiler.setCsvOutput(nullptr);
+      profileFile.close();
+      if (!profileFile) {
+        throw std::runtime_error("Cannot write " + options.profilePath);
+      }
+    }
+  } catch (std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/Automaton.h"
+#include "src/PatternIO.h"
+#include "test_helpers.h"
+
+// Writes patterns in every format out of automata which have just been stepped on each engine, without looking at their
+// cells first, reads them back into a fresh automaton and checks them cell by cell against the cells the automaton has
+// once it's looked at, and reads rules in the notations patterns use. Usage: game_of_life_pattern_io_test
+
+namespace { // local to this file
+  // One round trip to check.
+  struct Case {
+    std::string name;
+    Shape shape; // unbounded or fixed
+    Automaton::Engine engine;
+    PatternIO::Format format;
+  };
+  
+  // Step a vertical blinker once on engine, write it as Macrocell straight away and check that the file has the
+  // horizontal phase. Return whether it did.
+  bool checkMacrocellAfterStep(Topology* topology, Automaton::Engine engine) {
+    Automaton automaton(topology, new MooreNeighbourhoodType(1));
+    automaton.ruleset().setRules("B3/S23");
+    automaton.setEngine(engine);
+    for (int y = 0; y < 3; y++) {
+      automaton.setCell(1, y, true);
+    }
+    automaton.jump(0);
+    
+    std::stringstream file;
+    PatternIO::write(file, PatternIO::Format::MACROCELL, automaton);
+    Automaton read(new UnboundedTopology, new MooreNeighbourhoodType(1));
+    PatternIO::read(file, read);
+    
+    const Cells expected = {{0, 1}, {1, 1}, {2, 1}};
+    if (file.str().find("#G 1\n") == std::string::npos) {
+      std::cout << "  the file isn't marked as generation 1\n";
+      return false;
+    }
+    if (liveCells(read) != expected || liveCells(automaton) != expected) {
+      std::cout << "  the file doesn't have the generation it's marked as\n";
+      return false;
+    }
+    return true;
+  }
+  
+  // Step a soup a few generations on the case's engine, write it straight away in the case's format and read it back.
+  // Return whether the cells and the rule came back as they were.
+  bool checkRoundTrip(const Case& run, unsigned int seed) {
+    Automaton automaton(makeTopology(run.shape), new MooreNeighbourhoodType(1));
+    automaton.ruleset().setRules("B36/S23"); // HighLife, so the rule has to come back as it was
+    automaton.setEngine(run.engine);
+    
+    // Unbounded soups go over negative coordinates too, and over several chunks on the bounded board
+    std::mt19937 random(seed);
+    const bool unbounded = run.shape == Shape::UNBOUNDED;
+    const int width = TEST_WIDTH * CHUNK_SIZE, height = TEST_HEIGHT * CHUNK_SIZE, left = unbounded ? -width / 2 : 0,
+        top = unbounded ? -height / 2 : 0;
+    for (int i = 0; i < 1500; i++) {
+      automaton.setCell(left + (int) (random() % width), top + (int) (random() % height), true);
+    }
+    automaton.jump(3);
+    
+    std::stringstream file;
+    PatternIO::write(file, run.format, automaton);
+    Automaton read(new UnboundedTopology, new MooreNeighbourhoodType(1));
+    PatternIO::Info info = PatternIO::read(file, read);
+    
+    const Cells cells = liveCells(automaton);
+    if (cells.empty()) {
+      std::cout << "  the soup died out, so there was nothing to write\n";
+      return false;
+    }
+    if (info.format != run.format) {
+      std::cout << "  the file was read as the wrong format\n";
+      return false;
+    }
+    if (run.format != PatternIO::Format::LIFE_106 && info.rule != "B36/S23") {
+      std::cout << "  the rule came back as \"" << info.rule << "\"\n";
+      return false;
+    }
+    if (liveCells(read) != cells) {
+      std::cout << "  the cells read back don't match the automaton's\n";
+      return false;
+    }
+    return true;
+  }
+  
+  // Read patterns giving their rules in the older S/B notation, and in B/S notation, and return whether each rule came
+  // back in B/S notation and can be run.
+  bool checkRuleNotations() {
+    const std::pair<std::string, std::string> patterns[] = {
+        {"x = 3, y = 1, rule = 23/3\n3o!\n", "B3/S23"},
+        {"#r 23/36\nx = 3, y = 1\n3o!\n", "B36/S23"},
+        {"x = 3, y = 1, rule = /2\n3o!\n", "B2/S"}, // Seeds: nothing survives
+        {"x = 3, y = 1, rule = B3/S23\n3o!\n", "B3/S23"},
+        {"[M2] (golly)\n#R 23/3\n$$$$$$$.**$\n", "B3/S23"},
+    };
+    for (const auto& pattern : patterns) {
+      std::istringstream file(pattern.first);
+      Automaton automaton(new UnboundedTopology, new MooreNeighbourhoodType(1));
+      std::string rule = PatternIO::read(file, automaton).rule;
+      if (rule != pattern.second) {
+        std::cout << "  the rule was read as \"" << rule << "\", not \"" << pattern.second << "\"\n";
+        return false;
+      }
+      automaton.ruleset().setRules(rule);
+    }
+    return true;
+  }
+  
+  std::vector<Case> cases() {
+    const Automaton::Engine chunks = Automaton::Engine::CHUNKS, grid = Automaton::Engine::GRID,
+        hashLife = Automaton::Engine::HASHLIFE;
+    std::vector<Case> cases;
+    for (PatternIO::Format format : {PatternIO::Format::RLE, PatternIO::Format::LIFE_106,
+                                     PatternIO::Format::MACROCELL}) {
+      std::string name = format == PatternIO::Format::RLE ? "rle" : format == PatternIO::Format::LIFE_106
+          ? "life106" : "macrocell";
+      cases.push_back({name + "_unbounded_chunks", Shape::UNBOUNDED, chunks, format});
+      cases.push_back({name + "_fixed_chunks", Shape::FIXED, chunks, format});
+      cases.push_back({name + "_fixed_grid", Shape::FIXED, grid, format});
+      cases.push_back({name + "_unbounded_hashlife", Shape::UNBOUNDED, hashLife, format});
+    }
+    return cases;
+  }
+}
+
+int main() {
+  TestRunner runner;
+  runner.runCases(cases(), checkRoundTrip);
+  runner.run("macrocell_after_grid_step", [] {
+    return checkMacrocellAfterStep(new FixedTopology(4, 4), Automaton::Engine::GRID);
+  });
+  runner.run("macrocell_after_hashlife_step", [] {
+    return checkMacrocellAfterStep(new UnboundedTopology, Automaton::Engine::HASHLIFE);
+  });
+  runner.run("rule_notations", checkRuleNotations);
+  return runner.finish();
+}
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/Automaton.h"
+#include "test_helpers.h"
+
+// Runs the engines on random fields and checks them cell by cell, every generation, against a brute-force reference:
+// the chunks on any number of threads, with the memo on or off and replaying settled chunks, the grid and HashLife,
+// on each topology, with small and large radii, and across switches between engines, edits and rule changes.
+// Usage: game_of_life_reference_test
+
+namespace { // local to this file
+  struct Rules {
+    std::vector<bool> born, survives; // by the number of live neighbours
+  };
+  
+  // One run to check.
+  struct Case {
+    std::string name;
+    Shape shape;
+    bool vonNeumann; // otherwise Moore
+    unsigned int radius;
+    int generations;
+    unsigned int threads;
+    std::size_t memoCapacity;
+    unsigned int gracePeriod;
+    Automaton::Engine engine; // to start with
+    bool switchEngines; // to HashLife (when unbounded) or the grid (when bounded) for a while, then back again
+  };
+  
+  // Work out the generation after cells the slow way, neighbour by neighbour. The counts go in a grid over the board,
+  // or over everything within the radius of a live cell if there's no board; no rule here is born with 0 neighbours.
+  Cells referenceStep(const Cells& cells, const Case& run, const Rules& rules) {
+    const int radius = (int) run.radius, width = TEST_WIDTH * CHUNK_SIZE, height = TEST_HEIGHT * CHUNK_SIZE;
+    int left = 0, top = 0, right = width, bottom = height;
+    if (run.shape == Shape::UNBOUNDED) {
+      if (cells.empty()) return cells;
+      left = top = INT_MAX;
+      right = bottom = INT_MIN;
+      for (const auto& cell : cells) {
+        left = std::min(left, cell.first - radius);
+        top = std::min(top, cell.second - radius);
+        right = std::max(right, cell.first + radius + 1);
+        bottom = std::max(bottom, cell.second + radius + 1);
+      }
+    }
+    const int span = right - left;
+    std::vector<unsigned int> counts((std::size_t) span * (bottom - top));
+    std::vector<bool> alive(counts.size());
+    for (const auto& cell : cells) {
+      alive[(std::size_t) (cell.second - top) * span + (cell.first - left)] = true;
+      for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+          if ((dx == 0 && dy == 0) || (run.vonNeumann && std::abs(dx) + std::abs(dy) > radius)) continue;
+          int x = cell.first + dx, y = cell.second + dy;
+          if (run.shape == Shape::FIXED && (x < 0 || y < 0 || x >= width || y >= height)) continue;
+          if (run.shape == Shape::WRAPPING) {
+            x = (x % width + width) % width;
+            y = (y % height + height) % height;
+          }
+          counts[(std::size_t) (y - top) * span + (x - left)]++;
+        }
+      }
+    }
+    
+    Cells next;
+    for (int y = top; y < bottom; y++) {
+      for (int x = left; x < right; x++) {
+        std::size_t i = (std::size_t) (y - top) * span + (x - left);
+        if (alive[i] ? rules.survives[counts[i]] : rules.born[counts[i]]) {
+          next.insert({x, y});
+        }
+      }
+    }
+    return next;
+  }
+  
+  void setRules(Automaton& automaton, const Rules& rules) {
+    for (unsigned int count = 0; count < rules.born.size(); count++) {
+      automaton.ruleset().setBornWith(count, rules.born[count]);
+      automaton.ruleset().setSurvivesWith(count, rules.survives[count]);
+    }
+  }
+  
+  // Flip cell in both the automaton and the reference.
+  void toggle(Automaton& automaton, Cells& reference, std::pair<int, int> cell) {
+    bool value = reference.count(cell) == 0;
+    automaton.setCell(cell.first, cell.second, value);
+    if (value) {
+      reference.insert(cell);
+    } else {
+      reference.erase(cell);
+    }
+  }
+  
+  // Run one case, adding up what the profiler counted. Return whether the automaton kept up with the reference.
+  bool check(const Case& run, unsigned int seed, TickProfiler::Counters& counters) {
+    NeighbourhoodType* neighbourhoodType = makeNeighbourhoodType(run.vonNeumann, (int) run.radius);
+    const bool life = !run.vonNeumann && run.radius == 1;
+    const unsigned int neighbours = neighbourhoodType->getNumCells();
+    Automaton automaton(makeTopology(run.shape), neighbourhoodType);
+    
+    std::mt19937 random(seed);
+    Rules rules{std::vector<bool>(neighbours + 1), std::vector<bool>(neighbours + 1)};
+    if (life) {
+      rules.born[3] = rules.survives[2] = rules.survives[3] = true;
+    } else {
+      for (unsigned int count = 0; count <= neighbours; count++) {
+        rules.born[count] = count > 0 && random() % 3 == 0;
+        rules.survives[count] = random() % 2 == 0;
+      }
+    }
+    setRules(automaton, rules);
+    automaton.setEngine(run.engine);
+    automaton.setThreadCount(run.threads);
+    automaton.setMemoCapacity(run.memoCapacity);
+    automaton.setEmptyChunkGracePeriod(run.gracePeriod);
+    TickProfiler profiler;
+    automaton.setProfiler(&profiler);
+    
+    // A soup over the bounded topology's area, which the unbounded one spreads out of
+    const int width = TEST_WIDTH * CHUNK_SIZE, height = TEST_HEIGHT * CHUNK_SIZE;
+    Cells reference;
+    for (int i = 0; i < 600; i++) {
+      std::pair<int, int> cell((int) (random() % width), (int) (random() % height));
+      if (reference.count(cell) == 0) toggle(automaton, reference, cell);
+    }
+    
+    const Automaton::Engine other = run.shape == Shape::UNBOUNDED ? Automaton::Engine::HASHLIFE
+        : Automaton::Engine::GRID;
+    bool passed = true;
+    for (int generation = 0; generation < run.generations && passed; generation++) {
+      automaton.tick();
+      reference = referenceStep(reference, run, rules);
+      
+      if (generation % 17 == 9) {
+        toggle(automaton, reference, {(int) (random() % width), (int) (random() % height)});
+      }
+      if (run.switchEngines && generation == run.generations / 3) {
+        automaton.setEngine(other);
+      } else if (run.switchEngines && generation == run.generations / 3 + 5) {
+        automaton.setEngine(run.engine);
+      }
+      if (life && generation == run.generations / 2) {
+        // Off Life, where HashLife can't go, and back
+        rules.born[6] = !rules.born[6];
+        setRules(automaton, rules);
+      }
+      
+      if (automaton.population() != (long long) reference.size()) {
+        std::cout << "  generation " << automaton.generation() << ": a population of " << automaton.population()
+                  << ", but the reference has " << reference.size() << "\n";
+        passed = false;
+      } else if (liveCells(automaton) != reference) {
+        std::cout << "  generation " << automaton.generation() << ": the chunks don't match the reference\n";
+        passed = false;
+      }
+    }
+    
+    for (const TickProfiler::Tick& tick : profiler.ticks()) {
+      counters.chunksSkipped += tick.counters.chunksSkipped;
+      counters.memoHits += tick.counters.memoHits;
+    }
+    return passed;
+  }
+  
+  // Jump Life ahead with HashLife by a few generations at a time on an unbounded field, leaving the chunks behind for
+  // some jumps and editing it between others, then carry on with the chunks. Return whether it kept up.
+  bool checkJumps(unsigned int seed, unsigned int threads) {
+    Case run{"", Shape::UNBOUNDED, false, 1, 0, threads, 0, 0, Automaton::Engine::HASHLIFE, false};
+    Rules rules{std::vector<bool>(9), std::vector<bool>(9)};
+    rules.born[3] = rules.survives[2] = rules.survives[3] = true;
+    Automaton automaton(new UnboundedTopology, new MooreNeighbourhoodType(1));
+    setRules(automaton, rules);
+    automaton.setThreadCount(threads);
+    
+    std::mt19937 random(seed);
+    Cells reference;
+    for (int i = 0; i < 900; i++) {
+      std::pair<int, int> cell((int) (random() % 90) - 45, (int) (random() % 70) - 37); // over negative coordinates too
+      if (reference.count(cell) == 0) toggle(automaton, reference, cell);
+    }
+    automaton.setEngine(Automaton::Engine::HASHLIFE);
+    
+    for (int step = 0; step < 14; step++) {
+      unsigned int log2Generations = random() % 4;
+      automaton.jump(log2Generations);
+      for (int generation = 0; generation < 1 << log2Generations; generation++) {
+        reference = referenceStep(reference, run, rules);
+      }
+      if (automaton.population() != (long long) reference.size()) {
+        std::cout << "  generation " << automaton.generation() << ": a population of " << automaton.population()
+                  << ", but the reference has " << reference.size() << "\n";
+        return false;
+      }
+      if (random() % 3 == 0) continue; // don't look at the chunks this time
+      
+      if (step % 4 == 1) {
+        std::pair<int, int> cell((int) (random() % 60) - 30, (int) (random() % 60) - 30);
+        if (automaton.getCell(cell.first, cell.second) != (reference.count(cell) != 0)) {
+          std::cout << "  generation " << automaton.generation() << ": cell (" << cell.first << ", " << cell.second
+                    << ") is wrong\n";
+          return false;
+        }
+        toggle(automaton, reference, cell);
+      }
+      if (liveCells(automaton) != reference) {
+        std::cout << "  generation " << automaton.generation() << ": the chunks don't match the reference\n";
+        return false;
+      }
+    }
+    
+    automaton.jump(2);
+    for (int generation = 0; generation < 4; generation++) {
+      reference = referenceStep(reference, run, rules);
+    }
+    automaton.setEngine(Automaton::Engine::CHUNKS);
+    for (int generation = 0; generation < 5; generation++) {
+      automaton.tick();
+      reference = referenceStep(reference, run, rules);
+    }
+    if (automaton.population() != (long long) reference.size() || liveCells(automaton) != reference) {
+      std::cout << "  generation " << automaton.generation() << ": the chunks went wrong after HashLife\n";
+      return false;
+    }
+    return true;
+  }
+  
+  // Return whether neighbourhoods too small, or too big for the kernels to reach across, are refused when they're made
+  // rather than on the first tick.
+  bool checkRadii() {
+    for (int radius : {0, SummedAreaKernel::MAX_RADIUS + 1}) {
+      for (bool vonNeumann : {false, true}) {
+        try {
+          std::unique_ptr<NeighbourhoodType> neighbourhoodType(makeNeighbourhoodType(vonNeumann, radius));
+          std::cout << "  made a " << (vonNeumann ? "von Neumann" : "Moore") << " neighbourhood of radius " << radius
+                    << "\n";
+          return false;
+        } catch (std::invalid_argument&) {}
+      }
+    }
+    return true;
+  }
+  
+  std::vector<Case> cases() {
+    const Shape unbounded = Shape::UNBOUNDED, fixed = Shape::FIXED, wrapping = Shape::WRAPPING;
+    const Automaton::Engine chunks = Automaton::Engine::CHUNKS, grid = Automaton::Engine::GRID;
+    const std::size_t memo = ChunkMemo::DEFAULT_CAPACITY, smallMemo = 40; // small enough to keep evicting
+    const unsigned int grace = Automaton::DEFAULT_EMPTY_CHUNK_GRACE_PERIOD;
+    
+    std::vector<Case> cases = {
+        {"life_unbounded_hashlife_switch", unbounded, false, 1, 240, 1, memo, grace, chunks, true},
+        {"life_unbounded_threads_no_memo", unbounded, false, 1, 240, 4, 0, 0, chunks, true},
+        {"life_fixed_grid_switch", fixed, false, 1, 240, 1, smallMemo, grace, chunks, true},
+        {"life_fixed_threads", fixed, false, 1, 240, 4, memo, 0, chunks, false},
+        {"life_wrapping_grid", wrapping, false, 1, 240, 1, memo, grace, grid, false},
+        {"life_wrapping_threads_grid_switch", wrapping, false, 1, 240, 4, 0, grace, chunks, true},
+    };
+    
+    // Random rules on larger neighbourhoods, round every topology, with and without the memo
+    const Shape shapes[] = {unbounded, fixed, wrapping};
+    for (bool vonNeumann : {false, true}) {
+      for (unsigned int radius = 1; radius <= 3; radius++) {
+        if (!vonNeumann && radius == 1) continue; // that's Life, above
+        for (int shape = 0; shape < 3; shape++) {
+          bool odd = (radius + shape) % 2 != 0;
+          cases.push_back({std::string(vonNeumann ? "von_neumann" : "moore") + std::to_string(radius) + "_"
+                               + (shape == 0 ? "unbounded" : shape == 1 ? "fixed" : "wrapping"),
+                           shapes[shape], vonNeumann, radius, 30, odd ? 4u : 1u, odd ? 0 : smallMemo, odd ? 0 : grace,
+                           chunks, false});
+        }
+      }
+    }
+    
+    // And the summed-area tables of the large radii, Moore and turned 45 degrees for von Neumann, up to
+    // SummedAreaKernel::MAX_RADIUS; only on the bounded boards, since random rules this wide fill any board they're on
+    for (bool vonNeumann : {false, true}) {
+      for (unsigned int radius : {4u, 7u, (unsigned int) SummedAreaKernel::MAX_RADIUS}) {
+        for (int shape = 1; shape < 3; shape++) {
+          bool odd = (radius + shape) % 2 != 0;
+          cases.push_back({std::string(vonNeumann ? "von_neumann" : "moore") + std::to_string(radius) + "_"
+                               + (shape == 1 ? "fixed" : "wrapping"),
+                           shapes[shape], vonNeumann, radius, 30, odd ? 3u : 1u, odd ? 0 : smallMemo, grace, chunks,
+                           false});
+        }
+      }
+    }
+    return cases;
+  }
+}
+
+int main() {
+  TestRunner runner;
+  TickProfiler::Counters counters;
+  runner.runCases(cases(), [&counters] (const Case& run, unsigned int seed) { return check(run, seed, counters); });
+  for (unsigned int threads : {1u, 4u}) {
+    unsigned int seed = runner.nextSeed();
+    runner.run("life_hashlife_jumps_threads_" + std::to_string(threads), [=] { return checkJumps(seed, threads); });
+  }
+  runner.run("radii_out_of_range", checkRadii);
+  
+  // Every case could pass without the chunks ever being replayed or copied from the memo, so make sure some were
+  std::cout << counters.chunksSkipped << " chunks replayed, " << counters.memoHits << " copied from the memo\n";
+  if (counters.chunksSkipped == 0 || counters.memoHits == 0) {
+    std::cout << "  neither should be 0\n";
+    runner.fail();
+  }
+  return runner.finish();
+}
@@ -1,18 +1,30 @@
+#include <algorithm>
+#include <array>
+#include <climits>
 #include <stdexcept>
+#include <thread>
+#include <utility>
 
 #include "Automaton.h"
+#include "util.h"
+
+constexpr std::size_t Automaton::CHUNKS_PER_BATCH;
+constexpr std::size_t Automaton::CELLS_PER_HASHLIFE_BATCH;
+constexpr unsigned int Automaton::DEFAULT_EMPTY_CHUNK_GRACE_PERIOD;
 
 Automaton::Automaton(Topology* topology, NeighbourhoodType* initialNeighbourhoodType)
     : chunkArray_(topology), ruleset_(initialNeighbourhoodType) {
   if (topology == nullptr || initialNeighbourhoodType == nullptr) {
     throw std::invalid_argument("Cannot initialize Automaton with a null pointer");
   }
+  gridRunning(); // start on the grid if it can run us
 }
 
 Automaton::Automaton(Topology* topology, Ruleset&& ruleset) : chunkArray_(topology), ruleset_(ruleset) {
   if (topology == nullptr) {
     throw std::invalid_argument("Cannot initialize Automaton with a null pointer");
   }
+  gridRunning(); // start on the grid if it can run us
 }
 
 void Automaton::setNeighbourhoodType(NeighbourhoodType* neighbourhoodType) {
@@ -20,79 +32,231 @@ void Automaton::setNeighbourhoodType(NeighbourhoodType* neighbourhoodType) {
     throw std::invalid_argument("Cannot set automaton's neighbourhood type to a null pointer");
   }
   ruleset_.setNeighbourhoodType(neighbourhoodType);
+  hashLifeRunning(); // drop HashLife if it can't run the new neighbourhood
+  gridRunning(); // likewise the grid, or take it up if it can
+}
+
+namespace { // local to this file
+  // Is the linked neighbour of chunk at (dx, dy) present and non-empty?
+  bool hasNonEmptyNeighbour(const Chunk& chunk, int dx, int dy) {
+    const Chunk* neighbour = chunk.neighbour(dx, dy);
+    return neighbour != nullptr && !neighbour->isEmpty();
+  }
+  
+  // Get the shortest period after which chunk and all of its neighbours repeat, or 0 if they don't within
+  // Chunk::MAX_PERIOD. Missing ones are as empty as they were, so they always repeat.
+  int repeatingPeriod(const Chunk& chunk) {
+    for (int period = 1; period <= Chunk::MAX_PERIOD; period++) {
+      bool repeats = true;
+      for (int dy = -1; dy <= 1 && repeats; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          const Chunk* neighbour = chunk.neighbour(dx, dy);
+          if (neighbour != nullptr && !neighbour->repeatsAfter(period)) {
+            repeats = false;
+            break;
+          }
+        }
+      }
+      if (repeats) return period;
+    }
+    return 0;
+  }
 }
 
-void Automaton::generateEmptyChunk(int x, int y, Chunk& chunk, Neighbourhood& neighbourhood, int affectingDistance) {
+int Automaton::generateEmptyChunk(Chunk& chunk, Kernel& kernel, int affectingDistance) {
   // Only generate on sides where it's possible to affect something
-  bool left = chunkArray_.hasNonEmpty(x-1, y),
-      right = chunkArray_.hasNonEmpty(x+1, y),
-      top = chunkArray_.hasNonEmpty(x, y-1),
-      bottom = chunkArray_.hasNonEmpty(x, y+1),
-      leftTop = chunkArray_.hasNonEmpty(x-1, y-1),
-      leftBottom = chunkArray_.hasNonEmpty(x-1, y+1),
-      rightTop = chunkArray_.hasNonEmpty(x+1, y-1),
-      rightBottom = chunkArray_.hasNonEmpty(x+1, y+1);
+  bool left = hasNonEmptyNeighbour(chunk, -1, 0),
+      right = hasNonEmptyNeighbour(chunk, 1, 0),
+      top = hasNonEmptyNeighbour(chunk, 0, -1),
+      bottom = hasNonEmptyNeighbour(chunk, 0, 1),
+      leftTop = hasNonEmptyNeighbour(chunk, -1, -1),
+      leftBottom = hasNonEmptyNeighbour(chunk, -1, 1),
+      rightTop = hasNonEmptyNeighbour(chunk, 1, -1),
+      rightBottom = hasNonEmptyNeighbour(chunk, 1, 1);
   
+  int sides = 0;
   if (left || leftTop || leftBottom) {
-    chunk.generate(ruleset_, neighbourhood, Side::LEFT, affectingDistance);
+    kernel.generate(chunk, Side::LEFT, affectingDistance);
+    sides++;
   }
   if (right || rightTop || rightBottom) {
-    chunk.generate(ruleset_, neighbourhood, Side::RIGHT, affectingDistance);
+    kernel.generate(chunk, Side::RIGHT, affectingDistance);
+    sides++;
   }
   if (top || leftTop || rightTop) {
-    chunk.generate(ruleset_, neighbourhood, Side::TOP, affectingDistance);
+    kernel.generate(chunk, Side::TOP, affectingDistance);
+    sides++;
   }
   if (bottom || leftBottom || rightBottom) {
-    chunk.generate(ruleset_, neighbourhood, Side::BOTTOM, affectingDistance);
+    kernel.generate(chunk, Side::BOTTOM, affectingDistance);
+    sides++;
   }
+  return sides;
+}
+
+void Automaton::forEachChunk(const std::vector<Chunk*>& chunks,
+    const std::function<void(Chunk&, unsigned int)>& action) {
+  if (!threadPool_) {
+    for (Chunk* chunk : chunks) {
+      action(*chunk, 0);
+    }
+    return;
+  }
+  
+  threadPool_->parallelFor(chunks.size(), CHUNKS_PER_BATCH, [&chunks, &action] (std::size_t begin, std::size_t end,
+      unsigned int worker) {
+    for (std::size_t i = begin; i < end; i++) {
+      action(*chunks[i], worker);
+    }
+  });
 }
 
 void Automaton::tick() {
-  // This is the one Neighbourhood for this tick - smart pointer for exception safety
-  std::unique_ptr<Neighbourhood> neighbourhood(ruleset_.getNeighbourhoodType().makeNeighbourhood(chunkArray_));
+  if (hashLifeRunning()) {
+    stepHashLife(0);
+    return;
+  }
+  if (gridRunning()) {
+    stepGrid(0);
+    return;
+  }
+  if (profiler_ != nullptr) {
+    profiler_->beginTick();
+  }
+  
+  // These are the Kernels for this tick, specialized for the neighbourhood type - one per thread, since some (like
+  // NeighbourhoodKernel) keep state as they go - smart pointers for exception safety
+  std::vector<std::unique_ptr<Kernel>> kernels;
+  for (unsigned int i = 0; i < threadCount(); i++) {
+    kernels.emplace_back(ruleset_.getNeighbourhoodType().makeKernel(ruleset_, chunkArray_));
+  }
   int affectingDistance = ruleset_.getNeighbourhoodType().getAffectingDistance();
   
+  // What each thread did, for the profiler; only counted if there is one
+  bool counting = profiler_ != nullptr;
+  std::vector<TickProfiler::Counters> counters(counting ? threadCount() : 0);
+  long long sideCells = (long long) std::min(affectingDistance, CHUNK_SIZE) * CHUNK_SIZE; // evaluated per side
+  
+  // A chunk only sees as far as its neighbours, so if they're all as they were a few generations ago (still lifes
+  // and small oscillators), its next generation is as it was then too: replay it instead of generating it. That's
+  // only so if its history was generated with these rules, though, and not moved on by another engine, which leaves
+  // no record of the generations before
+  bool skipRepeating = !regenerateAll_ && ruleset_.revision() == rulesRevision_ && affectingDistance <= CHUNK_SIZE;
+  regenerateAll_ = false;
+  rulesRevision_ = ruleset_.revision();
+  
+  // A chunk's next generation only depends on it and its neighbours' cells within the affecting distance, so if it's
+  // been worked out before for the same cells, it can be copied
+  bool memoizing = memo_.prepare(affectingDistance, rulesRevision_);
+  
+  // Chunks only read their neighbours' current generation and write their own next one, so they can be generated
+  // in any order, on any thread
+  std::vector<Chunk*> chunks;
+  collectChunks(chunks);
+  
   // Generate for every chunk
-  for (auto& chunkPair : chunkArray_) {
-    int x = chunkPair.first.first, y = chunkPair.first.second;
-    Chunk& chunk = *chunkPair.second;
-    
-    if (chunk.isEmpty()) {
-      generateEmptyChunk(x, y, chunk, *neighbourhood, affectingDistance);
+  beginPhase(TickProfiler::Phase::GENERATE);
+  forEachChunk(chunks, [&] (Chunk& chunk, unsigned int worker) {
+    int period = skipRepeating ? repeatingPeriod(chunk) : 0;
+    if (!skipRepeating) {
+      chunk.forgetHistory(); // it's only history from here on
+    }
+    if (period != 0) {
+      chunk.replay(period);
+      if (counting) {
+        counters[worker].chunksSkipped++;
+      }
+    } else if (chunk.isEmpty()) {
+      int sides = generateEmptyChunk(chunk, *kernels[worker], affectingDistance);
+      if (counting && sides != 0) {
+        counters[worker].chunksGenerated++;
+        counters[worker].cellsEvaluated += sides * sideCells;
+      }
     } else {
-      // Generate the entire chunk
-      chunk.generate(ruleset_, *neighbourhood);
+      // Generate the entire chunk, unless one just like it was lately
+      ChunkMemo::Key key;
+      bool keyed = memoizing && memo_.makeKey(chunk, key);
+      if (keyed && memo_.recall(key, chunk)) {
+        if (counting) {
+          counters[worker].memoHits++;
+        }
+        return;
+      }
+      kernels[worker]->generate(chunk);
+      if (keyed) {
+        memo_.remember(key, chunk);
+      }
+      if (counting) {
+        counters[worker].chunksGenerated++;
+        counters[worker].cellsEvaluated += CHUNK_SIZE * CHUNK_SIZE;
+      }
     }
-  }
+  });
   
   // Insert the queued chunks, generate them
   // We ignore queue insertions because the chunks are empty and so can't add any new useful chunks
+  beginPhase(TickProfiler::Phase::INSERT_QUEUED);
   chunkArray_.insertAllInQueue();
   chunkArray_.setIgnoringQueueInsertions(true);
   
+  std::vector<Chunk*> queuedChunks;
   for (auto queueIt = chunkArray_.queueBegin(); queueIt != chunkArray_.queueEnd(); ++queueIt) {
     // TODO to squeeze out an extra three CPU cycles, maybe make a ChunkArray::at(std::pair<int, int>) overload?
-    generateEmptyChunk(queueIt->first, queueIt->second, chunkArray_.at(queueIt->first, queueIt->second),
-        *neighbourhood, affectingDistance);
+    queuedChunks.push_back(&chunkArray_.at(queueIt->x(), queueIt->y()));
   }
+  // Topologies can map several queued coordinates to the same chunk; don't let two threads generate it at once
+  std::sort(queuedChunks.begin(), queuedChunks.end());
+  queuedChunks.erase(std::unique(queuedChunks.begin(), queuedChunks.end()), queuedChunks.end());
+  
+  beginPhase(TickProfiler::Phase::GENERATE_QUEUED);
+  forEachChunk(queuedChunks, [&] (Chunk& chunk, unsigned int worker) {
+    int sides = generateEmptyChunk(chunk, *kernels[worker], affectingDistance);
+    if (counting && sides != 0) {
+      counters[worker].chunksGenerated++;
+      counters[worker].cellsEvaluated += sides * sideCells;
+    }
+  });
   
   chunkArray_.setIgnoringQueueInsertions(false);
   chunkArray_.clearQueue();
   
-  // Update every chunk, calculate the population
+  // Update every chunk, calculate the population (summed per thread, then added up, to not share a counter)
+  beginPhase(TickProfiler::Phase::UPDATE);
+  collectChunks(chunks);
+  std::vector<int> populations(threadCount(), 0);
+  forEachChunk(chunks, [&populations] (Chunk& chunk, unsigned int worker) {
+    chunk.update();
+    populations[worker] += chunk.population();
+  });
   population_ = 0;
-  for (auto& chunkPair : chunkArray_) {
-    chunkPair.second->update();
-    population_ += chunkPair.second->population();
+  for (int population : populations) {
+    population_ += population;
   }
   
-  // Remove isolated empty chunks and add empty chunks beside non-padded non-empty ones
-  // (Iterator idiom is to avoid getting errors for modifying chunkArray_ while iterating)
-  for (auto it = chunkArray_.begin(), nextIt = it; it != chunkArray_.end(); it = nextIt) {
-    ++nextIt;
-    
-    int x = it->first.first, y = it->first.second;
-    Chunk& chunk = *it->second;
+  beginPhase(TickProfiler::Phase::PRUNE_AND_PAD);
+  pruneAndPad();
+  
+  generation_++; // we've accomplished something
+  endTick(1, counters);
+}
+
+void Automaton::collectChunks(std::vector<Chunk*>& chunks) {
+  chunks.clear();
+  chunks.reserve(chunkArray_.size());
+  for (auto& entry : chunkArray_) {
+    chunks.push_back(entry.value);
+  }
+}
+
+void Automaton::pruneAndPad() {
+  // Work from a list of the chunks, since erasing shuffles the map's entries. Each chunk only erases itself, so the
+  // list stays good.
+  std::vector<Chunk*> chunks;
+  collectChunks(chunks);
+  std::vector<std::pair<int, int>> padding;
+  for (Chunk* chunkPtr : chunks) {
+    Chunk& chunk = *chunkPtr;
+    int x = chunk.chunkX, y = chunk.chunkY;
     
     if (chunk.isEmpty()) {
       // See if we can erase it
@@ -100,52 +264,432 @@ void Automaton::tick() {
       for (int dx = -1; dx <= 1; dx++) {
         for (int dy = -1; dy <= 1; dy++) {
           if (dx == 0 && dy == 0) continue;
-          if (chunkArray_.hasNonEmpty(x+dx, y+dy)) {
+          if (hasNonEmptyNeighbour(chunk, dx, dy)) {
             hasAny = true;
             break;
           }
         }
         if (hasAny) break;
       }
-    
-      if (!hasAny) {
+      
+      // Keep it for a while in case something comes back, so the chunks around oscillators aren't churned
+      if (chunk.countIsolatedTick(!hasAny) > emptyChunkGracePeriod_) {
         chunkArray_.erase(x, y);
       }
     } else {
-      // Do we need to add any?
+      chunk.countIsolatedTick(false);
+      
+      // Do we need to add any? The links tell us which neighbours are missing without looking them up
       // TODO it's possible that this isn't necessary because Neighbourhood checks this - test
       for (int dx = -1; dx <= 1; dx++) {
         for (int dy = -1; dy <= 1; dy++) {
           if (dx == 0 && dy == 0) continue;
-          chunkArray_.insertOrNoop(x + dx, y + dy); // does nothing if present
+          if (chunk.neighbour(dx, dy) == nullptr) {
+            padding.emplace_back(x + dx, y + dy);
+          }
         }
       }
     }
   }
   
-  generation_++; // we've accomplished something
+  // Only now add the padding, in order of coordinates. The chunks come in the order of the map's slots, and their
+  // neighbours hash to slots near their own, so adding them on the way would pile them up just ahead of the walk
+  // through the map, and after a jump brings many new chunks, every insert would probe the length of the pile.
+  std::sort(padding.begin(), padding.end());
+  padding.erase(std::unique(padding.begin(), padding.end()), padding.end());
+  chunkArray_.reserve(chunkArray_.size() + padding.size());
+  for (const std::pair<int, int>& coordinates : padding) {
+    chunkArray_.insertOrNoop(coordinates.first, coordinates.second);
+  }
+}
+
+void Automaton::jump(unsigned int log2Generations) {
+  if (log2Generations > HashLife::MAX_LOG2_STEP) {
+    throw std::invalid_argument("Cannot jump by more than 2^HashLife::MAX_LOG2_STEP generations at once");
+  }
+  if (hashLifeRunning()) {
+    stepHashLife(log2Generations);
+    return;
+  }
+  if (gridRunning()) {
+    stepGrid(log2Generations);
+    return;
+  }
+  for (long long i = 0; i < 1LL << log2Generations; i++) {
+    tick();
+  }
+}
+
+// Engines
+
+void Automaton::setEngine(Engine engine) {
+  if (engine == Engine::CHUNKS) {
+    syncChunks(); // the chunks aren't kept up to date after every step, so catch them up first
+    hashLife_.reset();
+    grid_.reset();
+    gridWanted_ = false;
+    return;
+  }
+  if (engine == Engine::GRID) {
+    if (!grid_) {
+      startGrid(); // throws if it can't run us
+    }
+    gridWanted_ = true;
+    return;
+  }
+  if (hashLife_) return;
+  
+  if (topology().bounded()) {
+    throw std::invalid_argument("HashLife can only run in an unbounded topology");
+  }
+  std::unique_ptr<HashLife> hashLife(new HashLife(ruleset_)); // throws if it can't run the ruleset
+  copyCellsTo(*hashLife);
+  hashLife_ = std::move(hashLife);
+  hashLifeStale_ = false;
+}
+
+void Automaton::copyCellsTo(HashLife& hashLife) {
+  syncChunks();
+  std::vector<HashLife::Cell> cells;
+  cells.reserve(std::min(CELLS_PER_HASHLIFE_BATCH, (std::size_t) std::max(population_, 0LL)));
+  for (auto& entry : chunkArray_) {
+    const Chunk& chunk = *entry.value;
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      Chunk::Row row = chunk.row(y);
+      for (int x = 0; row != 0; x++, row >>= 1u) {
+        if (row & 1u) {
+          cells.emplace_back((long long) chunk.chunkX * CHUNK_SIZE + x, (long long) chunk.chunkY * CHUNK_SIZE + y);
+        }
+      }
+    }
+    if (cells.size() >= CELLS_PER_HASHLIFE_BATCH) {
+      hashLife.add(std::move(cells));
+      cells.clear(); // moved-from, so make sure
+    }
+  }
+  hashLife.add(std::move(cells));
+}
+
+Automaton::Engine Automaton::engine() const noexcept {
+  if (hashLife_) {
+    return Engine::HASHLIFE;
+  }
+  return grid_ ? Engine::GRID : Engine::CHUNKS;
+}
+
+bool Automaton::hashLifeRunning() {
+  // The rules dialog changes the ruleset directly, so this is the first we hear of it
+  if (hashLife_ && !HashLife::supports(ruleset_)) {
+    syncChunks();
+    hashLife_.reset();
+  }
+  if (hashLife_ && hashLifeStale_) {
+    // Cells were added in bulk: the chunks have everything, so start HashLife over from them
+    hashLife_->clear();
+    copyCellsTo(*hashLife_);
+    hashLifeStale_ = false;
+  }
+  return hashLife_ != nullptr;
+}
+
+void Automaton::stepHashLife(unsigned int log2Generations) {
+  if (profiler_ != nullptr) {
+    profiler_->beginTick();
+  }
+  beginPhase(TickProfiler::Phase::HASHLIFE);
+  hashLife_->setRules(ruleset_);
+  unsigned long long cellsEvaluated = hashLife_->cellsEvaluated();
+  hashLife_->step(log2Generations);
+  generation_ += 1LL << log2Generations;
+  population_ = hashLife_->population(); // from the root, without looking at a cell
+  chunksBehind_ = true; // until someone looks at them
+  
+  std::vector<TickProfiler::Counters> counters(1);
+  counters[0].cellsEvaluated = hashLife_->cellsEvaluated() - cellsEvaluated;
+  endTick(1LL << log2Generations, counters);
+}
+
+// The grid
+
+bool Automaton::gridRunning() {
+  // As with HashLife, the rules dialog changes the ruleset directly, so this is the first we hear of it
+  bool supported = DenseGrid::supports(topology(), ruleset_);
+  if (grid_ && !supported) {
+    syncChunks();
+    grid_.reset();
+  } else if (!grid_ && supported && gridWanted_) {
+    startGrid();
+  }
+  return grid_ != nullptr;
+}
+
+void Automaton::startGrid() {
+  std::unique_ptr<DenseGrid> grid(new DenseGrid(topology(), ruleset_)); // throws if it can't run us
+  for (auto& entry : chunkArray_) {
+    const Chunk& chunk = *entry.value;
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      grid->addLiveCells(chunk.chunkX, chunk.chunkY, y, chunk.row(y));
+    }
+  }
+  grid_ = std::move(grid);
+  chunksBehind_ = false;
+}
+
+void Automaton::stepGrid(unsigned int log2Generations) {
+  if (profiler_ != nullptr) {
+    profiler_->beginTick();
+  }
+  beginPhase(TickProfiler::Phase::GRID);
+  grid_->setRules(ruleset_);
+  long long generations = 1LL << log2Generations;
+  for (long long i = 0; i < generations; i++) {
+    population_ = grid_->step(threadPool_.get());
+  }
+  generation_ += generations;
+  chunksBehind_ = true; // until someone looks at them
+  
+  std::vector<TickProfiler::Counters> counters(1);
+  counters[0].cellsEvaluated = (unsigned long long) generations * topology().width() * topology().height()
+      * CHUNK_SIZE * CHUNK_SIZE;
+  endTick(generations, counters);
+}
+
+void Automaton::syncChunks() {
+  if (!chunksBehind_) return;
+  if (hashLife_) {
+    syncChunksFromHashLife();
+  } else {
+    syncChunksFromGrid();
+  }
+  pruneAndPad();
+  chunksBehind_ = false;
+  regenerateAll_ = true; // the chunks only know how they differ from before the engine's steps
+}
+
+void Automaton::syncChunksFromHashLife() {
+  // Sort the live cells into rows by chunk, a leaf at a time
+  CoordinateMap<std::array<Chunk::Row, CHUNK_SIZE>> rows;
+  rows.reserve(chunkArray_.size());
+  hashLife_->forEachLeaf([&rows] (long long x, long long y, std::uint64_t cells) {
+    long long chunkX = floorDiv<long long>(x, CHUNK_SIZE);
+    int offset = (int) (x - chunkX * CHUNK_SIZE);
+    for (int j = 0; j < 8; j++) {
+      Chunk::Row bits = cells >> (8u * j) & 0xFFu;
+      if (bits == 0) continue;
+      long long chunkY = floorDiv<long long>(y + j, CHUNK_SIZE);
+      int cellY = (int) (y + j - chunkY * CHUNK_SIZE);
+      
+      // The leaf's row may straddle two chunks
+      for (long long dx = 0; dx <= 1 && bits != 0; dx++) {
+        if (chunkX + dx < INT_MIN || chunkX + dx > INT_MAX || chunkY < INT_MIN || chunkY > INT_MAX) {
+          continue; // too far away for the chunks to hold; HashLife still has it
+        }
+        Chunk::Row inChunk = dx == 0 ? bits << offset & Chunk::ROW_MASK : bits >> (CHUNK_SIZE - offset);
+        if (inChunk != 0) {
+          rows.findOrInsert((int) (chunkX + dx), (int) chunkY)[cellY] |= inChunk;
+        }
+        if (offset + 8 <= CHUNK_SIZE) break;
+      }
+    }
+  });
+  
+  // Put them in as the chunks' next generation, so updating them swaps them in as if they'd been generated
+  chunkArray_.reserve(chunkArray_.size() + rows.size());
+  for (auto& entry : rows) {
+    chunkArray_.insertOrNoop(entry.x(), entry.y());
+  }
+  std::vector<Chunk*> chunks;
+  collectChunks(chunks);
+  const CoordinateMap<std::array<Chunk::Row, CHUNK_SIZE>>& chunkRows = rows;
+  forEachChunk(chunks, [&chunkRows] (Chunk& chunk, unsigned int) {
+    const std::array<Chunk::Row, CHUNK_SIZE>* found = chunkRows.find(chunk.chunkX, chunk.chunkY);
+    if (found != nullptr) {
+      for (int y = 0; y < CHUNK_SIZE; y++) {
+        chunk.setNextRow(y, (*found)[y]);
+      }
+    }
+    chunk.update();
+  });
+}
+
+void Automaton::syncChunksFromGrid() {
+  // Make sure every chunk with live cells is there, then put the grid's cells in as every chunk's next generation
+  const DenseGrid& grid = *grid_;
+  for (int chunkY = 0; chunkY < topology().height(); chunkY++) {
+    for (int chunkX = 0; chunkX < topology().width(); chunkX++) {
+      for (int y = 0; y < CHUNK_SIZE; y++) {
+        if (grid.chunkRow(chunkX, chunkY, y) != 0) {
+          chunkArray_.insertOrNoop(chunkX, chunkY);
+          break;
+        }
+      }
+    }
+  }
+  std::vector<Chunk*> chunks;
+  collectChunks(chunks);
+  forEachChunk(chunks, [&grid] (Chunk& chunk, unsigned int) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      chunk.setNextRow(y, grid.chunkRow(chunk.chunkX, chunk.chunkY, y));
+    }
+    chunk.update();
+  });
+}
+
+void Automaton::endTick(long long generations, const std::vector<TickProfiler::Counters>& counters) {
+  if (profiler_ == nullptr) return;
+  
+  TickProfiler::Counters total;
+  for (const TickProfiler::Counters& counted : counters) {
+    total.chunksGenerated += counted.chunksGenerated;
+    total.cellsEvaluated += counted.cellsEvaluated;
+    total.chunksSkipped += counted.chunksSkipped;
+    total.memoHits += counted.memoHits;
+  }
+  ChunkArray::OperationCounts operations = chunkArray_.takeOperationCounts();
+  total.hashLookups = operations.lookups;
+  total.chunksInserted = operations.insertions;
+  total.chunksErased = operations.erasures;
+  profiler_->endTick(generation_, generations, chunkArray_.size(), total);
+}
+
+// Cells
+
+bool Automaton::getCell(int x, int y) {
+  syncChunks();
+  int chunkX = floorDiv(x, CHUNK_SIZE), chunkY = floorDiv(y, CHUNK_SIZE);
+  if (!chunkArray_.contains(chunkX, chunkY)) {
+    return false;
+  }
+  return chunkArray_.at(chunkX, chunkY).getCell(x - chunkX * CHUNK_SIZE, y - chunkY * CHUNK_SIZE);
+}
+
+void Automaton::setCell(int x, int y, bool value) {
+  int chunkX = floorDiv(x, CHUNK_SIZE), chunkY = floorDiv(y, CHUNK_SIZE);
+  if (!topology().valid(chunkX, chunkY)) {
+    throw std::out_of_range("Cannot set a cell outside the automaton's topology");
+  }
+  
+  syncChunks();
+  chunkArray_.insertOrNoop(chunkX, chunkY);
+  Chunk& chunk = chunkArray_.at(chunkX, chunkY);
+  int cellX = x - chunkX * CHUNK_SIZE, cellY = y - chunkY * CHUNK_SIZE;
+  if (chunk.getCell(cellX, cellY) == value) return;
+  
+  chunk.setCell(cellX, cellY, value);
+  addToPopulation(value ? 1 : -1);
+  if (hashLife_) {
+    hashLife_->setCell(x, y, value);
+  }
+  if (grid_) {
+    grid_->setCell(x, y, value);
+  }
+}
+
+void Automaton::addLiveCells(int chunkX, int chunkY, int y, Chunk::Row bits) {
+  if (y < 0 || y >= CHUNK_SIZE) {
+    throw std::invalid_argument("Cannot add live cells to a row not in [0, CHUNK_SIZE)");
+  }
+  if (!topology().valid(chunkX, chunkY)) {
+    throw std::out_of_range("Cannot set a cell outside the automaton's topology");
+  }
+  
+  syncChunks();
+  chunkArray_.insertOrNoop(chunkX, chunkY);
+  int added = chunkArray_.at(chunkX, chunkY).addLiveCells(y, bits);
+  if (added != 0) {
+    addToPopulation(added);
+    hashLifeStale_ = hashLife_ != nullptr;
+    if (grid_) {
+      grid_->addLiveCells(chunkX, chunkY, y, bits);
+    }
+  }
 }
 
 void Automaton::reset() {
+  hashLifeStale_ = false;
+  chunksBehind_ = false;
   chunkArray_.clear();
+  if (hashLife_) {
+    hashLife_->clear();
+  }
+  if (grid_) {
+    grid_->clear();
+  }
   generation_ = 0;
   population_ = 0;
 }
 
-int Automaton::generation() const noexcept {
+void Automaton::setThreadCount(unsigned int threads) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1; // it's allowed to not know
+  }
+  if (threads == threadCount()) return;
+  
+  if (threads == 1) {
+    threadPool_.reset();
+  } else {
+    threadPool_.reset(new ThreadPool(threads));
+  }
+}
+
+unsigned int Automaton::threadCount() const noexcept {
+  return threadPool_ ? threadPool_->size() : 1;
+}
+
+void Automaton::setEmptyChunkGracePeriod(unsigned int ticks) noexcept {
+  emptyChunkGracePeriod_ = ticks;
+}
+
+unsigned int Automaton::emptyChunkGracePeriod() const noexcept {
+  return emptyChunkGracePeriod_;
+}
+
+void Automaton::setMemoCapacity(std::size_t entries) {
+  memo_.setCapacity(entries);
+}
+
+std::size_t Automaton::memoCapacity() const noexcept {
+  return memo_.capacity();
+}
+
+void Automaton::setProfiler(TickProfiler* profiler) {
+  profiler_ = profiler;
+  chunkArray_.setCountingOperations(profiler != nullptr);
+  chunkArray_.takeOperationCounts(); // start the first tick's counts afresh
+}
+
+TickProfiler* Automaton::profiler() const noexcept {
+  return profiler_;
+}
+
+long long Automaton::generation() const noexcept {
   return generation_;
 }
 
-int Automaton::population() const noexcept {
+void Automaton::setGeneration(long long generation) {
+  if (generation < 0) {
+    throw std::invalid_argument("The generation cannot be negative");
+  }
+  generation_ = generation;
+}
+
+long long Automaton::population() const noexcept {
   return population_;
 }
 
+std::size_t Automaton::memoryUsage() const noexcept {
+  return chunkArray_.memoryUsage() + memo_.memoryUsage() + (hashLife_ ? hashLife_->memoryUsage() : 0)
+      + (grid_ ? grid_->memoryUsage() : 0);
+}
+
 void Automaton::addToPopulation(int delta) {
   population_ += delta;
   if (population_ < 0) population_ = 0; // erm
 }
 
-ChunkArray& Automaton::chunkArray() noexcept {
+ChunkArray& Automaton::chunkArray() {
+  syncChunks();
   return chunkArray_;
 }
 
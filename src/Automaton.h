@@ -1,16 +1,36 @@
 #ifndef GAME_OF_LIFE_AUTOMATON_H
 #define GAME_OF_LIFE_AUTOMATON_H
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "Chunk.h"
+#include "ChunkMemo.h"
+#include "DenseGrid.h"
+#include "HashLife.h"
+#include "Kernel.h"
 #include "Ruleset.h"
 #include "Neighbourhood.h"
+#include "ThreadPool.h"
+#include "TickProfiler.h"
 
 // An Automaton encapsulates the entire cellular automaton. It owns a Topology*, a Ruleset, and
 // a ChunkArray. It can advance the generation of the automaton by calling Automaton::tick().
+// Ticks can be spread over several threads with Automaton::setThreadCount(unsigned int), or, for Life-like rules in
+// an unbounded topology, handed to HashLife with Automaton::setEngine(Engine), which can also jump far ahead. In a
+// bounded topology, Life-like rules run on a DenseGrid of the whole board instead of the chunks, without being asked.
 class Automaton {
 public:
+  // The engines which can evolve the automaton.
+  enum class Engine {
+    CHUNKS, // chunk by chunk with Kernels; works with any ruleset and topology
+    HASHLIFE, // HashLife, copied into the chunks only once they're looked at; see HashLife::supports for which
+              // rulesets work
+    GRID // one DenseGrid of the whole board, copied into the chunks only once they're looked at; see
+         // DenseGrid::supports for which topologies and rulesets work
+  };
+  
   // Initialize the Automaton with a given topology (fixed) and neighbourhood type (can be modified later).
   // Take ownership of both pointers - the user must not delete them.
   // Throw std::invalid_argument if either pointer is null.
@@ -24,23 +44,97 @@ public:
   // Throw std::invalid_argument if it is null.
   void setNeighbourhoodType(NeighbourhoodType* neighbourhoodType);
   
-  // Advance the entire automaton to the next generation.
+  // Advance the entire automaton to the next generation. Chunks whose neighbourhoods repeat with a short period, like
+  // still lifes and blinkers, are replayed from their history rather than generated, so settled regions cost next to
+  // nothing.
   void tick();
   
+  // Advance the entire automaton by 2^log2Generations generations. HashLife does this in one step; the chunks are
+  // ticked that many times. Throw std::invalid_argument if log2Generations > HashLife::MAX_LOG2_STEP.
+  void jump(unsigned int log2Generations);
+  
+  // Switch to the given engine, keeping the current cells. Throw std::invalid_argument if it can't run this
+  // automaton. If the rules are changed to ones the HashLife or grid engine can't run, it switches back to the chunks
+  // itself. The grid engine is the default wherever it can run, and comes back by itself once the rules are ones it can
+  // run again, unless the chunks are asked for.
+  void setEngine(Engine engine);
+  
+  // Get the engine evolving the automaton.
+  Engine engine() const noexcept;
+  
+  // Set the number of threads Automaton::tick() spreads the chunks over, including the calling thread. 1, the
+  // default, ticks serially on the calling thread; 0 means one per hardware thread. The result of a tick is the same
+  // whatever the number of threads.
+  void setThreadCount(unsigned int threads);
+  
+  // Get the number of threads Automaton::tick() uses.
+  unsigned int threadCount() const noexcept;
+  
+  // Set how many ticks in a row an empty chunk with no non-empty neighbours is kept before it's erased. Keeping them
+  // a while saves erasing and reinserting the chunks around oscillators every tick; 0 erases them straight away.
+  void setEmptyChunkGracePeriod(unsigned int ticks) noexcept;
+  
+  // Get the above.
+  unsigned int emptyChunkGracePeriod() const noexcept;
+  
+  static constexpr unsigned int DEFAULT_EMPTY_CHUNK_GRACE_PERIOD = 8;
+  
+  // Set how many chunks' next generations are remembered, so a chunk just like one generated lately (cells, halo and
+  // all) copies its next generation instead of being generated; 0 turns it off. The default is
+  // ChunkMemo::DEFAULT_CAPACITY. Changing it forgets everything remembered.
+  void setMemoCapacity(std::size_t entries);
+  
+  // Get the above.
+  std::size_t memoCapacity() const noexcept;
+  
+  // Record every tick from now on to profiler, which we don't own and which must outlive us or be replaced first;
+  // nullptr stops. Without one, nothing is timed or counted.
+  void setProfiler(TickProfiler* profiler);
+  
+  // Get the above.
+  TickProfiler* profiler() const noexcept;
+  
   // Reset the entire automaton. Remove all Chunks and reset the generation count.
   void reset();
   
   // Get the current generation. The first generation is 0.
-  int generation() const noexcept;
+  long long generation() const noexcept;
+  
+  // Set the current generation, for picking up where a saved automaton left off.
+  // Throw std::invalid_argument if it's negative.
+  void setGeneration(long long generation);
   
   // Get the total number of live cells in the automaton.
-  int population() const noexcept;
+  long long population() const noexcept;
+  
+  // Estimate the bytes taken up by the chunks and the memo of their generations, and by HashLife's nodes or the grid if
+  // either is running.
+  std::size_t memoryUsage() const noexcept;
+  
+  // Get the value of the cell at (x, y), in cell (not chunk) coordinates.
+  bool getCell(int x, int y);
+  
+  // Set the value of the cell at (x, y), in cell coordinates, adding its chunk if need be and keeping the population
+  // (and the HashLife or grid engine, if either is running) up to date. Throw std::out_of_range if it's outside the
+  // topology.
+  void setCell(int x, int y, bool value);
+  
+  // Make the cells in bits live in row y (in [0, CHUNK_SIZE)) of the chunk at (chunkX, chunkY), adding the chunk if
+  // need be. This is setCell in bulk, for loading patterns: a row of a chunk for the price of one cell. If the HashLife
+  // engine is running, it catches up with all of these at once before it next steps; the grid takes them as they come.
+  // Throw std::out_of_range if the chunk is outside the topology, or std::invalid_argument if y is out of range.
+  void addLiveCells(int chunkX, int chunkY, int y, Chunk::Row bits);
+  
+  // Make every live cell in the chunks live in hashLife too, a batch at a time, so they're never all in one list,
+  // bringing the chunks up to date with HashLife or the grid first if either engine has moved on since.
+  void copyCellsTo(HashLife& hashLife);
   
   // Add delta to the current population. If the population is brought to below 0, silently set it to 0.
   void addToPopulation(int delta);
   
-  // Get the chunk array behind the automaton.
-  ChunkArray& chunkArray() noexcept;
+  // Get the chunk array behind the automaton, bringing it up to date with HashLife or the grid first if either engine
+  // has moved on since. While either is running, change cells with setCell and addLiveCells, not through the chunks.
+  ChunkArray& chunkArray();
   
   // Get the Ruleset managing the automaton. (What's an encapsulation? Why not just have them be public?)
   Ruleset& ruleset() noexcept;
@@ -49,13 +143,73 @@ public:
   Topology& topology() noexcept;
   
 private:
-  // Call the appropriate generation functions for the given chunk, which is assumed to be empty.
-  void generateEmptyChunk(int x, int y, Chunk& chunk, Neighbourhood& neighbourhood, int affectingDistance);
+  // Call the appropriate generation functions for the given chunk, which is assumed to be empty. Return the number of
+  // sides generated.
+  int generateEmptyChunk(Chunk& chunk, Kernel& kernel, int affectingDistance);
+  
+  // Call action(chunk, worker) on every chunk, spread over the thread pool if there is one. worker is in
+  // [0, threadCount()) and no two calls with the same worker run at once.
+  void forEachChunk(const std::vector<Chunk*>& chunks, const std::function<void(Chunk&, unsigned int)>& action);
+  
+  // Fill chunks with a pointer to every chunk in the chunk array.
+  void collectChunks(std::vector<Chunk*>& chunks);
+  
+  // Remove empty chunks which have been isolated for longer than the grace period and add empty chunks beside
+  // non-padded non-empty ones.
+  void pruneAndPad();
+  
+  // Is the engine HashLife? If the rules have been changed to ones it can't run, switch back to the chunks first.
+  bool hashLifeRunning();
+  
+  // Step hashLife_ by 2^log2Generations generations, leaving the chunks behind.
+  void stepHashLife(unsigned int log2Generations);
+  
+  // Is the engine the grid? If the rules have been changed to ones it can't run, switch back to the chunks first; if
+  // they've been changed to ones it can, and it's wanted, switch to it.
+  bool gridRunning();
+  
+  // Start the grid engine afresh from the chunks.
+  void startGrid();
+  
+  // Step grid_ by 2^log2Generations generations, leaving the chunks behind.
+  void stepGrid(unsigned int log2Generations);
+  
+  // If HashLife or the grid has moved on since the chunks were last brought up to date, copy its cells into them.
+  void syncChunks();
+  
+  // The halves of syncChunks, putting each engine's cells in as the chunks' next generation and updating them.
+  void syncChunksFromHashLife();
+  void syncChunksFromGrid();
+  
+  // Start timing phase of the tick, if there's a profiler.
+  void beginPhase(TickProfiler::Phase phase) {
+    if (profiler_ != nullptr) {
+      profiler_->beginPhase(phase);
+    }
+  }
+  
+  // Record the tick which just moved on by generations to the profiler, if there is one, with counters (summed over
+  // the threads) and what the chunk array counted.
+  void endTick(long long generations, const std::vector<TickProfiler::Counters>& counters);
+  
+  static constexpr std::size_t CHUNKS_PER_BATCH = 16; // how many chunks each thread takes from the pool at a time
+  static constexpr std::size_t CELLS_PER_HASHLIFE_BATCH = 1u << 20; // how many cells copyCellsTo adds at a time
   
   ChunkArray chunkArray_;
   Ruleset ruleset_;
-  int generation_ = 0;
-  int population_ = 0;
+  long long generation_ = 0;
+  long long population_ = 0;
+  unsigned int emptyChunkGracePeriod_ = DEFAULT_EMPTY_CHUNK_GRACE_PERIOD;
+  std::unique_ptr<ThreadPool> threadPool_; // nullptr when ticking serially
+  std::unique_ptr<HashLife> hashLife_; // nullptr unless the engine is HashLife
+  bool hashLifeStale_ = false; // have cells been added in bulk since hashLife_ last had all of them?
+  std::unique_ptr<DenseGrid> grid_; // nullptr unless the engine is the grid
+  bool gridWanted_ = true; // should the grid take over whenever it can run the automaton?
+  bool chunksBehind_ = false; // has hashLife_ or grid_ stepped since the chunks last had its cells?
+  bool regenerateAll_ = true; // must the next tick generate every chunk, repeating or not?
+  unsigned long long rulesRevision_ = 0; // ruleset_.revision() as of the last tick
+  ChunkMemo memo_; // the next generations of chunks generated lately, shared by the threads
+  TickProfiler* profiler_ = nullptr; // not ours
 };
 
 #endif //GAME_OF_LIFE_AUTOMATON_H
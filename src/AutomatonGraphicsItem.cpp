@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include "AutomatonGraphicsItem.h"
+#include "GraphicsProperties.h"
+
+constexpr qreal AutomatonGraphicsItem::CHUNK_SCENE_SIZE;
+constexpr std::size_t AutomatonGraphicsItem::MAX_CHUNK_UPDATES;
+constexpr qreal AutomatonGraphicsItem::MIN_CHUNK_PIXELS;
+constexpr qreal AutomatonGraphicsItem::MIN_TILE_PIXELS;
+
+namespace { // local to this file
+  // Call action(x, y, value) for each entry of map with x in [left, right] and y in [top, bottom]: by looking up each
+  // coordinate if there are fewer of them than entries, and otherwise by going through the entries.
+  template<typename Map, typename Action>
+  void forEachInRect(Map& map, int left, int top, int right, int bottom, Action action) {
+    long long area = (long long) (right - left + 1) * (bottom - top + 1);
+    if (area <= (long long) map.size()) {
+      for (int y = top; y <= bottom; y++) {
+        for (int x = left; x <= right; x++) {
+          auto* value = map.find(x, y);
+          if (value != nullptr) {
+            action(x, y, *value);
+          }
+        }
+      }
+    } else {
+      for (auto& entry : map) {
+        int x = entry.x(), y = entry.y();
+        if (x >= left && x <= right && y >= top && y <= bottom) {
+          action(x, y, entry.value);
+        }
+      }
+    }
+  }
+  
+  // Get the tiles of size (in scene coordinates) touching rect, as left, top, right and bottom tile coordinates.
+  void tilesInRect(const QRectF& rect, qreal size, int& left, int& top, int& right, int& bottom) {
+    left = (int) std::floor(rect.left() / size);
+    top = (int) std::floor(rect.top() / size);
+    right = (int) std::ceil(rect.right() / size) - 1;
+    bottom = (int) std::ceil(rect.bottom() / size) - 1;
+  }
+}
+
+AutomatonGraphicsItem::AutomatonGraphicsItem() {
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption); // so paint() gets the exposed rect
+}
+
+void AutomatonGraphicsItem::setBounds(const QRectF& bounds) {
+  prepareGeometryChange();
+  bounds_ = bounds;
+}
+
+void AutomatonGraphicsItem::applyFrame(const Simulation::Frame& frame) {
+  if (frame.reset) {
+    chunks_.clear();
+    chunks_.reserve(frame.chunks.size());
+    pyramid_.clear();
+    pyramid_.reserve(frame.chunks.size());
+  }
+  for (const Simulation::ChunkCells& cells : frame.chunks) {
+    if (cells.present) {
+      ShownChunk& chunk = chunks_.findOrInsert(cells.x, cells.y);
+      std::copy(cells.rows, cells.rows + CHUNK_SIZE, chunk.rows);
+      chunk.population = cells.population;
+      chunk.dirty = true;
+    } else {
+      chunks_.erase(cells.x, cells.y);
+    }
+    pyramid_.setChunkPopulation(cells.x, cells.y, cells.present ? cells.population : 0);
+  }
+  
+  if (frame.reset || frame.chunks.size() > MAX_CHUNK_UPDATES) {
+    update();
+    return;
+  }
+  for (const Simulation::ChunkCells& cells : frame.chunks) {
+    update(chunkRect(cells.x, cells.y));
+  }
+}
+
+QRectF AutomatonGraphicsItem::boundingRect() const {
+  return bounds_;
+}
+
+void AutomatonGraphicsItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*) {
+  QRectF exposed = option->exposedRect & bounds_;
+  if (exposed.isEmpty()) return;
+  
+  QElapsedTimer timer;
+  timer.start();
+  paintExposed(painter, exposed);
+  paintNanoseconds_ += timer.nsecsElapsed();
+  paints_++;
+}
+
+void AutomatonGraphicsItem::takePaintTime(qint64& nanoseconds, int& paints) {
+  nanoseconds = paintNanoseconds_;
+  paints = paints_;
+  paintNanoseconds_ = 0;
+  paints_ = 0;
+}
+
+std::size_t AutomatonGraphicsItem::memoryUsage() const {
+  // Each chunk's image is a 32-bit-aligned line per row and a two-entry colour table, as well as a header we ignore
+  std::size_t imageBytes = CHUNK_SIZE * (((CHUNK_SIZE + 31) / 32) * 4) + 2 * sizeof(QRgb);
+  return chunks_.memoryUsage() + chunks_.size() * imageBytes + pyramid_.memoryUsage();
+}
+
+void AutomatonGraphicsItem::paintExposed(QPainter* painter, const QRectF& exposed) {
+  qreal scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+  qreal chunkPixels = CHUNK_SCENE_SIZE * scale;
+  if (chunkPixels < MIN_CHUNK_PIXELS) {
+    // The smallest tiles which are still wide enough
+    int level = 0;
+    while (level + 1 < DensityPyramid::LEVELS && chunkPixels * (1 << level) < MIN_TILE_PIXELS) {
+      level++;
+    }
+    paintDensity(painter, exposed, level);
+    return;
+  }
+  
+  int left, top, right, bottom;
+  tilesInRect(exposed, CHUNK_SCENE_SIZE, left, top, right, bottom);
+  paintChunks(painter, left, top, right, bottom);
+}
+
+QRectF AutomatonGraphicsItem::chunkRect(int x, int y) {
+  // Top-left is (x*CHUNK_SCENE_SIZE, y*CHUNK_SCENE_SIZE)
+  return {x * CHUNK_SCENE_SIZE, y * CHUNK_SCENE_SIZE, CHUNK_SCENE_SIZE, CHUNK_SCENE_SIZE};
+}
+
+void AutomatonGraphicsItem::paintChunks(QPainter* painter, int left, int top, int right, int bottom) {
+  forEachInRect(chunks_, left, top, right, bottom, [&] (int x, int y, ShownChunk& chunk) {
+    paintChunk(painter, x, y, chunk);
+  });
+}
+
+void AutomatonGraphicsItem::paintDensity(QPainter* painter, const QRectF& exposed, int level) {
+  qreal tileSize = CHUNK_SCENE_SIZE * (1 << level);
+  int left, top, right, bottom;
+  tilesInRect(exposed, tileSize, left, top, right, bottom);
+  
+  // Shade each tile from the dead colour to the live one by the square root of its density, so sparse patterns still
+  // show up; any live cell at all gets at least a quarter of the way
+  const QColor& dead = GraphicsProperties::instance().deadColor();
+  const QColor& live = GraphicsProperties::instance().liveColor();
+  double cells = (double) CHUNK_SIZE * CHUNK_SIZE * (1 << level) * (1 << level);
+  forEachInRect(pyramid_.level(level), left, top, right, bottom,
+      [&] (int x, int y, long long population) {
+        double shade = std::max(0.25, std::min(1.0, std::sqrt((double) population / cells)));
+        QColor colour = QColor::fromRgbF(dead.redF() + (live.redF() - dead.redF()) * shade,
+            dead.greenF() + (live.greenF() - dead.greenF()) * shade,
+            dead.blueF() + (live.blueF() - dead.blueF()) * shade);
+        painter->fillRect(QRectF(x * tileSize, y * tileSize, tileSize, tileSize), colour);
+      });
+}
+
+void AutomatonGraphicsItem::paintChunk(QPainter* painter, int x, int y, ShownChunk& chunk) {
+  QRectF bounds = chunkRect(x, y);
+  if (chunk.population != 0) { // otherwise the background is already the dead colour
+    // Scaled up a cell to a block of pixels, without smoothing
+    painter->drawImage(bounds, image(chunk));
+  }
+  if (GraphicsProperties::instance().showChunkBoxes) {
+    painter->setBrush(Qt::NoBrush);
+    painter->setPen(GraphicsProperties::instance().liveColor());
+    painter->drawRect(bounds);
+  }
+}
+
+const QImage& AutomatonGraphicsItem::image(ShownChunk& chunk) {
+  if (chunk.image.isNull()) {
+    chunk.image = QImage(CHUNK_SIZE, CHUNK_SIZE, QImage::Format_MonoLSB);
+    chunk.image.setColorCount(2);
+    chunk.dirty = true;
+  }
+  if (chunk.dirty) {
+    // In MonoLSB, pixel x is bit x % 8 of byte x / 8 of its line, just as cell x is bit x of its row
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      uchar* line = chunk.image.scanLine(y);
+      for (int byte = 0; byte * 8 < CHUNK_SIZE; byte++) {
+        line[byte] = (uchar) (chunk.rows[y] >> (8 * byte));
+      }
+    }
+    chunk.dirty = false;
+  }
+  
+  // A theme change only recolours the image
+  QRgb dead = GraphicsProperties::instance().deadColor().rgba();
+  QRgb live = GraphicsProperties::instance().liveColor().rgba();
+  if (chunk.image.color(0) != dead || chunk.image.color(1) != live) {
+    chunk.image.setColor(0, dead);
+    chunk.image.setColor(1, live);
+  }
+  return chunk.image;
+}
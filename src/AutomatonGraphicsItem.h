@@ -0,0 +1,86 @@
+#ifndef GAME_OF_LIFE_AUTOMATONGRAPHICSITEM_H
+#define GAME_OF_LIFE_AUTOMATONGRAPHICSITEM_H
+
+#include <QBrush>
+#include <QGraphicsItem>
+#include <QImage>
+
+#include "Chunk.h"
+#include "CoordinateMap.h"
+#include "DensityPyramid.h"
+#include "Simulation.h"
+
+// This GraphicsItem paints every chunk of an Automaton, as one item, so the scene never has an item (or an index
+// entry) per chunk. It never touches the automaton, which is busy on the Simulation's worker thread: it keeps its own
+// copy of the chunks' cells, brought up to date with each Simulation::Frame passed to applyFrame. Each paint looks up
+// only the chunks inside the exposed rect and blits each from a 1-bit image of its cells, which is kept between paints
+// and redrawn only once the cells change.
+// Zoomed out far enough that a chunk is only a few pixels across, it paints tiles of chunks instead, shaded by their
+// density, from a DensityPyramid kept up to date with the same frames.
+class AutomatonGraphicsItem : public QGraphicsItem {
+public:
+  static constexpr qreal CHUNK_SCENE_SIZE = 150.0; // A chunk's size in the scene. A cell is this / CHUNK_SIZE.
+  
+  // Initialize the item with no chunks; they come with the first frame.
+  AutomatonGraphicsItem();
+  
+  // Set the rect the item covers, in scene coordinates. Chunks outside it aren't painted.
+  void setBounds(const QRectF& bounds);
+  
+  // Copy the cells of the chunks inserted, erased and changed in frame (or all of them, if it resets) and repaint them.
+  void applyFrame(const Simulation::Frame& frame);
+  
+  QRectF boundingRect() const override;
+  
+  void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+  
+  // Get the time spent in paint, in nanoseconds, and the number of paints since the last call.
+  void takePaintTime(qint64& nanoseconds, int& paints);
+  
+  // Estimate the bytes taken up by our copy of the chunks and their images.
+  std::size_t memoryUsage() const;
+  
+  // Past this many changed chunks, applyFrame repaints the whole item instead of each chunk's rect.
+  static constexpr std::size_t MAX_CHUNK_UPDATES = 256;
+  
+  // Chunks narrower than this on-screen, in pixels, are painted as density tiles.
+  static constexpr qreal MIN_CHUNK_PIXELS = 8.0;
+  
+  // Density tiles are made of enough chunks to be at least this wide on-screen, in pixels.
+  static constexpr qreal MIN_TILE_PIXELS = 2.0;
+  
+private:
+  // Our copy of a chunk.
+  struct ShownChunk {
+    Chunk::Row rows[CHUNK_SIZE];
+    int population;
+    QImage image; // a pixel per cell, coloured by its colour table: 0 is dead and 1 is live
+    bool dirty = true; // have the cells changed since image was drawn?
+  };
+  
+  // Get the rect of the chunk at (x, y), in scene coordinates.
+  static QRectF chunkRect(int x, int y);
+  
+  // Paint whatever's in the rect exposed, in scene coordinates: chunks or density tiles, by how far we're zoomed out.
+  void paintExposed(QPainter* painter, const QRectF& exposed);
+  
+  // Paint the chunks from left to right and top to bottom, inclusive, in chunk coordinates.
+  void paintChunks(QPainter* painter, int left, int top, int right, int bottom);
+  
+  // Paint the tiles of pyramid_'s level covering the rect exposed, in scene coordinates.
+  void paintDensity(QPainter* painter, const QRectF& exposed, int level);
+  
+  // Paint chunk, which is at (x, y).
+  void paintChunk(QPainter* painter, int x, int y, ShownChunk& chunk);
+  
+  // Get the image of chunk's cells in the current theme's colours, redrawing it first if it's out of date.
+  static const QImage& image(ShownChunk& chunk);
+  
+  QRectF bounds_;
+  CoordinateMap<ShownChunk> chunks_; // our copy of the automaton's chunks, by chunk coordinates
+  DensityPyramid pyramid_; // the populations of chunks_, for painting them zoomed out
+  qint64 paintNanoseconds_ = 0; // spent in paint since takePaintTime was last called
+  int paints_ = 0; // likewise
+};
+
+#endif //GAME_OF_LIFE_AUTOMATONGRAPHICSITEM_H
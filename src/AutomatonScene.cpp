@@ -3,16 +3,20 @@
 
 #include "AutomatonScene.h"
 #include "Chunk.h"
-#include "ChunkGraphicsItem.h"
 #include "GraphicsProperties.h"
 
-AutomatonScene::AutomatonScene(Automaton* automaton, QWidget* parent) : QGraphicsScene(parent), automaton_(automaton) {
+AutomatonScene::AutomatonScene(Automaton* automaton, QWidget* parent) : QGraphicsScene(parent), automaton_(automaton),
+    automatonItem_(new AutomatonGraphicsItem) {
+  setItemIndexMethod(QGraphicsScene::NoIndex); // there are only ever a couple of items
+  addItem(automatonItem_);
   updateBackground();
 }
 
 AutomatonScene::~AutomatonScene() {
   delete validRect_;
   validRect_ = nullptr;
+  delete automatonItem_;
+  automatonItem_ = nullptr;
 }
 
 void AutomatonScene::updateBackground() {
@@ -27,24 +31,25 @@ void AutomatonScene::updateBackground() {
     setBackgroundBrush(GraphicsProperties::instance().outOfBoundsColor());
     
     validRect_ = new QGraphicsRectItem(0.0, 0.0,
-        ChunkGraphicsItem::SIZE * automaton_->topology().width(),
-        ChunkGraphicsItem::SIZE * automaton_->topology().height());
+        AutomatonGraphicsItem::CHUNK_SCENE_SIZE * automaton_->topology().width(),
+        AutomatonGraphicsItem::CHUNK_SCENE_SIZE * automaton_->topology().height());
     validRect_->setBrush(GraphicsProperties::instance().deadColor());
     validRect_->setPen(Qt::NoPen);
     validRect_->setZValue(-1.0); // behind all the default z 0.0 stuff
     addItem(validRect_);
     
     // allow scrolling one chunk past the edge
-    setSceneRect(-ChunkGraphicsItem::SIZE, -ChunkGraphicsItem::SIZE,
-        ChunkGraphicsItem::SIZE * (automaton_->topology().width() + 2),
-        ChunkGraphicsItem::SIZE * (automaton_->topology().height() + 2));
+    setSceneRect(-AutomatonGraphicsItem::CHUNK_SCENE_SIZE, -AutomatonGraphicsItem::CHUNK_SCENE_SIZE,
+        AutomatonGraphicsItem::CHUNK_SCENE_SIZE * (automaton_->topology().width() + 2),
+        AutomatonGraphicsItem::CHUNK_SCENE_SIZE * (automaton_->topology().height() + 2));
   } else {
     setBackgroundBrush(GraphicsProperties::instance().deadColor());
     
     // allow scrolling pretty much wherever
-    setSceneRect(-1000 * ChunkGraphicsItem::SIZE, -1000 * ChunkGraphicsItem::SIZE,
-        2000 * ChunkGraphicsItem::SIZE, 2000 * ChunkGraphicsItem::SIZE);
+    setSceneRect(-1000 * AutomatonGraphicsItem::CHUNK_SCENE_SIZE, -1000 * AutomatonGraphicsItem::CHUNK_SCENE_SIZE,
+        2000 * AutomatonGraphicsItem::CHUNK_SCENE_SIZE, 2000 * AutomatonGraphicsItem::CHUNK_SCENE_SIZE);
   }
+  automatonItem_->setBounds(sceneRect());
 }
 
 void AutomatonScene::updateAutomaton(Automaton* automaton) {
@@ -53,6 +58,14 @@ void AutomatonScene::updateAutomaton(Automaton* automaton) {
   update();
 }
 
+void AutomatonScene::applyFrame(const Simulation::Frame& frame) {
+  automatonItem_->applyFrame(frame);
+}
+
+AutomatonGraphicsItem& AutomatonScene::automatonItem() noexcept {
+  return *automatonItem_;
+}
+
 void AutomatonScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event) {
   // Flip the cell with a left click
   if (event->button() != Qt::LeftButton) return;
@@ -61,33 +74,26 @@ void AutomatonScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event) {
   
   // Calculate chunk and cell positions from scenePos
   // hopefully this takes into account scroll position? also hopefully we can scroll?
-  int chunkX = (int) (pos.x() / ChunkGraphicsItem::SIZE);
-  int chunkY = (int) (pos.y() / ChunkGraphicsItem::SIZE);
+  int chunkX = (int) (pos.x() / AutomatonGraphicsItem::CHUNK_SCENE_SIZE);
+  int chunkY = (int) (pos.y() / AutomatonGraphicsItem::CHUNK_SCENE_SIZE);
   
   if (!automaton_->topology().valid(chunkX, chunkY)) {
     return; // don't process in cases where the topology wraps around
   }
   
-  qreal relCellX = pos.x() - chunkX*ChunkGraphicsItem::SIZE;
-  qreal relCellY = pos.y() - chunkY*ChunkGraphicsItem::SIZE;
+  qreal relCellX = pos.x() - chunkX*AutomatonGraphicsItem::CHUNK_SCENE_SIZE;
+  qreal relCellY = pos.y() - chunkY*AutomatonGraphicsItem::CHUNK_SCENE_SIZE;
   if (relCellX < 0) {
-    relCellX += ChunkGraphicsItem::SIZE;
+    relCellX += AutomatonGraphicsItem::CHUNK_SCENE_SIZE;
     chunkX--;
   }
   if (relCellY < 0) {
-    relCellY += ChunkGraphicsItem::SIZE;
+    relCellY += AutomatonGraphicsItem::CHUNK_SCENE_SIZE;
     chunkY--;
   }
-  int cellX = (int) (relCellX / (ChunkGraphicsItem::SIZE / CHUNK_SIZE));
-  int cellY = (int) (relCellY / (ChunkGraphicsItem::SIZE / CHUNK_SIZE));
-  
-  // Flip the cell in the chunk, adding it if it doesn't exist
-  automaton_->chunkArray().insertOrNoop(chunkX, chunkY);
-  Chunk& chunk = automaton_->chunkArray().at(chunkX, chunkY);
-  chunk.setCell(cellX, cellY, !chunk.getCell(cellX, cellY));
-  
-  // Keep the automaton's population accurate
-  automaton_->addToPopulation(chunk.getCell(cellX, cellY) ? 1 : -1); // added or took away a cell
+  int cellX = (int) (relCellX / (AutomatonGraphicsItem::CHUNK_SCENE_SIZE / CHUNK_SIZE));
+  int cellY = (int) (relCellY / (AutomatonGraphicsItem::CHUNK_SCENE_SIZE / CHUNK_SIZE));
   
-  emit cellUpdated(chunkX, chunkY, cellX, cellY);
+  // Whoever runs the automaton flips the cell between ticks
+  emit cellClicked(chunkX * CHUNK_SIZE + cellX, chunkY * CHUNK_SIZE + cellY);
 }
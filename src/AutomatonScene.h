@@ -7,14 +7,17 @@
 #include <QWidget>
 
 #include "Automaton.h"
+#include "AutomatonGraphicsItem.h"
+#include "Simulation.h"
 
-// The QGraphicsScene subclass which handles mouse events and formally represents the Automaton on-screen.
+// The QGraphicsScene subclass which handles mouse events and formally represents the Automaton on-screen, with one
+// AutomatonGraphicsItem painting all of its chunks.
 class AutomatonScene : public QGraphicsScene {
   Q_OBJECT
   
 public:
-  // Initialize with the given automaton pointer. We do not own this pointer. Update it with updateAutomaton(Automaton*)
-  // whenever it is invalidated.
+  // Initialize with the given automaton pointer, which is only used for its topology. We do not own this pointer.
+  // Update it with updateAutomaton(Automaton*) whenever it is invalidated.
   explicit AutomatonScene(Automaton* automaton, QWidget* parent = nullptr);
   ~AutomatonScene() override;
   
@@ -24,16 +27,23 @@ public:
   // Change the old automaton's reference for this one and update. Use when the old automaton pointer was invalidated.
   void updateAutomaton(Automaton* automaton);
   
+  // Show the chunks inserted, erased and changed in a frame taken from the Simulation running the automaton.
+  void applyFrame(const Simulation::Frame& frame);
+  
+  // Get the item painting the chunks.
+  AutomatonGraphicsItem& automatonItem() noexcept;
+  
 signals:
-  // Emitted when the user clicks on the specified cell.
-  void cellUpdated(int chunkX, int chunkY, int cellX, int cellY);
+  // Emitted when the user clicks on the cell at (x, y), in cell coordinates, to flip it.
+  void cellClicked(int x, int y);
   
 protected:
   void mouseReleaseEvent(QGraphicsSceneMouseEvent* event) override;
   
 private:
-  Automaton* automaton_; // we hold a pointer to the automaton in order to add chunks, but don't own it
+  Automaton* automaton_; // we hold a pointer to the automaton for its topology, but don't own it
   QGraphicsRectItem* validRect_ = nullptr; // the rectangle where cells are valid; we own this
+  AutomatonGraphicsItem* automatonItem_; // paints the chunks; we own this
 };
 
 #endif //GAME_OF_LIFE_AUTOMATONSCENE_H
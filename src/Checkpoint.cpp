@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define GAME_OF_LIFE_CHECKPOINT_MMAP // map checkpoints into memory instead of reading them
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h> // for MoveFileExA
+#endif
+
+#include "Checkpoint.h"
+
+constexpr std::size_t Checkpoint::WRITE_BUFFER_SIZE;
+
+// File layout
+
+// The file is the header, then the born table and the survive table (a byte per number of neighbours, 0 or 1), padded
+// to a multiple of 8 bytes, then the index (an IndexEntry per chunk, sorted by y and then x), then each chunk's rows
+// in the same order (CHUNK_SIZE 32-bit rows per chunk, the cell (x, y) being bit x of row y).
+struct Checkpoint::Header {
+  char magic[8]; // MAGIC
+  std::uint32_t byteOrder; // BYTE_ORDER_MARK as the writer stored it
+  std::uint32_t version; // VERSION
+  std::uint32_t chunkSize; // CHUNK_SIZE of the writer
+  std::uint32_t neighbourhood; // a NeighbourhoodKind
+  std::int32_t radius;
+  std::uint32_t topology; // a TopologyKind
+  std::int32_t width; // in chunks, if the topology is bounded
+  std::int32_t height;
+  std::int64_t generation;
+  std::int64_t population;
+  std::uint64_t ruleCount; // the number of entries in each of the born and survive tables
+  std::uint64_t chunkCount;
+  std::uint64_t indexOffset; // where the index starts, from the start of the file
+  std::uint64_t rowsOffset; // where the rows start
+};
+
+struct Checkpoint::IndexEntry {
+  std::int32_t x;
+  std::int32_t y;
+};
+
+namespace { // local to this file
+  typedef std::uint32_t StoredRow;
+  static_assert(CHUNK_SIZE <= 32, "Checkpoints store each row of a chunk in 32 bits");
+  
+  const char MAGIC[8] = {'G', 'O', 'L', 'C', 'K', 'P', 'T', '\0'};
+  const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+  const std::uint32_t VERSION = 1;
+  
+  enum NeighbourhoodKind : std::uint32_t {
+    MOORE = 0,
+    VON_NEUMANN = 1
+  };
+  
+  enum TopologyKind : std::uint32_t {
+    UNBOUNDED = 0,
+    FIXED = 1,
+    WRAPPING = 2
+  };
+  
+  constexpr std::size_t CHUNK_BYTES = CHUNK_SIZE * sizeof(StoredRow);
+  
+  std::uint64_t alignTo8(std::uint64_t offset) {
+    return (offset + 7) & ~std::uint64_t(7);
+  }
+  
+  // Make the neighbourhood type a header describes. Throw std::invalid_argument if its radius is one the neighbourhood
+  // can't have.
+  NeighbourhoodType* makeNeighbourhoodType(std::uint32_t kind, int radius) {
+    if (kind == MOORE) {
+      return new MooreNeighbourhoodType(radius);
+    }
+    return new VonNeumannNeighbourhoodType(radius);
+  }
+  
+  // Can the neighbourhood type a header describes be made?
+  bool neighbourhoodTypeValid(std::uint32_t kind, int radius) {
+    if (kind > VON_NEUMANN) return false;
+    try {
+      std::unique_ptr<NeighbourhoodType>(makeNeighbourhoodType(kind, radius));
+    } catch (std::invalid_argument&) {
+      return false;
+    }
+    return true;
+  }
+  
+  // Does entry come before the chunk at (x, y) in the file?
+  template<typename Entry>
+  bool before(const Entry& entry, int x, int y) {
+    return entry.y != y ? entry.y < y : entry.x < x;
+  }
+  
+  // Move the file at from to to, replacing any file already there. Return whether it worked.
+  bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    // std::rename won't replace a file on Windows
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+  }
+  
+  // A file being written through a large buffer, removed again if it's never finished.
+  class OutputFile {
+  public:
+    explicit OutputFile(const std::string& path) : path_(path), file_(std::fopen(path.c_str(), "wb")) {
+      if (!file_) {
+        throw std::runtime_error("Cannot write " + path);
+      }
+      std::setvbuf(file_, nullptr, _IOFBF, Checkpoint::WRITE_BUFFER_SIZE);
+    }
+    
+    ~OutputFile() {
+      if (file_) {
+        std::fclose(file_);
+        std::remove(path_.c_str());
+      }
+    }
+    
+    void write(const void* data, std::size_t size) {
+      if (std::fwrite(data, 1, size, file_) != size) {
+        throw std::runtime_error("Cannot write " + path_);
+      }
+    }
+    
+    // Flush and close the file. Throw std::runtime_error if any of it couldn't be written.
+    void close() {
+      bool failed = std::fflush(file_) != 0 || std::ferror(file_) != 0;
+      failed = std::fclose(file_) != 0 || failed;
+      file_ = nullptr;
+      if (failed) {
+        std::remove(path_.c_str());
+        throw std::runtime_error("Cannot write " + path_);
+      }
+    }
+  
+  private:
+    std::string path_;
+    std::FILE* file_;
+  };
+}
+
+// Saving
+
+void Checkpoint::save(const std::string& path, Automaton& automaton) {
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.version = VERSION;
+  header.chunkSize = CHUNK_SIZE;
+  
+  const NeighbourhoodType& neighbourhoodType = automaton.ruleset().getNeighbourhoodType();
+  if (dynamic_cast<const MooreNeighbourhoodType*>(&neighbourhoodType)) {
+    header.neighbourhood = MOORE;
+  } else if (dynamic_cast<const VonNeumannNeighbourhoodType*>(&neighbourhoodType)) {
+    header.neighbourhood = VON_NEUMANN;
+  } else {
+    throw std::invalid_argument("Checkpoints can only store Moore and von Neumann neighbourhoods");
+  }
+  header.radius = neighbourhoodType.getRadius();
+  
+  const Topology& topology = automaton.topology();
+  if (dynamic_cast<const FixedTopology*>(&topology)) {
+    header.topology = FIXED;
+  } else if (dynamic_cast<const WrappingTopology*>(&topology)) {
+    header.topology = WRAPPING;
+  } else if (dynamic_cast<const UnboundedTopology*>(&topology)) {
+    header.topology = UNBOUNDED;
+  } else {
+    throw std::invalid_argument("Checkpoints can only store fixed, wrapping and unbounded topologies");
+  }
+  header.width = topology.width();
+  header.height = topology.height();
+  
+  header.generation = automaton.generation();
+  header.population = automaton.population();
+  
+  // The born table, then the survive table
+  std::vector<char> rules;
+  unsigned int numCells = neighbourhoodType.getNumCells();
+  for (unsigned int n = 0; n <= numCells; n++) {
+    rules.push_back(automaton.ruleset().isBornWith(n));
+  }
+  for (unsigned int n = 0; n <= numCells; n++) {
+    rules.push_back(automaton.ruleset().survivesWith(n));
+  }
+  header.ruleCount = numCells + 1;
+  header.indexOffset = alignTo8(sizeof(Header) + rules.size());
+  rules.resize(header.indexOffset - sizeof(Header));
+  
+  std::vector<const Chunk*> chunks;
+  for (auto& entry : automaton.chunkArray()) {
+    if (!entry.value->isEmpty()) {
+      chunks.push_back(entry.value);
+    }
+  }
+  std::sort(chunks.begin(), chunks.end(), [] (const Chunk* a, const Chunk* b) {
+    return before(IndexEntry{a->chunkX, a->chunkY}, b->chunkX, b->chunkY);
+  });
+  header.chunkCount = chunks.size();
+  header.rowsOffset = header.indexOffset + chunks.size() * sizeof(IndexEntry);
+  
+  // Written beside the old checkpoint and moved over it, so a crash part way through never loses the last one
+  std::string temporaryPath = path + ".tmp";
+  {
+    OutputFile file(temporaryPath);
+    file.write(&header, sizeof header);
+    file.write(rules.data(), rules.size());
+    for (const Chunk* chunk : chunks) {
+      IndexEntry entry{chunk->chunkX, chunk->chunkY};
+      file.write(&entry, sizeof entry);
+    }
+    for (const Chunk* chunk : chunks) {
+      StoredRow rows[CHUNK_SIZE];
+      for (int y = 0; y < CHUNK_SIZE; y++) {
+        rows[y] = (StoredRow) chunk->row(y);
+      }
+      file.write(rows, sizeof rows);
+    }
+    file.close();
+  }
+  if (!replaceFile(temporaryPath, path)) {
+    std::remove(temporaryPath.c_str());
+    throw std::runtime_error("Cannot write " + path);
+  }
+}
+
+// Opening
+
+Checkpoint::Checkpoint(const std::string& path) {
+#ifdef GAME_OF_LIFE_CHECKPOINT_MMAP
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  struct stat status{};
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot open " + path);
+  }
+  size_ = (std::size_t) status.st_size;
+  if (size_ != 0) {
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Cannot map " + path);
+    }
+    data_ = static_cast<const char*>(mapping);
+  }
+  close(fd); // the mapping keeps the file open
+#else
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#endif
+  
+  // Check everything the rest of the class trusts, unmapping again if it's wrong
+  const char* problem = nullptr;
+  if (size_ < sizeof(Header) || std::memcmp(header().magic, MAGIC, sizeof MAGIC) != 0) {
+    problem = " is not a checkpoint";
+  } else if (header().byteOrder != BYTE_ORDER_MARK || header().version != VERSION) {
+    problem = " was written by an incompatible version or machine";
+  } else if (header().chunkSize != CHUNK_SIZE) {
+    problem = " was written with a different chunk size";
+  } else if (!neighbourhoodTypeValid(header().neighbourhood, header().radius) || header().topology > WRAPPING
+      || (header().topology != UNBOUNDED && (header().width <= 0 || header().height <= 0))) {
+    problem = " has a bad header";
+  } else {
+    std::uint64_t size = size_;
+    const Header& h = header();
+    if (h.ruleCount > size || h.indexOffset < sizeof(Header) + 2 * h.ruleCount || h.indexOffset % 8 != 0
+        || h.chunkCount > size / sizeof(IndexEntry) || h.indexOffset > size - h.chunkCount * sizeof(IndexEntry)
+        || h.rowsOffset != h.indexOffset + h.chunkCount * sizeof(IndexEntry)
+        || h.chunkCount > (size - h.rowsOffset) / CHUNK_BYTES || h.rowsOffset + h.chunkCount * CHUNK_BYTES != size) {
+      problem = " is truncated or corrupt";
+    }
+  }
+  if (problem) {
+#ifdef GAME_OF_LIFE_CHECKPOINT_MMAP
+    if (data_) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+    throw std::invalid_argument(path + problem);
+  }
+}
+
+Checkpoint::~Checkpoint() {
+#ifdef GAME_OF_LIFE_CHECKPOINT_MMAP
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+}
+
+// Reading
+
+long long Checkpoint::generation() const noexcept {
+  return header().generation;
+}
+
+long long Checkpoint::population() const noexcept {
+  return header().population;
+}
+
+std::size_t Checkpoint::chunkCount() const noexcept {
+  return (std::size_t) header().chunkCount;
+}
+
+Automaton* Checkpoint::restore() const {
+  const Header& h = header();
+  Topology* topology;
+  if (h.topology == FIXED) {
+    topology = new FixedTopology(h.width, h.height);
+  } else if (h.topology == WRAPPING) {
+    topology = new WrappingTopology(h.width, h.height);
+  } else {
+    topology = new UnboundedTopology;
+  }
+  std::unique_ptr<Automaton> automaton(new Automaton(topology, makeNeighbourhoodType(h.neighbourhood, h.radius)));
+  
+  Ruleset& ruleset = automaton->ruleset();
+  if (h.ruleCount != ruleset.getNeighbourhoodType().getNumCells() + 1) {
+    throw std::invalid_argument("The checkpoint's rules don't fit its neighbourhood");
+  }
+  const char* rules = data_ + sizeof(Header);
+  for (unsigned int n = 0; n < h.ruleCount; n++) {
+    ruleset.setBornWith(n, rules[n] != 0);
+    ruleset.setSurvivesWith(n, rules[h.ruleCount + n] != 0);
+  }
+  
+  automaton->setGeneration(h.generation);
+#ifdef GAME_OF_LIFE_CHECKPOINT_MMAP
+  if (h.chunkCount != 0) {
+    madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL); // every chunk, in order
+  }
+#endif
+  for (std::size_t i = 0; i < h.chunkCount; i++) {
+    loadChunk(*automaton, i);
+  }
+  return automaton.release();
+}
+
+std::size_t Checkpoint::loadRegion(Automaton& automaton, int left, int top, int right, int bottom) const {
+  if (left > right || top > bottom) return 0;
+  
+  // Walk the index from (left, top), skipping each row's chunks outside [left, right] by binary search
+  const IndexEntry* begin = index();
+  const IndexEntry* end = begin + header().chunkCount;
+  auto seek = [end] (const IndexEntry* from, int x, int y) {
+    return std::lower_bound(from, end, 0, [x, y] (const IndexEntry& entry, int) { return before(entry, x, y); });
+  };
+  std::size_t loaded = 0;
+  const IndexEntry* entry = seek(begin, left, top);
+  while (entry != end && entry->y <= bottom) {
+    if (entry->x < left) {
+      entry = seek(entry, left, entry->y);
+    } else if (entry->x > right) {
+      if (entry->y == bottom) break;
+      entry = seek(entry, left, entry->y + 1);
+    } else {
+      loadChunk(automaton, entry - begin);
+      loaded++;
+      entry++;
+    }
+  }
+  return loaded;
+}
+
+void Checkpoint::loadChunk(Automaton& automaton, std::size_t index) const {
+  const IndexEntry& entry = this->index()[index];
+  StoredRow rows[CHUNK_SIZE];
+  std::memcpy(rows, data_ + header().rowsOffset + index * CHUNK_BYTES, CHUNK_BYTES);
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    if (rows[y] != 0) {
+      automaton.addLiveCells(entry.x, entry.y, y, rows[y] & Chunk::ROW_MASK);
+    }
+  }
+}
+
+const Checkpoint::Header& Checkpoint::header() const noexcept {
+  return *reinterpret_cast<const Header*>(data_);
+}
+
+const Checkpoint::IndexEntry* Checkpoint::index() const noexcept {
+  return reinterpret_cast<const IndexEntry*>(data_ + header().indexOffset);
+}
@@ -0,0 +1,65 @@
+#ifndef GAME_OF_LIFE_CHECKPOINT_H
+#define GAME_OF_LIFE_CHECKPOINT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Automaton.h"
+
+// A binary snapshot of an Automaton, for stopping long runs and picking them up again: the topology, the neighbourhood
+// type, the born and survive tables, the generation and every non-empty chunk's rows. The chunks are stored sorted by
+// chunk coordinates, north to south and west to east along each row, with an index of their coordinates ahead of their
+// rows, so the chunks in a region can be found by binary search and loaded without touching the rest of the file.
+// Files are written with large sequential writes and opened by mapping them into memory, so opening one is instant and
+// only the pages actually loaded from are ever read from disk.
+// The file is in the byte order of the machine which wrote it, and can only be opened by builds with the same
+// CHUNK_SIZE.
+class Checkpoint {
+public:
+  // Write automaton to a checkpoint at path, replacing the file there only once the whole checkpoint has been written.
+  // Throw std::runtime_error if it can't be written, or std::invalid_argument if the automaton's topology or
+  // neighbourhood type isn't one a checkpoint knows how to describe.
+  static void save(const std::string& path, Automaton& automaton);
+  
+  // Open the checkpoint at path. Throw std::runtime_error if it can't be read, or std::invalid_argument if it isn't a
+  // checkpoint this build can open.
+  explicit Checkpoint(const std::string& path);
+  
+  ~Checkpoint();
+  
+  Checkpoint(const Checkpoint&) = delete;
+  Checkpoint& operator=(const Checkpoint&) = delete;
+  
+  long long generation() const noexcept; // Get the generation the automaton was at.
+  long long population() const noexcept; // Get the number of live cells the automaton had.
+  std::size_t chunkCount() const noexcept; // Get the number of non-empty chunks stored.
+  
+  // Make a new Automaton with the stored topology, neighbourhood type, rules, generation and cells. The caller is
+  // responsible for managing the pointer.
+  Automaton* restore() const;
+  
+  // Make the live cells of the stored chunks with chunk coordinates from (left, top) to (right, bottom), inclusive, live
+  // in automaton, reading only their rows. Return the number of chunks loaded. This doesn't change anything else about
+  // automaton, so it can load part of a checkpoint into one which is already showing some other part.
+  // Throw std::out_of_range if a chunk is outside the automaton's topology.
+  std::size_t loadRegion(Automaton& automaton, int left, int top, int right, int bottom) const;
+  
+  static constexpr std::size_t WRITE_BUFFER_SIZE = 4u << 20; // how much save() gathers into each write
+  
+private:
+  struct Header; // the fixed-size start of the file
+  struct IndexEntry; // the coordinates of a stored chunk
+  
+  // Make the cells of the index-th stored chunk live in automaton.
+  void loadChunk(Automaton& automaton, std::size_t index) const;
+  
+  const Header& header() const noexcept;
+  const IndexEntry* index() const noexcept;
+  
+  const char* data_ = nullptr; // the whole file, mapped or read into memory
+  std::size_t size_ = 0; // the size of the file
+  std::vector<char> buffer_; // the file's contents where it can't be mapped
+};
+
+#endif //GAME_OF_LIFE_CHECKPOINT_H
@@ -1,11 +1,46 @@
+#include <algorithm>
+#include <cstring>
+#include <new>
 #include <stdexcept>
 #include <utility>
 
 #include "Chunk.h"
 
+// ChunkState
+
+const ChunkState ChunkState::EMPTY = {};
+
 // Chunk
 
-Chunk::Chunk(int x, int y) noexcept : chunkX(x), chunkY(y) {}
+constexpr Chunk::Row Chunk::ROW_MASK;
+constexpr int Chunk::MAX_PERIOD;
+
+Chunk::Chunk(int x, int y) noexcept : chunkX(x), chunkY(y) {
+  neighbours_[1][1] = this;
+  for (const ChunkState*& state : states_) {
+    state = &ChunkState::EMPTY;
+  }
+  rows_ = ChunkState::EMPTY.rows;
+}
+
+void Chunk::reset(int x, int y) {
+  chunkX = x;
+  chunkY = y;
+  memset(neighbours_, 0, sizeof(neighbours_));
+  neighbours_[1][1] = this;
+  for (const ChunkState*& state : states_) {
+    state = &ChunkState::EMPTY;
+  }
+  current_ = 0;
+  rows_ = ChunkState::EMPTY.rows;
+  draft_ = nullptr;
+  memset(newRows_, 0, sizeof(newRows_));
+  liveCellCount_ = 0;
+  history_ = 0;
+  replaying_ = 0;
+  isolatedTicks_ = 0;
+  changed_ = false;
+}
 
 void Chunk::checkInBounds(int x, int y) {
   if (x < 0 || y < 0 || x >= CHUNK_SIZE || y >= CHUNK_SIZE) {
@@ -17,13 +52,17 @@ void Chunk::updateNewCell(const Ruleset& ruleset, Neighbourhood& neighbourhood,
   side.transform(x, y, CHUNK_SIZE, CHUNK_SIZE);
   checkInBounds(x, y);
   unsigned int liveCount = neighbourhood.getLiveCount();
-  if (cells_[x][y]) {
-    newCells_[x][y] = ruleset.survivesWith(liveCount);
+  Row bit = Row(1) << x;
+  bool alive;
+  if (rows_[y] & bit) {
+    alive = ruleset.survivesWith(liveCount);
   } else {
-    newCells_[x][y] = ruleset.isBornWith(liveCount);
+    alive = ruleset.isBornWith(liveCount);
   }
-  if (newCells_[x][y]) {
-    nextLiveCellCount_++;
+  if (alive) {
+    newRows_[y] |= bit;
+  } else {
+    newRows_[y] &= ~bit;
   }
 }
 
@@ -67,37 +106,95 @@ void Chunk::generate(const Ruleset& ruleset, Neighbourhood& neighbourhood) {
   generate(ruleset, neighbourhood, Side::CONST_BOTTOM, CHUNK_SIZE); // CONST_BOTTOM to not construct another Side
 }
 
+void Chunk::setNextRow(int y, Row next, Row columnMask) noexcept {
+  columnMask &= ROW_MASK;
+  newRows_[y] = (newRows_[y] & ~columnMask) | (next & columnMask);
+}
+
+int Chunk::addLiveCells(int y, Row bits) {
+  Row added = bits & ROW_MASK & ~rows_[y];
+  if (added == 0) {
+    return 0;
+  }
+  editableRows()[y] |= added;
+  int count = popcount(added);
+  liveCellCount_ += count;
+  changed_ = true;
+  history_ = 0;
+  return count;
+}
+
+Chunk::Row* Chunk::editableRows() {
+  if (draft_ == nullptr) {
+    // Copy on write: the state may be shared, and is in the table under its cells
+    draft_ = table_->draft(states_[current_]);
+    table_->release(states_[current_]);
+    states_[current_] = draft_;
+    rows_ = draft_->rows;
+  }
+  return draft_->rows;
+}
+
+void Chunk::releaseStates() {
+  for (const ChunkState*& state : states_) {
+    table_->release(state);
+    state = &ChunkState::EMPTY;
+  }
+  draft_ = nullptr;
+}
+
 void Chunk::update() {
-  if (isEmpty() && isNextGenEmpty()) {
-    // no point, we won't update anything
-    return;
+  if (draft_ != nullptr) { // edited, so into the table with it before it becomes history
+    states_[current_] = table_->intern(draft_);
+    draft_ = nullptr;
   }
   
-  // this is probably performance critical, so memcpy/memset it is
-  memcpy(cells_, newCells_, CHUNK_SIZE*CHUNK_SIZE*sizeof(cells_[0][0]));
-  memset(newCells_, 0, CHUNK_SIZE*CHUNK_SIZE*sizeof(newCells_[0][0])); // the next generation starts at 0
-  
-  liveCellCount_ = nextLiveCellCount_;
-  nextLiveCellCount_ = 0; // until proven otherwise
+  // The next generation takes the place of the oldest one
+  const ChunkState* state;
+  if (replaying_ != 0) {
+    // The generation after the one it repeats
+    state = states_[stateIndex(replaying_ - 1)];
+    ChunkStateTable::addReference(state);
+    replaying_ = 0;
+  } else if (isEmpty() && isNextGenEmpty()) {
+    state = &ChunkState::EMPTY; // no point looking nothing up
+  } else {
+    state = table_->intern(newRows_);
+    memset(newRows_, 0, sizeof(newRows_)); // the next generation starts at 0
+  }
+  int next = stateIndex(MAX_PERIOD);
+  table_->release(states_[next]);
+  states_[next] = state;
   
-  emit chunkChanged(cells_);
+  // Still lifes shouldn't be repainted every tick; the same cells are the same state
+  if (state != states_[current_]) {
+    changed_ = true;
+  }
+  current_ = next;
+  rows_ = state->rows;
+  liveCellCount_ = state->population;
+  history_ = std::min(history_ + 1, MAX_PERIOD);
 }
 
 bool Chunk::getCell(int x, int y) const {
   checkInBounds(x, y);
-  return cells_[x][y];
+  return (rows_[y] >> x & 1u) != 0;
 }
 
 void Chunk::setCell(int x, int y, bool value) {
   checkInBounds(x, y);
-  if (cells_[x][y] != value) { // prevent emitting signals when nothing changes
-    cells_[x][y] = value;
+  Row bit = Row(1) << x;
+  if (((rows_[y] & bit) != 0) != value) { // only mark the chunk changed when something does
+    Row* rows = editableRows();
     if (value) {
+      rows[y] |= bit;
       liveCellCount_++;
     } else {
+      rows[y] &= ~bit;
       liveCellCount_--;
     }
-    emit chunkChanged(cells_);
+    changed_ = true;
+    history_ = 0; // edits don't follow from the generations before
   }
 }
 
@@ -106,46 +203,348 @@ bool Chunk::isEmpty() const noexcept {
 }
 
 bool Chunk::isNextGenEmpty() const noexcept {
-  return nextLiveCellCount_ == 0;
+  for (Row row : newRows_) {
+    if (row) return false;
+  }
+  return true;
 }
 
 int Chunk::population() const noexcept {
   return liveCellCount_;
 }
 
+bool Chunk::repeatsAfter(int period) const noexcept {
+  if (period > history_) return false;
+  return states_[stateIndex(period)] == states_[current_];
+}
+
+void Chunk::replay(int period) noexcept {
+  replaying_ = period;
+}
+
+void Chunk::forgetHistory() noexcept {
+  history_ = 0;
+}
+
+bool Chunk::emptyThroughHistory() const noexcept {
+  if (history_ < MAX_PERIOD) return false;
+  for (const ChunkState* state : states_) {
+    if (state != &ChunkState::EMPTY) return false;
+  }
+  return true;
+}
+
+unsigned int Chunk::countIsolatedTick(bool isolated) noexcept {
+  isolatedTicks_ = isolated ? isolatedTicks_ + 1 : 0;
+  return isolatedTicks_;
+}
+
+// ChunkStateTable
+
+constexpr std::size_t ChunkStateTable::SHARDS;
+constexpr std::size_t ChunkStateTable::STATES_PER_SLAB;
+
+ChunkStateTable::ChunkStateTable() : shards_(new Shard[SHARDS]) {
+  for (std::size_t i = 0; i < SHARDS; i++) {
+    shards_[i].buckets.assign(16, nullptr);
+  }
+}
+
+ChunkStateTable::~ChunkStateTable() = default; // the slabs go with the shards
+
+std::uint64_t ChunkStateTable::hash(const std::uint64_t* rows) noexcept {
+  std::uint64_t hash = 0;
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    hash = hashRow(hash, rows[y]);
+  }
+  return hash;
+}
+
+const ChunkState* ChunkStateTable::intern(const std::uint64_t* rows) {
+  std::uint64_t hash = ChunkStateTable::hash(rows);
+  if (hash == 0 && std::all_of(rows, rows + CHUNK_SIZE, [] (std::uint64_t row) { return row == 0; })) {
+    return &ChunkState::EMPTY;
+  }
+  
+  Shard& shard = shardFor(hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const ChunkState* found = find(shard, rows, hash);
+  if (found != nullptr) return found;
+  
+  ChunkState* state = allocate(shard);
+  std::copy(rows, rows + CHUNK_SIZE, state->rows);
+  state->hash = hash;
+  state->population = 0;
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    state->population += popcount(rows[y]);
+  }
+  state->references.store(1, std::memory_order_relaxed);
+  insert(shard, state);
+  return state;
+}
+
+const ChunkState* ChunkStateTable::intern(ChunkState* draft) {
+  // The draft is ours alone, so it can be worked on without the lock
+  draft->hash = hash(draft->rows);
+  draft->population = 0;
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    draft->population += popcount(draft->rows[y]);
+  }
+  if (draft->population == 0) {
+    release(draft);
+    return &ChunkState::EMPTY;
+  }
+  
+  const ChunkState* interned;
+  {
+    Shard& shard = shardFor(draft->hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    interned = find(shard, draft->rows, draft->hash);
+    if (interned == nullptr) {
+      if (&shard == &shards_[draft->shard]) {
+        insert(shard, draft);
+        return draft;
+      }
+      
+      // The draft came from another shard, where its old cells hashed to, so copy it into one of this shard's own
+      // states: release only locks the shard a state came from
+      ChunkState* state = allocate(shard);
+      std::copy(draft->rows, draft->rows + CHUNK_SIZE, state->rows);
+      state->hash = draft->hash;
+      state->population = draft->population;
+      state->references.store(1, std::memory_order_relaxed);
+      insert(shard, state);
+      interned = state;
+    }
+  }
+  
+  // Either someone has these cells already or they've been copied, so the draft isn't needed
+  Shard& owner = shards_[draft->shard];
+  std::lock_guard<std::mutex> lock(owner.mutex);
+  draft->references.store(0, std::memory_order_relaxed);
+  recycle(owner, draft);
+  return interned;
+}
+
+ChunkState* ChunkStateTable::draft(const ChunkState* state) {
+  ChunkState* draft;
+  {
+    Shard& shard = shardFor(state->hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    draft = allocate(shard);
+  }
+  std::copy(state->rows, state->rows + CHUNK_SIZE, draft->rows);
+  draft->hash = state->hash;
+  draft->population = state->population;
+  draft->references.store(1, std::memory_order_relaxed);
+  draft->interned = false;
+  draft->chained = nullptr;
+  return draft;
+}
+
+void ChunkStateTable::addReference(const ChunkState* state) noexcept {
+  if (state == &ChunkState::EMPTY) return;
+  state->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ChunkStateTable::release(const ChunkState* state) {
+  if (state == &ChunkState::EMPTY) return;
+  if (state->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+  
+  // Dead, so find won't hand it out again, but it may still be in a bucket if find hasn't tidied it away yet. States
+  // are only ever interned in the shard they came from, so that shard's lock covers both
+  ChunkState* dead = const_cast<ChunkState*>(state); // only the table ever makes states, and never const ones
+  Shard& shard = shards_[dead->shard];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (dead->interned) {
+    ChunkState** link = &bucketFor(shard, dead->hash);
+    while (*link != dead) {
+      link = &(*link)->chained;
+    }
+    *link = dead->chained;
+    dead->interned = false;
+    shard.count--;
+  }
+  recycle(shard, dead);
+}
+
+std::size_t ChunkStateTable::size() const noexcept {
+  std::size_t live = 0;
+  for (std::size_t i = 0; i < SHARDS; i++) {
+    live += shards_[i].live;
+  }
+  return live;
+}
+
+std::size_t ChunkStateTable::memoryUsage() const noexcept {
+  std::size_t bytes = SHARDS * sizeof(Shard);
+  for (std::size_t i = 0; i < SHARDS; i++) {
+    const Shard& shard = shards_[i];
+    bytes += shard.slabs.size() * STATES_PER_SLAB * sizeof(ChunkState)
+        + shard.slabs.capacity() * sizeof(std::unique_ptr<ChunkState[]>)
+        + shard.buckets.capacity() * sizeof(ChunkState*);
+  }
+  return bytes;
+}
+
+ChunkState* ChunkStateTable::allocate(Shard& shard) {
+  shard.live++;
+  ChunkState* state;
+  if (shard.free != nullptr) {
+    state = shard.free;
+    shard.free = state->chained;
+  } else {
+    if (shard.usedInLastSlab == STATES_PER_SLAB) {
+      shard.slabs.emplace_back(new ChunkState[STATES_PER_SLAB]);
+      shard.usedInLastSlab = 0;
+    }
+    state = &shard.slabs.back()[shard.usedInLastSlab++];
+  }
+  state->shard = (std::uint8_t) (&shard - shards_.get());
+  return state;
+}
+
+void ChunkStateTable::recycle(Shard& shard, ChunkState* state) noexcept {
+  state->chained = shard.free;
+  shard.free = state;
+  shard.live--;
+}
+
+const ChunkState* ChunkStateTable::find(Shard& shard, const std::uint64_t* rows, std::uint64_t hash) noexcept {
+  ChunkState** link = &bucketFor(shard, hash);
+  while (*link != nullptr) {
+    ChunkState* state = *link;
+    int references = state->references.load(std::memory_order_relaxed);
+    if (references == 0) {
+      // Dead, and waiting for its releaser to take the lock and recycle it; out of the way with it
+      *link = state->chained;
+      state->interned = false;
+      shard.count--;
+      continue;
+    }
+    
+    // The hashes only rule states out
+    if (state->hash == hash && memcmp(state->rows, rows, sizeof(state->rows)) == 0) {
+      // Only take a reference if it's still alive: it could die on another thread without the lock
+      while (references != 0) {
+        if (state->references.compare_exchange_weak(references, references + 1, std::memory_order_relaxed)) {
+          return state;
+        }
+      }
+      continue; // it died, so it'll be taken out on the next go round
+    }
+    link = &state->chained;
+  }
+  return nullptr;
+}
+
+void ChunkStateTable::insert(Shard& shard, ChunkState* state) {
+  if (shard.count >= shard.buckets.size()) {
+    // Double the buckets, chaining each state into its new one
+    std::vector<ChunkState*> buckets(shard.buckets.size() * 2, nullptr);
+    buckets.swap(shard.buckets);
+    for (ChunkState* chained : buckets) {
+      while (chained != nullptr) {
+        ChunkState* next = chained->chained;
+        ChunkState*& bucket = bucketFor(shard, chained->hash);
+        chained->chained = bucket;
+        bucket = chained;
+        chained = next;
+      }
+    }
+  }
+  ChunkState*& bucket = bucketFor(shard, state->hash);
+  state->chained = bucket;
+  state->interned = true;
+  bucket = state;
+  shard.count++;
+}
+
+// ChunkPool
+
+constexpr std::size_t ChunkPool::CHUNKS_PER_SLAB;
+
+ChunkPool::~ChunkPool() {
+  for (std::size_t slab = 0; slab < slabs_.size(); slab++) {
+    std::size_t used = slab + 1 == slabs_.size() ? usedInLastSlab_ : CHUNKS_PER_SLAB;
+    for (std::size_t i = 0; i < used; i++) {
+      reinterpret_cast<Chunk*>(&slabs_[slab][i])->~Chunk();
+    }
+  }
+}
+
+Chunk* ChunkPool::acquire(int x, int y) {
+  if (!free_.empty()) {
+    Chunk* chunk = free_.back();
+    free_.pop_back();
+    chunk->reset(x, y);
+    chunk->table_ = &states_;
+    return chunk;
+  }
+  
+  if (usedInLastSlab_ == CHUNKS_PER_SLAB) {
+    slabs_.emplace_back(new ChunkStorage[CHUNKS_PER_SLAB]);
+    usedInLastSlab_ = 0;
+  }
+  Chunk* chunk = new (&slabs_.back()[usedInLastSlab_++]) Chunk(x, y);
+  chunk->table_ = &states_;
+  return chunk;
+}
+
+void ChunkPool::release(Chunk* chunk) {
+  chunk->releaseStates();
+  free_.push_back(chunk);
+}
+
+std::size_t ChunkPool::freeCount() const noexcept {
+  return free_.size();
+}
+
+std::size_t ChunkPool::memoryUsage() const noexcept {
+  return slabs_.size() * CHUNKS_PER_SLAB * sizeof(ChunkStorage) + free_.capacity() * sizeof(Chunk*)
+      + states_.memoryUsage();
+}
+
 // ChunkArray
 
 decltype(ChunkArray::EMPTY) ChunkArray::EMPTY(0, 0);
 
 ChunkArray::ChunkArray(Topology* topology) : topology_(topology) {} // adopt the topology for ourselves
 
-ChunkArray::~ChunkArray() {
-  // delete all the Chunks
-  for (const std::pair<const std::pair<int, int>, Chunk*>& element : map_) {
-    emit chunkRemoved(element.first.first, element.first.second);
-    delete element.second;
-  }
-}
+ChunkArray::~ChunkArray() = default; // the Chunks themselves are destroyed with pool_
 
 Topology& ChunkArray::topology() const noexcept {
   return *topology_;
 }
 
+std::size_t ChunkArray::memoryUsage() const noexcept {
+  return pool_.memoryUsage() + map_.memoryUsage() + coordinateQueue_.memoryUsage();
+}
+
 ChunkArray::size_type ChunkArray::size() {
   return map_.size();
 }
 
+void ChunkArray::reserve(size_type count) {
+  map_.reserve(count);
+}
+
 Chunk& ChunkArray::at(int x, int y) const {
   bool ok = topology_->transform(x, y);
   if (!ok) {
     return ChunkArray::EMPTY;
   }
-  return *map_.at({x, y}); // throws std::out_of_range if not present
+  countLookups(1);
+  return *map_.at(x, y); // throws std::out_of_range if not present
 }
 
 bool ChunkArray::contains(int x, int y) const {
   bool ok = topology_->transform(x, y);
-  return ok && map_.count({x, y}) == 1;
+  if (!ok) {
+    return false;
+  }
+  countLookups(1);
+  return map_.contains(x, y);
 }
 
 bool ChunkArray::hasNonEmpty(int x, int y) {
@@ -158,24 +557,75 @@ bool ChunkArray::insertOrNoop(int x, int y) {
     return false;
   }
   
-  std::pair<int, int> xy(x, y);
-  if (map_.count(xy)) {
+  countLookups(1);
+  if (map_.contains(x, y)) {
     return false;
   }
-  map_.emplace(xy, new Chunk(x, y));
-  emit chunkAdded(x, y);
+  Chunk* chunk = pool_.acquire(x, y);
+  map_.insert(x, y, chunk);
+  link(chunk);
+  if (countingOperations_) {
+    countLookups(1);
+    insertions_++;
+  }
+  if (recordingChanges_) {
+    events_.push_back(ChunkEvent{x, y, true});
+  }
   return true;
 }
 
+void ChunkArray::link(Chunk* chunk) {
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      if (dx == 0 && dy == 0) continue;
+      
+      int x = chunk->chunkX + dx, y = chunk->chunkY + dy;
+      Chunk* neighbour;
+      if (!topology_->transform(x, y)) {
+        neighbour = &EMPTY; // treated as empty forever, e.g. past the edge of a FixedTopology
+      } else {
+        Chunk** found = map_.find(x, y);
+        countLookups(1);
+        neighbour = found == nullptr ? nullptr : *found;
+      }
+      
+      chunk->neighbours_[1 + dy][1 + dx] = neighbour;
+      if (neighbour != nullptr && neighbour != &EMPTY) {
+        // Topologies only translate, so if it's our neighbour at (dx, dy), we're its neighbour at (-dx, -dy)
+        neighbour->neighbours_[1 - dy][1 - dx] = chunk;
+      }
+    }
+  }
+}
+
+void ChunkArray::unlink(Chunk* chunk) {
+  // A missing neighbour is as empty as it ever was, which is only so if the chunk has been empty for as long as its
+  // neighbours remember; otherwise they have to forget
+  bool forget = !chunk->emptyThroughHistory();
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      if (dx == 0 && dy == 0) continue;
+      Chunk* neighbour = chunk->neighbours_[1 + dy][1 + dx];
+      if (neighbour != nullptr && neighbour != &EMPTY && neighbour != chunk) {
+        neighbour->neighbours_[1 - dy][1 - dx] = nullptr;
+        if (forget) {
+          neighbour->forgetHistory();
+        }
+      }
+    }
+  }
+}
+
 void ChunkArray::queueForInsertion(int x, int y) {
   if (!ignoreQueueInsertion_) {
-    coordinateQueue_.emplace(std::make_pair(x, y));
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    coordinateQueue_.insert(x, y, true);
   }
 }
 
 void ChunkArray::insertAllInQueue() {
-  for (const std::pair<int, int>& xy : coordinateQueue_) {
-    insertOrNoop(xy.first, xy.second);
+  for (const auto& entry : coordinateQueue_) {
+    insertOrNoop(entry.x(), entry.y());
   }
 }
 
@@ -199,11 +649,20 @@ bool ChunkArray::erase(int x, int y) {
   bool ok = topology_->transform(x, y);
   if (ok) {
     // Destruct the Chunk
-    std::pair<int, int> xy(x, y);
-    if (map_.count(xy)) {
-      delete map_.at(xy);
-      map_.erase(xy);
-      emit chunkRemoved(x, y);
+    Chunk** found = map_.find(x, y);
+    countLookups(1);
+    if (found != nullptr) {
+      Chunk* chunk = *found;
+      unlink(chunk);
+      pool_.release(chunk);
+      map_.erase(x, y);
+      if (countingOperations_) {
+        countLookups(1);
+        erasures_++;
+      }
+      if (recordingChanges_) {
+        events_.push_back(ChunkEvent{x, y, false});
+      }
       return true;
     }
   }
@@ -211,12 +670,17 @@ bool ChunkArray::erase(int x, int y) {
 }
 
 void ChunkArray::clear() {
-  for (auto it = map_.begin(), nextIt = it; it != map_.end(); it = nextIt) {
-    ++nextIt;
-    delete it->second;
-    map_.erase(it->first);
-    emit chunkRemoved(it->first.first, it->first.second);
+  // Erasing would shuffle the entries under us, so release them all first, then empty the map in one go
+  if (countingOperations_) {
+    erasures_ += map_.size();
+  }
+  for (auto& entry : map_) {
+    pool_.release(entry.value);
+    if (recordingChanges_) {
+      events_.push_back(ChunkEvent{entry.x(), entry.y(), false});
+    }
   }
+  map_.clear();
   clearQueue();
 }
 
@@ -227,3 +691,41 @@ ChunkArray::iterator ChunkArray::begin() noexcept {
 ChunkArray::iterator ChunkArray::end() noexcept {
   return map_.end();
 }
+
+void ChunkArray::setRecordingChanges(bool record) {
+  recordingChanges_ = record;
+  if (!record) {
+    events_.clear();
+  }
+}
+
+void ChunkArray::takeChanges(Changes& changes) {
+  changes.events.swap(events_);
+  events_.clear(); // keeping whichever capacity changes had, so neither side allocates once warmed up
+  
+  changes.changed.clear();
+  for (auto& entry : map_) {
+    Chunk* chunk = entry.value;
+    if (chunk->changed_) {
+      chunk->changed_ = false;
+      changes.changed.emplace_back(entry.x(), entry.y());
+    }
+  }
+}
+
+void ChunkArray::setCountingOperations(bool count) noexcept {
+  countingOperations_ = count;
+  if (!count) {
+    takeOperationCounts();
+  }
+}
+
+ChunkArray::OperationCounts ChunkArray::takeOperationCounts() noexcept {
+  OperationCounts counts;
+  counts.lookups = lookups_.exchange(0, std::memory_order_relaxed);
+  counts.insertions = insertions_;
+  counts.erasures = erasures_;
+  insertions_ = 0;
+  erasures_ = 0;
+  return counts;
+}
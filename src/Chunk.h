@@ -1,14 +1,16 @@
 #ifndef GAME_OF_LIFE_CHUNK_H
 #define GAME_OF_LIFE_CHUNK_H
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <unordered_set>
-#include <unordered_map>
+#include <mutex>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
-#include <QDebug>
-#include <QObject>
-
+#include "CoordinateMap.h"
 #include "Neighbourhood.h"
 #include "Ruleset.h"
 #include "Side.h"
@@ -17,17 +19,55 @@
 
 #define CHUNK_SIZE 20
 
+// Each row of a Chunk is packed into one Chunk::Row; the bitwise kernel also needs a halo bit on either side.
+static_assert(CHUNK_SIZE + 2 <= 64, "CHUNK_SIZE is too large to pack a row and its halo into a 64-bit word");
+
+// One generation of a Chunk's cells. They're hash-consed by ChunkStateTable, so Chunks whose cells are the same (still
+// life tiles, say, or the same phase of an oscillator) share one ChunkState, which never changes once it's in the
+// table. Editing a Chunk copies its ChunkState into a draft of its own, which goes into the table at the next update.
+struct ChunkState {
+  std::uint64_t rows[CHUNK_SIZE]; // packed like Chunk::row
+  std::uint64_t hash; // see ChunkStateTable::hash
+  int population;
+  mutable std::atomic<int> references; // once this drops to 0 the state is dead, and nothing can bring it back
+  std::uint8_t shard; // of the table it came from, and goes back to; it's only ever interned there too
+  bool interned; // can it be found in the table? Guarded by the lock of its shard
+  ChunkState* chained; // the next in its bucket of the table, or on the free list; guarded likewise
+  
+  static const ChunkState EMPTY; // every empty generation; never counted, never freed
+};
+
+class ChunkStateTable;
+
 // A "chunk" of cells which are all processed at once.
 // To update a cell, first call Chunk::generate(Ruleset&, Neighbourhood&) (or call the overloaded Side& version with
 // as many sides as needed), then call Chunk::update() to process the next generation.
+// Cells are stored bit-packed: row y is a single Row in which the cell at x is bit x.
+// Chunks don't announce their changes; ChunkArray::takeChanges collects them for the UI in bulk.
 // TODO can we get any performance boost by somehow not having the virtual methods be virtual?
-class Chunk : public QObject {
-  Q_OBJECT
+class Chunk {
+  friend class ChunkArray; // to maintain the neighbour links and collect changes
+  friend class ChunkPool; // to reset recycled Chunks
   
 public:
+  // One row of cells; the cell at x is bit (1 << x). Only the low CHUNK_SIZE bits are ever set.
+  typedef std::uint64_t Row;
+  
+  // The mask of the bits of a Row which hold cells.
+  static constexpr Row ROW_MASK = (Row(1) << CHUNK_SIZE) - 1;
+  
+  // The longest period a Chunk notices its neighbourhood repeating with; see Chunk::repeatsAfter.
+  static constexpr int MAX_PERIOD = 3;
+  
   // Initialize the Chunk with the specified coordinates
   Chunk(int x, int y) noexcept;
   
+  virtual ~Chunk() = default;
+  
+  // Chunks are linked to each other by address, so they stay put
+  Chunk(const Chunk&) = delete;
+  Chunk& operator=(const Chunk&) = delete;
+  
   // Evaluate all the cells in the Chunk using the specified ruleset and prime the chunk to update.
   // If side and affectingDistance are specified, evaluate only the cells within affectingDistance of side.
   // (Note: this is overloaded instead of using default arguments because they're not allowed on virtual methods.)
@@ -52,11 +92,51 @@ public:
   
   virtual int population() const noexcept; // Get the total number of live cells in the chunk.
   
-  const int chunkX, chunkY; // The coordinates of this Chunk.
+  // Get the packed row at y, with no bounds checking. For Kernels, which read whole rows at once.
+  Row row(int y) const noexcept { return rows_[y]; }
+  
+  // Get all CHUNK_SIZE packed rows, for painting. The pointer is good until the next update.
+  const Row* rows() const noexcept { return rows_; }
+  
+  // Set the cells of the next generation in row y whose columns are in columnMask to those in next, with no bounds
+  // checking. For Kernels, which generate whole rows at once.
+  void setNextRow(int y, Row next, Row columnMask = ROW_MASK) noexcept;
+  
+  // Get the packed row y of the next generation as generated so far, with no bounds checking.
+  Row nextRow(int y) const noexcept { return newRows_[y]; }
+  
+  // Make the cells in bits live in row y, with no bounds checking; bits outside ROW_MASK are ignored. Return how many
+  // weren't live already. For loading patterns a row at a time.
+  int addLiveCells(int y, Row bits);
+  
+  // Get the Chunk next to this one at offset (dx, dy), where -1 <= dx, dy <= 1, as linked by the ChunkArray. Return
+  // nullptr if there is no Chunk there yet. The links respect the Topology: they point at the wrapped chunk in a
+  // WrappingTopology, and at the shared empty chunk past the edge of a FixedTopology. neighbour(0, 0) is this.
+  Chunk* neighbour(int dx, int dy) const noexcept { return neighbours_[1 + dy][1 + dx]; }
+  
+  // Are the cells the same as they were period generations ago (1 <= period <= MAX_PERIOD), with every generation
+  // since then updated from the one before, and no edits? Each Chunk keeps its last MAX_PERIOD generations to tell,
+  // as shared ChunkStates, so it's a pointer comparison: the same cells are the same state. If a Chunk and all of its
+  // neighbours repeat after period, so does its neighbourhood, so its next generation is the one after the generation
+  // period ago: Automaton replays it instead of generating it.
+  // Fresh Chunks have no history, so they never repeat until they've been updated period times.
+  virtual bool repeatsAfter(int period) const noexcept;
+  
+  // Make the next generation the one after the generation period ago without generating it, for a Chunk whose
+  // neighbourhood repeats after period. The next update takes it back from the history.
+  void replay(int period) noexcept;
+  
+  // Forget the generations before this one, as if the Chunk had just been filled in, so it doesn't repeat until it's
+  // been updated again. For when the cells around it changed some other way than by updating.
+  void forgetHistory() noexcept;
+  
+  // Record whether the Chunk spent this tick isolated - empty, with no non-empty neighbours - and return how many
+  // ticks in a row it has been. Automaton only erases a Chunk once this has passed its grace period.
+  unsigned int countIsolatedTick(bool isolated) noexcept;
+  
+  // The coordinates of this Chunk. Only ChunkPool changes them, when the Chunk is recycled; don't touch them.
+  int chunkX, chunkY;
   
-signals:
-  void chunkChanged(bool newCells[CHUNK_SIZE][CHUNK_SIZE]);
-
 private:
   // Check that 0 <= x < CHUNK_SIZE and 0 <= y < CHUNK_SIZE, throwing std::invalid_argument otherwise.
   static void checkInBounds(int x, int y);
@@ -68,39 +148,209 @@ private:
   // Scan a single line left or right with reference to the optionally given side. Modifies x.
   void scanLine(const Ruleset& ruleset, Neighbourhood& neighbourhood, int& x, int y, const Side& side = Side::BOTTOM);
   
-  bool cells_[CHUNK_SIZE][CHUNK_SIZE] = {}; // the cells in the Chunk; index like cells_[x][y]
-  bool newCells_[CHUNK_SIZE][CHUNK_SIZE] = {}; // the cells of the next generation
+  // Make this a fresh Chunk at (x, y), as if just constructed: no cells and no links. Its states must have been
+  // released.
+  void reset(int x, int y);
+  
+  // Let go of every ChunkState in the history, for when the Chunk is recycled.
+  void releaseStates();
+  
+  // Get the cells of this generation to change them, copying them into a draft first if they're shared.
+  Row* editableRows();
+  
+  // Has the Chunk been empty for its whole history, which goes back MAX_PERIOD generations?
+  bool emptyThroughHistory() const noexcept;
+  
+  // Get the index in states_ of the generation ago generations before this one.
+  int stateIndex(int ago) const noexcept { return (current_ + MAX_PERIOD + 1 - ago) % (MAX_PERIOD + 1); }
+  
+  Chunk* neighbours_[3][3] = {}; // neighbours_[1 + dy][1 + dx] is neighbour(dx, dy); maintained by ChunkArray
+  ChunkStateTable* table_ = nullptr; // where the states come from; set by ChunkPool, and nullptr for the empty chunk
+  const ChunkState* states_[MAX_PERIOD + 1]; // this generation and the ones before it, round a ring; one reference each
+  int current_ = 0; // the index of this generation in states_
+  const Row* rows_; // the cells in the Chunk, states_[current_]->rows; the cell (x, y) is bit x of rows_[y]
+  ChunkState* draft_ = nullptr; // states_[current_], if the cells have been edited since the last update
+  Row newRows_[CHUNK_SIZE] = {}; // the cells of the next generation
   int liveCellCount_ = 0; // count the number of live cells, currently; used for determining if it's empty
-  int nextLiveCellCount_ = 0; // same for the next generation
+  int history_ = 0; // how many generations before this one states_ holds, each updated from the one before
+  int replaying_ = 0; // the period passed to replay since the last update, or 0
+  unsigned int isolatedTicks_ = 0; // see countIsolatedTick
+  bool changed_ = false; // have the cells changed since ChunkArray last collected changes? only this Chunk sets it
+};
+
+// Hash-conses the ChunkStates of a ChunkArray's Chunks, so each distinct generation of a chunk's cells is held once,
+// however many Chunks (or generations of a Chunk) have it: the memory for a periodic field is that of its period, not
+// its area. States are reference counted, and recycled once no Chunk holds them.
+// The states are split over shards by hash, each with its own lock, so Chunks can update on several threads at once.
+class ChunkStateTable {
+public:
+  ChunkStateTable();
+  
+  ~ChunkStateTable(); // free every state the table ever made, whoever still holds them
+  
+  ChunkStateTable(const ChunkStateTable&) = delete;
+  ChunkStateTable& operator=(const ChunkStateTable&) = delete;
+  
+  // Hash CHUNK_SIZE rows of cells. Empty rows hash to 0.
+  static std::uint64_t hash(const std::uint64_t* rows) noexcept;
+  
+  // Get the state with the cells in rows (CHUNK_SIZE of them), adding one if there isn't one yet, with a reference
+  // for the caller. Empty rows always get ChunkState::EMPTY.
+  const ChunkState* intern(const std::uint64_t* rows);
+  
+  // Put draft, from ChunkStateTable::draft and changed since, in the table, passing on the caller's reference. Return
+  // the state to hold from now on. That's the draft if it came from the shard its new cells go in and they aren't
+  // there already; otherwise the draft is recycled, and the caller gets the one there or a copy made in that shard.
+  const ChunkState* intern(ChunkState* draft);
+  
+  // Make a copy of state to change, kept out of the table, with a reference for the caller.
+  ChunkState* draft(const ChunkState* state);
+  
+  // Add a reference to state, which the caller already holds one to.
+  static void addReference(const ChunkState* state) noexcept;
+  
+  // Drop a reference to state, recycling it once nothing holds it.
+  void release(const ChunkState* state);
+  
+  // How many states are held, apart from ChunkState::EMPTY? Not thread-safe: call it between ticks.
+  std::size_t size() const noexcept;
+  
+  // Get the bytes taken up by the states and the buckets. Not thread-safe either.
+  std::size_t memoryUsage() const noexcept;
+  
+  static constexpr std::size_t SHARDS = HASH_SHARDS;
+  static constexpr std::size_t STATES_PER_SLAB = 64;
+  
+private:
+  // A share of the states, by hash.
+  struct Shard {
+    std::mutex mutex; // guards everything below, and the interned and chained of every state in the shard
+    std::vector<ChunkState*> buckets; // the first state in each bucket, chained through the states; a power of two
+    std::size_t count = 0; // of states in the buckets
+    std::vector<std::unique_ptr<ChunkState[]>> slabs; // every state the shard has made
+    std::size_t usedInLastSlab = STATES_PER_SLAB;
+    ChunkState* free = nullptr; // recycled states, chained
+    std::size_t live = 0; // states handed out by the shard and not back yet, interned or drafts
+  };
+  
+  // Get the shard a state with hash goes in.
+  Shard& shardFor(std::uint64_t hash) noexcept { return shards_[hashShard(hash)]; }
+  
+  // Get the bucket of shard a state with hash goes in.
+  static ChunkState*& bucketFor(Shard& shard, std::uint64_t hash) noexcept {
+    return shard.buckets[hashBucket(hash, shard.buckets.size())];
+  }
+  
+  // Get a state to fill in from shard, with its lock held.
+  ChunkState* allocate(Shard& shard);
+  
+  // Put state, dead and out of the buckets, on the free list of shard, which it came from, with the lock held.
+  static void recycle(Shard& shard, ChunkState* state) noexcept;
+  
+  // Find the live state in shard with the cells in rows and their hash, taking a reference to it, with the lock held.
+  // Dead states found on the way are taken out of the table, since nothing can want them now.
+  static const ChunkState* find(Shard& shard, const std::uint64_t* rows, std::uint64_t hash) noexcept;
+  
+  // Put state, filled in, in the buckets of shard, with the lock held, growing them if need be.
+  static void insert(Shard& shard, ChunkState* state);
+  
+  std::unique_ptr<Shard[]> shards_;
+};
+
+// Hands out Chunks carved from slabs, and takes erased ones back to hand out again instead of deleting them, so the
+// chunks churning at the edges of moving patterns don't go through the heap every tick. It also keeps the table of
+// the Chunks' states.
+// Chunks are only destroyed along with the pool, so it holds as many as were ever in use at once.
+class ChunkPool {
+public:
+  ChunkPool() = default;
+  
+  ~ChunkPool(); // destroy every Chunk the pool ever made
+  
+  ChunkPool(const ChunkPool&) = delete;
+  ChunkPool& operator=(const ChunkPool&) = delete;
+  
+  // Get a fresh Chunk at (x, y), recycled if there are any to recycle.
+  Chunk* acquire(int x, int y);
+  
+  // Take back a Chunk from acquire to recycle later, letting go of its states. It must not be used afterwards.
+  void release(Chunk* chunk);
+  
+  // How many Chunks are waiting to be recycled?
+  std::size_t freeCount() const noexcept;
+  
+  // Get the table of the Chunks' states.
+  const ChunkStateTable& states() const noexcept { return states_; }
+  
+  // Get the bytes taken up by the slabs, the free list and the states.
+  std::size_t memoryUsage() const noexcept;
+  
+private:
+  static constexpr std::size_t CHUNKS_PER_SLAB = 64;
+  typedef std::aligned_storage<sizeof(Chunk), alignof(Chunk)>::type ChunkStorage;
+  
+  ChunkStateTable states_; // first, so it outlives the Chunks holding its states
+  std::vector<std::unique_ptr<ChunkStorage[]>> slabs_;
+  std::size_t usedInLastSlab_ = CHUNKS_PER_SLAB; // how many Chunks have been constructed in the last slab
+  std::vector<Chunk*> free_; // released Chunks, recycled last in, first out while they're still in cache
 };
 
-// A 2D-indexed list of Chunks - a thin wrapper over std::unordered_map.
-// This isn't just a typedef for std::unordered_map<std::pair<int, int>, Chunk> because it encapsulates a Topology.
+// A 2D-indexed list of Chunks - a thin wrapper over CoordinateMap.
+// This isn't just a typedef for CoordinateMap<Chunk*> because it encapsulates a Topology.
 // If the Topology deems a coordinate invalid, a blank Chunk is returned.
 // The Topology may modify coordinates as it wishes.
 // All hail the great and mighty Topology.
+// It also keeps every Chunk's neighbour links (see Chunk::neighbour) up to date as Chunks are inserted and erased.
+// Instead of signalling every change as it happens, it can record them for the UI to take in bulk once per tick; see
+// ChunkArray::setRecordingChanges.
 // TODO I feel like there's something semantically wrong with returning a reference in get() and pointers via iterators
 // TODO Do we really need the bool return types on insertOrNoop and erase?
-class ChunkArray : public QObject {
-  Q_OBJECT
-  
+class ChunkArray {
 public:
-  typedef std::unordered_map<std::pair<int, int>, Chunk*, pair_hash>::iterator iterator;
-  typedef std::unordered_map<std::pair<int, int>, Chunk*, pair_hash>::size_type size_type;
-  
-  typedef std::unordered_set<std::pair<int, int>, pair_hash>::iterator queue_iterator;
+  // One Chunk being inserted or erased, as recorded for ChunkArray::takeChanges.
+  struct ChunkEvent {
+    int x, y;
+    bool inserted; // or erased
+  };
+  
+  // Everything that happened to the Chunks since the last ChunkArray::takeChanges.
+  struct Changes {
+    std::vector<ChunkEvent> events; // Chunks inserted and erased, in order; the same coordinates may come up again
+    std::vector<std::pair<int, int>> changed; // present Chunks whose cells have changed, each once
+  };
+  
+  // How much work the map of Chunks has done since ChunkArray::takeOperationCounts was last called.
+  struct OperationCounts {
+    unsigned long long lookups = 0; // finds, inserts and erases in the map, including those linking Chunks
+    unsigned long long insertions = 0; // Chunks inserted
+    unsigned long long erasures = 0; // Chunks erased
+  };
+  
+  typedef CoordinateMap<Chunk*>::iterator iterator;
+  typedef CoordinateMap<Chunk*>::size_type size_type;
+  
+  typedef CoordinateMap<bool>::iterator queue_iterator;
   
   // Initialize this ChunkArray with the specified Topology
   explicit ChunkArray(Topology* topology);
   
-  ~ChunkArray() override; // we need to clear the map; QObject disables copy/move constructors/assignment operators
+  ~ChunkArray();
+  
+  ChunkArray(const ChunkArray&) = delete;
+  ChunkArray& operator=(const ChunkArray&) = delete;
   
   // Get a reference to this ChunkArray's topology.
   Topology& topology() const noexcept;
   
+  // Estimate the bytes taken up by the Chunks (including the recycled ones) and the maps of them.
+  std::size_t memoryUsage() const noexcept;
+  
   // How many Chunks are stored?
   size_type size();
   
+  // Make room for count Chunks in the map without growing it again, ahead of inserting many at once.
+  void reserve(size_type count);
+  
   // Get a reference to the Chunk at (x, y), throwing std::out_of_range if not present
   Chunk& at(int x, int y) const;
   
@@ -110,11 +360,13 @@ public:
   // Does this ChunkArray contain a non-empty Chunk at (x, y)?
   bool hasNonEmpty(int x, int y);
   
-  // Attempt to insert an empty Chunk at (x, y). Return whether a Chunk was inserted. Does nothing otherwise.
+  // Attempt to insert an empty Chunk at (x, y) and link it with its neighbours. Return whether a Chunk was inserted.
+  // Does nothing otherwise.
   bool insertOrNoop(int x, int y);
   
   // Queue a chunk position (x, y) such that the next time insertAllInQueue() is called, a Chunk will be inserted at
   // (x, y). This is useful when insertion must be delayed until iterating over the current chunks is done.
+  // This is thread-safe, so chunks can be generated on several threads at once.
   void queueForInsertion(int x, int y);
   
   // Insert all chunk positions previously queued via queueForInsertion(x, y). Do not clear the queue.
@@ -127,23 +379,36 @@ public:
   // Clear the queue of coordinates to insert.
   void clearQueue();
   
-  // Iterators over the queue of coordinates to insert.
+  // Iterators over the queue of coordinates to insert; use x() and y() on the entries.
   queue_iterator queueBegin() noexcept;
   queue_iterator queueEnd() noexcept;
   
-  // Erase the Chunk at (x, y) if present, returning whether a Chunk was erased.
+  // Erase the Chunk at (x, y) if present and unlink it from its neighbours, returning whether a Chunk was erased.
   bool erase(int x, int y);
   
   // Erase all Chunks and clear the queue.
   void clear();
   
-  // Iterators, iterating over pairs of coordinate pairs and pointers to corresponding Chunks.
+  // Iterators over the entries of the map, with the coordinates in x() and y() and a pointer to the Chunk in value.
+  // Don't insert or erase Chunks while iterating; see CoordinateMap.
   iterator begin() noexcept;
   iterator end() noexcept;
   
-signals:
-  void chunkAdded(int x, int y);
-  void chunkRemoved(int x, int y);
+  // Start or stop recording the Chunks inserted and erased for takeChanges. Off by default, so nothing piles up
+  // when nobody is taking them; turning it off throws away what was recorded.
+  void setRecordingChanges(bool record);
+  
+  // Move everything recorded since the last call into changes, replacing what was there, and start afresh. The
+  // Chunks whose cells have changed are found by a pass over them all, so call this once per tick at most.
+  // Not thread-safe: call it between ticks.
+  void takeChanges(Changes& changes);
+  
+  // Start or stop counting lookups, insertions and erasures for takeOperationCounts. Off by default: lookups can come
+  // from several threads at once, so each one counted costs an atomic increment.
+  void setCountingOperations(bool count) noexcept;
+  
+  // Get the counts since the last call (or since counting started), and zero them. Call it between ticks.
+  OperationCounts takeOperationCounts() noexcept;
   
 private:
   // Empty Chunk for use when the Topology specifies a chunk is to be treated as empty
@@ -155,17 +420,40 @@ private:
     void generate(const Ruleset&, Neighbourhood&) override {}
     void update() override {}
     bool getCell(int, int) const override { return false; }
-    void setCell(int, int, bool) override {} // prevent emitting signals
+    void setCell(int, int, bool) override {} // stay empty
     bool isEmpty() const noexcept override { return true; }
     bool isNextGenEmpty() const noexcept override { return true; }
+    bool repeatsAfter(int) const noexcept override { return true; } // empty then, empty now
 #pragma clang diagnostic pop
   } static EMPTY;
   
-  std::unordered_map<std::pair<int, int>, Chunk*, pair_hash> map_;
+  // Link the newly inserted chunk with its neighbours in both directions, according to the Topology.
+  void link(Chunk* chunk);
+  
+  // Clear the links from the chunk's neighbours to it, before it is erased.
+  void unlink(Chunk* chunk);
+  
+  // Count lookups in map_, if we're counting. Safe from any thread.
+  void countLookups(unsigned long long lookups) const noexcept {
+    if (countingOperations_) {
+      lookups_.fetch_add(lookups, std::memory_order_relaxed);
+    }
+  }
+  
+  ChunkPool pool_; // where the Chunks in map_ come from and go back to; outlives map_
+  CoordinateMap<Chunk*> map_;
   std::unique_ptr<Topology> topology_;
   
-  std::unordered_set<std::pair<int, int>, pair_hash> coordinateQueue_; // holds coordinates queued for insertion
+  CoordinateMap<bool> coordinateQueue_; // holds coordinates queued for insertion; the values are unused
+  std::mutex queueMutex_; // guards coordinateQueue_ in queueForInsertion
   bool ignoreQueueInsertion_ = false;
+  
+  bool recordingChanges_ = false;
+  std::vector<ChunkEvent> events_; // recorded since the last takeChanges, if recordingChanges_
+  
+  bool countingOperations_ = false;
+  mutable std::atomic<unsigned long long> lookups_{0}; // counted since the last takeOperationCounts
+  unsigned long long insertions_ = 0, erasures_ = 0; // likewise, but only ever on the thread ticking
 };
 
 #endif //GAME_OF_LIFE_CHUNK_H
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ChunkMemo.h"
+
+constexpr int ChunkMemo::MAX_HALO;
+constexpr std::size_t ChunkMemo::DEFAULT_CAPACITY;
+constexpr std::size_t ChunkMemo::SHARDS;
+constexpr std::size_t ChunkMemo::MIN_LOOKUPS;
+constexpr std::size_t ChunkMemo::MIN_HIT_RATIO;
+constexpr unsigned int ChunkMemo::MIN_REST;
+constexpr unsigned int ChunkMemo::MAX_REST;
+constexpr std::size_t ChunkMemo::NONE;
+
+ChunkMemo::ChunkMemo(std::size_t capacity) : shards_(new Shard[SHARDS]) {
+  setCapacity(capacity);
+}
+
+void ChunkMemo::setCapacity(std::size_t capacity) {
+  capacity_ = capacity;
+  shardCapacity_ = (capacity + SHARDS - 1) / SHARDS;
+  clear();
+}
+
+std::size_t ChunkMemo::capacity() const noexcept {
+  return capacity_;
+}
+
+bool ChunkMemo::prepare(int halo, unsigned long long rulesRevision) {
+  if (halo != halo_ || rulesRevision != rulesRevision_) {
+    halo_ = halo;
+    rulesRevision_ = rulesRevision;
+    keyRows_ = halo >= 0 && halo <= MAX_HALO ? CHUNK_SIZE + 2 * halo : 0;
+    clear();
+  }
+  if (capacity_ == 0 || halo < 0 || halo > MAX_HALO) return false;
+  if (resting_ > 0) {
+    resting_--;
+    return false;
+  }
+  
+  // How did the last tick go?
+  std::size_t lookups = 0, hits = 0;
+  for (std::size_t i = 0; i < SHARDS; i++) {
+    lookups += shards_[i].lookups;
+    hits += shards_[i].hits;
+    shards_[i].lookups = shards_[i].hits = 0;
+  }
+  if (lookups >= MIN_LOOKUPS) {
+    if (hits * MIN_HIT_RATIO < lookups) {
+      resting_ = nextRest_ - 1; // counting this tick
+      nextRest_ = std::min(nextRest_ * 2, MAX_REST);
+      return false;
+    }
+    nextRest_ = MIN_REST;
+  }
+  return true;
+}
+
+bool ChunkMemo::makeKey(const Chunk& chunk, Key& key) const noexcept {
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      if (chunk.neighbour(dx, dy) == nullptr) return false;
+    }
+  }
+  
+  // The halo's rows come from the neighbours above and below, and each row's halo from the neighbours to either side
+  int halo = halo_;
+  Chunk::Row haloMask = (Chunk::Row(1) << halo) - 1;
+  std::uint64_t hash = 0;
+  for (int y = -halo; y < CHUNK_SIZE + halo; y++) {
+    int dy = y < 0 ? -1 : y >= CHUNK_SIZE ? 1 : 0;
+    int rowY = y - dy * CHUNK_SIZE;
+    Chunk::Row row = chunk.neighbour(-1, dy)->row(rowY) >> (CHUNK_SIZE - halo)
+        | chunk.neighbour(0, dy)->row(rowY) << halo
+        | (chunk.neighbour(1, dy)->row(rowY) & haloMask) << (CHUNK_SIZE + halo);
+    key.rows[y + halo] = row;
+    hash = hashRow(hash, row);
+  }
+  key.hash = hash;
+  return true;
+}
+
+std::size_t ChunkMemo::find(const Shard& shard, const Key& key) const noexcept {
+  for (std::size_t slot = shard.buckets[bucketFor(shard, key.hash)]; slot != NONE; slot = shard.chained[slot]) {
+    // The hashes only rule keys out
+    if (shard.hashes[slot] == key.hash
+        && memcmp(&shard.keys[slot * keyRows_], key.rows, keyRows_ * sizeof(Chunk::Row)) == 0) {
+      return slot;
+    }
+  }
+  return NONE;
+}
+
+bool ChunkMemo::recall(const Key& key, Chunk& chunk) {
+  Shard& shard = shardFor(key.hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.lookups++;
+  std::size_t slot = find(shard, key);
+  if (slot == NONE) return false;
+  
+  shard.hits++;
+  const Chunk::Row* next = &shard.nexts[slot * CHUNK_SIZE];
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    chunk.setNextRow(y, next[y]);
+  }
+  makeNewest(shard, slot, true);
+  return true;
+}
+
+void ChunkMemo::remember(const Key& key, const Chunk& chunk) {
+  Shard& shard = shardFor(key.hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (find(shard, key) != NONE) return; // generated on another thread at the same time
+  
+  // A new slot until the shard is full, then the least recently used one, taken out of its bucket
+  std::size_t slot;
+  bool listed = true;
+  if (shard.hashes.size() < shardCapacity_) {
+    slot = shard.hashes.size();
+    shard.hashes.push_back(key.hash);
+    shard.chained.push_back(NONE);
+    shard.keys.resize(shard.keys.size() + keyRows_);
+    shard.nexts.resize(shard.nexts.size() + CHUNK_SIZE);
+    shard.newer.push_back(NONE);
+    shard.older.push_back(NONE);
+    listed = false;
+  } else {
+    slot = shard.oldest;
+    std::size_t* link = &shard.buckets[bucketFor(shard, shard.hashes[slot])];
+    while (*link != slot) {
+      link = &shard.chained[*link];
+    }
+    *link = shard.chained[slot];
+  }
+  
+  shard.hashes[slot] = key.hash;
+  std::size_t& bucket = shard.buckets[bucketFor(shard, key.hash)];
+  shard.chained[slot] = bucket;
+  bucket = slot;
+  std::copy(key.rows, key.rows + keyRows_, &shard.keys[slot * keyRows_]);
+  Chunk::Row* next = &shard.nexts[slot * CHUNK_SIZE];
+  for (int y = 0; y < CHUNK_SIZE; y++) {
+    next[y] = chunk.nextRow(y);
+  }
+  makeNewest(shard, slot, listed);
+}
+
+void ChunkMemo::makeNewest(Shard& shard, std::size_t slot, bool detach) noexcept {
+  if (detach) {
+    if (shard.newest == slot) return; // already there
+    // It isn't the newest, so there's one newer than it
+    shard.older[shard.newer[slot]] = shard.older[slot];
+    if (shard.older[slot] != NONE) {
+      shard.newer[shard.older[slot]] = shard.newer[slot];
+    } else {
+      shard.oldest = shard.newer[slot];
+    }
+  }
+  shard.newer[slot] = NONE;
+  shard.older[slot] = shard.newest;
+  if (shard.newest != NONE) {
+    shard.newer[shard.newest] = slot;
+  } else {
+    shard.oldest = slot;
+  }
+  shard.newest = slot;
+}
+
+void ChunkMemo::clear() {
+  for (std::size_t i = 0; i < SHARDS; i++) {
+    Shard& shard = shards_[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::size_t buckets = 1;
+    while (buckets < shardCapacity_) {
+      buckets *= 2;
+    }
+    shard.buckets.assign(buckets, NONE);
+    shard.hashes.clear();
+    shard.chained.clear();
+    shard.keys.clear();
+    shard.nexts.clear();
+    shard.newer.clear();
+    shard.older.clear();
+    shard.newest = shard.oldest = NONE;
+    shard.lookups = shard.hits = 0;
+  }
+}
+
+std::size_t ChunkMemo::memoryUsage() const noexcept {
+  std::size_t bytes = SHARDS * sizeof(Shard);
+  for (std::size_t i = 0; i < SHARDS; i++) {
+    const Shard& shard = shards_[i];
+    bytes += (shard.hashes.capacity() + shard.keys.capacity() + shard.nexts.capacity()) * sizeof(std::uint64_t)
+        + (shard.buckets.capacity() + shard.chained.capacity() + shard.newer.capacity() + shard.older.capacity())
+        * sizeof(std::size_t);
+  }
+  return bytes;
+}
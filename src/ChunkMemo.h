@@ -0,0 +1,116 @@
+#ifndef GAME_OF_LIFE_CHUNKMEMO_H
+#define GAME_OF_LIFE_CHUNKMEMO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Chunk.h"
+#include "util.h"
+
+// Remembers the next generations of recently generated Chunks, keyed by their cells and a halo of the cells around
+// them, so a Chunk which looks just like one generated before - a glider in the same phase and at the same alignment,
+// say - copies its next generation instead of generating it. Only the cells in the halo can affect a Chunk, so this
+// works for any neighbourhood which reaches no further than the halo, unlike HashLife.
+// It holds a bounded number of entries and evicts the least recently used. The entries are split over shards by hash,
+// each with its own lock, so Chunks can be looked up and remembered from several threads at once.
+// Looking chunks up isn't free, so after a tick in which too few lookups hit, like those of a soup which never looks
+// the same twice, the memo rests for a while, longer each time it's still no use.
+class ChunkMemo {
+public:
+  // The widest halo a key can hold: a row and its halo have to fit in a Chunk::Row, and the halo has to come from the
+  // neighbouring chunks.
+  static constexpr int MAX_HALO = CHUNK_SIZE < (64 - CHUNK_SIZE) / 2 ? CHUNK_SIZE : (64 - CHUNK_SIZE) / 2;
+  
+  // The cells of a Chunk and its halo, as made by ChunkMemo::makeKey. Big, but meant for the stack.
+  struct Key {
+    std::uint64_t hash;
+    Chunk::Row rows[CHUNK_SIZE + 2 * MAX_HALO]; // the cell at x in row y is bit x + halo of rows[y + halo]
+  };
+  
+  static constexpr std::size_t DEFAULT_CAPACITY = 4096; // entries
+  static constexpr std::size_t SHARDS = HASH_SHARDS;
+  
+  // After a tick of at least MIN_LOOKUPS lookups, fewer than one in MIN_HIT_RATIO of which hit, the memo rests for
+  // MIN_REST ticks, doubling each time in a row up to MAX_REST.
+  static constexpr std::size_t MIN_LOOKUPS = 16;
+  static constexpr std::size_t MIN_HIT_RATIO = 4;
+  static constexpr unsigned int MIN_REST = 8;
+  static constexpr unsigned int MAX_REST = 256;
+  
+  // Initialize an empty memo of up to about capacity entries (split evenly between the shards, rounded up).
+  explicit ChunkMemo(std::size_t capacity = DEFAULT_CAPACITY);
+  
+  // Set the most entries to hold, forgetting all of them. 0 turns the memo off.
+  void setCapacity(std::size_t capacity);
+  
+  // Get the above.
+  std::size_t capacity() const noexcept;
+  
+  // Get ready for a tick which keys Chunks by halo cells past each edge, and remembers their generations under the
+  // rules of revision rulesRevision (see Ruleset::revision), forgetting every entry if either has changed since the
+  // last call. Return whether the memo should be used this tick: not if its capacity is 0, halo is more than MAX_HALO,
+  // or it's resting. Not thread-safe: call it between ticks.
+  bool prepare(int halo, unsigned long long rulesRevision);
+  
+  // Fill in key with the cells of chunk and its halo, read through its neighbour links. Return false, leaving key
+  // unusable, if any of the neighbours is missing.
+  bool makeKey(const Chunk& chunk, Key& key) const noexcept;
+  
+  // If the next generation of the chunk key was made from is remembered, make it the next generation of chunk, as
+  // Kernel::generate would have, and return true. Otherwise return false.
+  bool recall(const Key& key, Chunk& chunk);
+  
+  // Remember the next generation of chunk, just generated, as that of the chunk key was made from.
+  void remember(const Key& key, const Chunk& chunk);
+  
+  // Forget every entry.
+  void clear();
+  
+  // Get the bytes taken up by the entries and the shards' maps of them.
+  std::size_t memoryUsage() const noexcept;
+  
+private:
+  static constexpr std::size_t NONE = SIZE_MAX; // the end of a shard's list of slots
+  
+  // A share of the entries, by hash, in slots which are reused once they're evicted. Slots are found through buckets
+  // chained through the slots themselves, so nothing is allocated once the shard is full.
+  struct Shard {
+    std::mutex mutex; // guards everything below
+    std::vector<std::size_t> buckets; // the first slot in each bucket, or NONE; a power of two, one or more per slot
+    std::vector<std::uint64_t> hashes; // per slot
+    std::vector<std::size_t> chained; // per slot, the next slot in its bucket, or NONE
+    std::vector<Chunk::Row> keys; // the rows of each slot's key, keyRows_ per slot
+    std::vector<Chunk::Row> nexts; // the next generation of each slot's chunk, CHUNK_SIZE rows per slot
+    std::vector<std::size_t> newer, older; // each slot's neighbours in the list from most to least recently used
+    std::size_t newest = NONE, oldest = NONE;
+    std::size_t lookups = 0, hits = 0; // since prepare last looked
+  };
+  
+  // Get the shard an entry with hash goes in.
+  Shard& shardFor(std::uint64_t hash) const noexcept { return shards_[hashShard(hash)]; }
+  
+  // Get the bucket of shard an entry with hash goes in.
+  static std::size_t bucketFor(const Shard& shard, std::uint64_t hash) noexcept {
+    return hashBucket(hash, shard.buckets.size());
+  }
+  
+  // Get the slot of shard holding key, or NONE if there isn't one.
+  std::size_t find(const Shard& shard, const Key& key) const noexcept;
+  
+  // Move slot to the front of shard's list of slots; detach it first if it's already in the list.
+  static void makeNewest(Shard& shard, std::size_t slot, bool detach) noexcept;
+  
+  std::size_t capacity_;
+  std::size_t shardCapacity_; // capacity_ / SHARDS, rounded up
+  int halo_ = -1; // what keys were made with, or -1 before prepare is first called
+  unsigned long long rulesRevision_ = 0;
+  std::size_t keyRows_ = 0; // CHUNK_SIZE + 2 * halo_
+  unsigned int resting_ = 0; // ticks left to rest
+  unsigned int nextRest_ = MIN_REST; // ticks to rest the next time the memo is no use
+  std::unique_ptr<Shard[]> shards_;
+};
+
+#endif //GAME_OF_LIFE_CHUNKMEMO_H
@@ -0,0 +1,225 @@
+#ifndef GAME_OF_LIFE_COORDINATEMAP_H
+#define GAME_OF_LIFE_COORDINATEMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "util.h"
+
+// A flat open-addressing hash map from (x, y) coordinates to Values, for the maps looked up on every tick. Each key is
+// packed into one Morton code (see packCoordinates) and the entries live in one array, probed linearly, so a lookup
+// usually touches a cache line or two instead of chasing a node.
+// Every 4x4 tile of coordinates hashes to one run of 16 slots, with the tiles themselves scattered, so neighbouring
+// coordinates tend to share cache lines and iterating visits each tile's entries together. Each map scatters them with
+// its own seed, so copying one map into another by iterating it doesn't insert in the order of the other's slots.
+// Inserting may move every entry (when the table grows) and erasing may move the ones after it, so pointers to values
+// and iterators are invalidated by both: don't insert or erase while iterating.
+// Value must be default-constructible; looking things up from several threads at once is fine as long as nobody is
+// inserting or erasing.
+template<typename Value>
+class CoordinateMap {
+public:
+  // One slot of the table; iterators only visit the occupied ones. Don't change the key.
+  struct Entry {
+    std::uint64_t key; // packCoordinates(x(), y())
+    Value value;
+    bool occupied;
+    
+    int x() const noexcept { return unpackX(key); }
+    int y() const noexcept { return unpackY(key); }
+  };
+  
+  template<typename EntryType>
+  class Iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef EntryType value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef EntryType* pointer;
+    typedef EntryType& reference;
+    
+    Iterator(EntryType* slot, EntryType* end) noexcept : slot_(slot), end_(end) { skipEmpty(); }
+    
+    EntryType& operator*() const noexcept { return *slot_; }
+    EntryType* operator->() const noexcept { return slot_; }
+    Iterator& operator++() noexcept { ++slot_; skipEmpty(); return *this; }
+    Iterator operator++(int) noexcept { Iterator old = *this; ++*this; return old; }
+    bool operator==(const Iterator& other) const noexcept { return slot_ == other.slot_; }
+    bool operator!=(const Iterator& other) const noexcept { return slot_ != other.slot_; }
+  
+  private:
+    void skipEmpty() noexcept { while (slot_ != end_ && !slot_->occupied) ++slot_; }
+    
+    EntryType* slot_;
+    EntryType* end_;
+  };
+  
+  typedef Iterator<Entry> iterator;
+  typedef Iterator<const Entry> const_iterator;
+  typedef std::size_t size_type;
+  
+  size_type size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  
+  // Get the bytes taken up by the slots, not counting anything the values point to.
+  std::size_t memoryUsage() const noexcept { return slots_.capacity() * sizeof(Entry); }
+  
+  // Get a pointer to the value at (x, y), or nullptr if there isn't one.
+  Value* find(int x, int y) noexcept {
+    return const_cast<Value*>(static_cast<const CoordinateMap*>(this)->find(x, y));
+  }
+  const Value* find(int x, int y) const noexcept {
+    if (size_ == 0) return nullptr;
+    const Entry& entry = slots_[findSlot(packCoordinates(x, y))];
+    return entry.occupied ? &entry.value : nullptr;
+  }
+  
+  bool contains(int x, int y) const noexcept { return find(x, y) != nullptr; }
+  
+  // Get the value at (x, y), throwing std::out_of_range if there isn't one.
+  Value& at(int x, int y) { return const_cast<Value&>(static_cast<const CoordinateMap*>(this)->at(x, y)); }
+  const Value& at(int x, int y) const {
+    const Value* value = find(x, y);
+    if (value == nullptr) {
+      throw std::out_of_range("No value at these coordinates in CoordinateMap");
+    }
+    return *value;
+  }
+  
+  // Insert value at (x, y) unless there's already a value there. Return whether it was inserted.
+  bool insert(int x, int y, const Value& value) {
+    bool inserted;
+    Value& slotValue = findOrInsert(x, y, inserted);
+    if (inserted) {
+      slotValue = value;
+    }
+    return inserted;
+  }
+  
+  // Get the value at (x, y), inserting a value-initialized one first if there isn't one.
+  Value& findOrInsert(int x, int y) {
+    bool inserted;
+    return findOrInsert(x, y, inserted);
+  }
+  
+  // Erase the value at (x, y) if there is one. Return whether there was.
+  bool erase(int x, int y) {
+    if (size_ == 0) return false;
+    size_type hole = findSlot(packCoordinates(x, y));
+    if (!slots_[hole].occupied) return false;
+    
+    // Shift back every following entry which would still be found from its home slot, so no tombstones are needed
+    size_type mask = slots_.size() - 1;
+    for (size_type next = (hole + 1) & mask; slots_[next].occupied; next = (next + 1) & mask) {
+      size_type home = homeSlot(slots_[next].key);
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+        slots_[hole] = std::move(slots_[next]);
+        hole = next;
+      }
+    }
+    slots_[hole] = Entry{0, Value(), false};
+    size_--;
+    return true;
+  }
+  
+  // Erase everything, keeping the capacity.
+  void clear() {
+    for (Entry& entry : slots_) {
+      entry = Entry{0, Value(), false};
+    }
+    size_ = 0;
+  }
+  
+  // Make room for count entries without growing again.
+  void reserve(size_type count) {
+    unsigned int bits = MIN_CAPACITY_BITS;
+    while (count * 4 > (size_type(1) << bits) * 3) {
+      bits++;
+    }
+    if (bits > capacityBits_) {
+      rehash(bits);
+    }
+  }
+  
+  iterator begin() noexcept { return iterator(slots_.data(), slots_.data() + slots_.size()); }
+  iterator end() noexcept { return iterator(slots_.data() + slots_.size(), slots_.data() + slots_.size()); }
+  const_iterator begin() const noexcept { return const_iterator(slots_.data(), slots_.data() + slots_.size()); }
+  const_iterator end() const noexcept {
+    return const_iterator(slots_.data() + slots_.size(), slots_.data() + slots_.size());
+  }
+  
+private:
+  static constexpr unsigned int TILE_BITS = 4; // two levels of Morton code, so a 4x4 tile
+  static constexpr unsigned int MIN_CAPACITY_BITS = TILE_BITS + 1;
+  
+  // Get the slot where the entry with this key would be without any collisions: the tile's slots are scattered by a
+  // seeded hash of the tile, and the position within the tile is kept.
+  // If two maps scattered tiles alike, iterating the bigger one would visit the smaller one's slots in order, wrapping
+  // round onto the ones already filled, so copying it in would make each insert probe past most of the ones before.
+  size_type homeSlot(std::uint64_t key) const noexcept {
+    std::uint64_t tile = (key >> TILE_BITS) * multiplier_ >> (64 - (capacityBits_ - TILE_BITS));
+    return (size_type) (tile << TILE_BITS | (key & ((1u << TILE_BITS) - 1)));
+  }
+  
+  // Get a multiplier for a new map: odd, and with its bits well mixed, like the golden ratio's. Counted out rather than
+  // random, so runs are repeatable.
+  static std::uint64_t nextMultiplier() noexcept {
+    static std::atomic<std::uint64_t> maps(0);
+    std::uint64_t multiplier = (maps.fetch_add(1, std::memory_order_relaxed) + 1) * 0x9E3779B97F4A7C15ull;
+    multiplier = (multiplier ^ multiplier >> 30u) * 0xBF58476D1CE4E5B9ull; // the splitmix64 finalizer
+    multiplier = (multiplier ^ multiplier >> 27u) * 0x94D049BB133111EBull;
+    return (multiplier ^ multiplier >> 31u) | 1u;
+  }
+  
+  // Get the slot holding key, or the empty slot it would go in. There must be at least one slot.
+  size_type findSlot(std::uint64_t key) const noexcept {
+    size_type mask = slots_.size() - 1;
+    size_type slot = homeSlot(key);
+    while (slots_[slot].occupied && slots_[slot].key != key) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+  
+  Value& findOrInsert(int x, int y, bool& inserted) {
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+      rehash(capacityBits_ == 0 ? MIN_CAPACITY_BITS : capacityBits_ + 1); // keep it at most 3/4 full
+    }
+    std::uint64_t key = packCoordinates(x, y);
+    Entry& entry = slots_[findSlot(key)];
+    inserted = !entry.occupied;
+    if (inserted) {
+      entry = Entry{key, Value(), true};
+      size_++;
+    }
+    return entry.value;
+  }
+  
+  void rehash(unsigned int capacityBits) {
+    std::vector<Entry> old(size_type(1) << capacityBits, Entry{0, Value(), false});
+    old.swap(slots_);
+    capacityBits_ = capacityBits;
+    for (Entry& entry : old) {
+      if (entry.occupied) {
+        slots_[findSlot(entry.key)] = std::move(entry);
+      }
+    }
+  }
+  
+  std::uint64_t multiplier_ = nextMultiplier(); // see homeSlot
+  std::vector<Entry> slots_; // a power of two of them, or none
+  unsigned int capacityBits_ = 0; // log2(slots_.size()), or 0 if there are none
+  size_type size_ = 0;
+};
+
+template<typename Value>
+constexpr unsigned int CoordinateMap<Value>::TILE_BITS;
+template<typename Value>
+constexpr unsigned int CoordinateMap<Value>::MIN_CAPACITY_BITS;
+
+#endif //GAME_OF_LIFE_COORDINATEMAP_H
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "DenseGrid.h"
+#include "util.h"
+
+constexpr std::size_t DenseGrid::ROWS_PER_BATCH;
+
+namespace { // local to this file
+  // Get bit of a row of words.
+  inline bool getBit(const std::uint64_t* words, int bit) {
+    return (words[bit / 64] >> (bit % 64) & 1u) != 0;
+  }
+  
+  // Set bit of a row of words to value.
+  inline void setBit(std::uint64_t* words, int bit, bool value) {
+    std::uint64_t mask = std::uint64_t(1) << (bit % 64);
+    words[bit / 64] = value ? words[bit / 64] | mask : words[bit / 64] & ~mask;
+  }
+}
+
+bool DenseGrid::supports(const Topology& topology, const Ruleset& ruleset) {
+  const NeighbourhoodType& type = ruleset.getNeighbourhoodType();
+  bool boundedKnown = dynamic_cast<const FixedTopology*>(&topology) != nullptr
+      || dynamic_cast<const WrappingTopology*>(&topology) != nullptr;
+  return boundedKnown && dynamic_cast<const MooreNeighbourhoodType*>(&type) != nullptr && type.getRadius() == 1
+      && !ruleset.isBornWith(0);
+}
+
+DenseGrid::DenseGrid(const Topology& topology, const Ruleset& ruleset)
+    : width_(topology.width() * CHUNK_SIZE), height_(topology.height() * CHUNK_SIZE),
+      words_(((std::size_t) width_ + 2 + 63) / 64),
+      wraps_(dynamic_cast<const WrappingTopology*>(&topology) != nullptr) {
+  if (!supports(topology, ruleset)) {
+    throw std::invalid_argument("The grid engine only supports fixed and wrapping topologies with Moore radius 1 "
+        "rulesets where cells aren't born with 0 neighbours");
+  }
+  setRules(ruleset);
+  
+  cells_.assign((std::size_t) (height_ + 2) * words_, 0);
+  next_.assign(cells_.size(), 0);
+  
+  // Cell x is bit x + 1, so the board is bits [1, width_] of the row
+  boardMask_.assign(words_, 0);
+  for (int x = 0; x < width_; x++) {
+    boardMask_[(x + 1) / 64] |= Word(1) << ((x + 1) % 64);
+  }
+}
+
+void DenseGrid::setRules(const Ruleset& ruleset) {
+  const NeighbourhoodType& type = ruleset.getNeighbourhoodType();
+  if (dynamic_cast<const MooreNeighbourhoodType*>(&type) == nullptr || type.getRadius() != 1
+      || ruleset.isBornWith(0)) {
+    throw std::invalid_argument("The grid engine only supports Moore radius 1 rulesets where cells aren't born with 0 "
+        "neighbours");
+  }
+  for (unsigned int count = 0; count <= 8; count++) {
+    born_[count] = ruleset.isBornWith(count);
+    survives_[count] = ruleset.survivesWith(count);
+  }
+}
+
+// Stepping
+
+long long DenseGrid::step(ThreadPool* threadPool) {
+  refreshBorder();
+  
+  long long population = 0;
+  if (threadPool == nullptr) {
+    population = stepRows(0, height_);
+  } else {
+    // Rows only read cells_ and write their own row of next_, so they can go in any order, on any thread
+    std::vector<long long> populations(threadPool->size(), 0);
+    threadPool->parallelFor((std::size_t) height_, ROWS_PER_BATCH, [this, &populations] (std::size_t begin,
+        std::size_t end, unsigned int worker) {
+      populations[worker] += stepRows((int) begin, (int) end);
+    });
+    for (long long counted : populations) {
+      population += counted;
+    }
+  }
+  
+  cells_.swap(next_);
+  return population;
+}
+
+void DenseGrid::refreshBorder() noexcept {
+  if (!wraps_) return; // the border is never written, so it stays dead
+  
+  // The ghost columns of each row from the opposite edge, then the ghost rows (corners and all) from the opposite rows
+  for (int y = 0; y < height_; y++) {
+    Word* cells = row(cells_, y);
+    setBit(cells, 0, getBit(cells, width_));
+    setBit(cells, width_ + 1, getBit(cells, 1));
+  }
+  std::copy(row(cells_, height_ - 1), row(cells_, height_), row(cells_, -1));
+  std::copy(row(cells_, 0), row(cells_, 1), row(cells_, height_));
+}
+
+long long DenseGrid::stepRows(int begin, int end) noexcept {
+  std::size_t words = words_;
+  long long population = 0;
+  for (int y = begin; y < end; y++) {
+    const Word* above = row(cells_, y - 1);
+    const Word* here = row(cells_, y);
+    const Word* below = row(cells_, y + 1);
+    Word* next = row(next_, y);
+    
+    for (std::size_t i = 0; i < words; i++) {
+      // The cells to the west and east of each bit, carried across the words on either side
+      Word westAbove = above[i] << 1u | (i > 0 ? above[i - 1] >> 63u : 0);
+      Word eastAbove = above[i] >> 1u | (i + 1 < words ? above[i + 1] << 63u : 0);
+      Word westHere = here[i] << 1u | (i > 0 ? here[i - 1] >> 63u : 0);
+      Word eastHere = here[i] >> 1u | (i + 1 < words ? here[i + 1] << 63u : 0);
+      Word westBelow = below[i] << 1u | (i > 0 ? below[i - 1] >> 63u : 0);
+      Word eastBelow = below[i] >> 1u | (i + 1 < words ? below[i + 1] << 63u : 0);
+      
+      // Sum the eight neighbours of every cell at once into a four-bit count: ones, twos, fours, eights
+      Word onesAbove, twosAbove, onesBelow, twosBelow;
+      fullAdd(westAbove, above[i], eastAbove, onesAbove, twosAbove);
+      fullAdd(westBelow, below[i], eastBelow, onesBelow, twosBelow);
+      Word onesHere = westHere ^ eastHere, twosHere = westHere & eastHere;
+      
+      Word ones, twosCarry;
+      fullAdd(onesAbove, onesBelow, onesHere, ones, twosCarry);
+      
+      Word twosA = twosAbove ^ twosBelow, foursA = twosAbove & twosBelow;
+      Word twosB = twosHere ^ twosCarry, foursB = twosHere & twosCarry;
+      Word twos = twosA ^ twosB, foursC = twosA & twosB;
+      
+      Word fours, eights;
+      fullAdd(foursA, foursB, foursC, fours, eights);
+      
+      // Apply the rules, then clear the ghost columns so they only ever hold what refreshBorder puts there
+      Word alive = here[i], result = 0;
+      for (unsigned int count = 0; count <= 8; count++) {
+        if (!born_[count] && !survives_[count]) continue;
+        Word withCount = (count & 1u ? ones : ~ones) & (count & 2u ? twos : ~twos)
+            & (count & 4u ? fours : ~fours) & (count & 8u ? eights : ~eights);
+        result |= withCount & ((born_[count] ? ~alive : 0) | (survives_[count] ? alive : 0));
+      }
+      result &= boardMask_[i];
+      next[i] = result;
+      population += popcount(result);
+    }
+  }
+  return population;
+}
+
+// Cells
+
+bool DenseGrid::getCell(int x, int y) const noexcept {
+  return getBit(row(cells_, y), x + 1);
+}
+
+void DenseGrid::setCell(int x, int y, bool value) noexcept {
+  setBit(row(cells_, y), x + 1, value);
+}
+
+Chunk::Row DenseGrid::chunkRow(int chunkX, int chunkY, int y) const noexcept {
+  // The chunk's row may straddle two words
+  const Word* cells = row(cells_, chunkY * CHUNK_SIZE + y);
+  int bit = chunkX * CHUNK_SIZE + 1, offset = bit % 64;
+  Word bits = cells[bit / 64] >> offset;
+  if (offset + CHUNK_SIZE > 64) {
+    bits |= cells[bit / 64 + 1] << (64 - offset);
+  }
+  return bits & Chunk::ROW_MASK;
+}
+
+void DenseGrid::addLiveCells(int chunkX, int chunkY, int y, Chunk::Row bits) noexcept {
+  Word* cells = row(cells_, chunkY * CHUNK_SIZE + y);
+  bits &= Chunk::ROW_MASK;
+  int bit = chunkX * CHUNK_SIZE + 1, offset = bit % 64;
+  cells[bit / 64] |= bits << offset;
+  if (offset + CHUNK_SIZE > 64) {
+    cells[bit / 64 + 1] |= bits >> (64 - offset);
+  }
+}
+
+void DenseGrid::clear() noexcept {
+  std::fill(cells_.begin(), cells_.end(), 0);
+  std::fill(next_.begin(), next_.end(), 0);
+}
+
+std::size_t DenseGrid::memoryUsage() const noexcept {
+  return (cells_.capacity() + next_.capacity() + boardMask_.capacity()) * sizeof(Word);
+}
@@ -0,0 +1,83 @@
+#ifndef GAME_OF_LIFE_DENSEGRID_H
+#define GAME_OF_LIFE_DENSEGRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Chunk.h"
+#include "Ruleset.h"
+#include "ThreadPool.h"
+#include "Topology.h"
+
+// The whole of a bounded universe as one bit-packed grid, for Automaton's grid engine. A FixedTopology or
+// WrappingTopology is only so many chunks across, so instead of looking chunks up and linking them, every cell lives
+// in one contiguous array of rows, each packed into 64-bit words with the cell at x in bit x + 1. Around the board is a
+// ghost border one cell wide: dead past the edge of a FixedTopology, and a copy of the opposite edge in a
+// WrappingTopology, refreshed once per step. A step is then a plain stencil streaming down the rows, each word of the
+// next generation worked out from the three words above, at and below it with bitwise full adders, the same way as
+// BitwiseMooreKernel.
+class DenseGrid {
+public:
+  // Can a grid run ruleset in topology? It needs a FixedTopology or WrappingTopology, and totalistic Moore radius 1
+  // rules in which cells aren't born with 0 neighbours (which the chunks would only apply where there are chunks).
+  static bool supports(const Topology& topology, const Ruleset& ruleset);
+  
+  // Initialize an empty grid covering topology, to run ruleset.
+  // Throw std::invalid_argument if it can't; see DenseGrid::supports.
+  DenseGrid(const Topology& topology, const Ruleset& ruleset);
+  
+  // Switch to ruleset's rules, which must have the same neighbourhood. Throw std::invalid_argument if it can't run it.
+  void setRules(const Ruleset& ruleset);
+  
+  // Move every cell on to the next generation, spreading the rows over threadPool if it isn't nullptr. Return the
+  // population of the new generation.
+  long long step(ThreadPool* threadPool);
+  
+  // Get the value of the cell at (x, y), in cell coordinates on the board, with no bounds checking.
+  bool getCell(int x, int y) const noexcept;
+  
+  // Set the value of the cell at (x, y), in cell coordinates on the board, with no bounds checking.
+  void setCell(int x, int y, bool value) noexcept;
+  
+  // Get row y (in [0, CHUNK_SIZE)) of the chunk at (chunkX, chunkY), packed like Chunk::row, with no bounds checking.
+  Chunk::Row chunkRow(int chunkX, int chunkY, int y) const noexcept;
+  
+  // Make the cells in bits live in row y of the chunk at (chunkX, chunkY), like Chunk::addLiveCells, with no bounds
+  // checking.
+  void addLiveCells(int chunkX, int chunkY, int y, Chunk::Row bits) noexcept;
+  
+  // Kill every cell.
+  void clear() noexcept;
+  
+  // Get the bytes taken up by the grid.
+  std::size_t memoryUsage() const noexcept;
+  
+  static constexpr std::size_t ROWS_PER_BATCH = 32; // how many rows each thread takes from the pool at a time
+  
+private:
+  typedef std::uint64_t Word;
+  
+  // Get the first word of row y of cells, where y is in [-1, height_]: -1 and height_ are the ghost rows.
+  Word* row(std::vector<Word>& cells, int y) noexcept { return &cells[(std::size_t) (y + 1) * words_]; }
+  const Word* row(const std::vector<Word>& cells, int y) const noexcept {
+    return &cells[(std::size_t) (y + 1) * words_];
+  }
+  
+  // Fill in the ghost border around cells_ from the board: wrapped round, or left dead.
+  void refreshBorder() noexcept;
+  
+  // Work out rows [begin, end) of next_ from cells_, returning their population.
+  long long stepRows(int begin, int end) noexcept;
+  
+  int width_, height_; // in cells
+  std::size_t words_; // per row, including the ghost columns
+  bool wraps_;
+  std::vector<Word> cells_; // (height_ + 2) rows of words_ words each, the ghost rows first and last
+  std::vector<Word> next_; // the same, for the generation being worked out
+  std::vector<Word> boardMask_; // per word of a row, the bits which are on the board and not in the ghost columns
+  bool born_[9]; // born_[i]: is a dead cell with i live neighbours born? Copied from the ruleset
+  bool survives_[9]; // survives_[i]: does a live cell with i live neighbours survive?
+};
+
+#endif //GAME_OF_LIFE_DENSEGRID_H
@@ -0,0 +1,53 @@
+#include <stdexcept>
+
+#include "DensityPyramid.h"
+#include "util.h"
+
+constexpr int DensityPyramid::LEVELS;
+
+DensityPyramid::DensityPyramid() : levels_(LEVELS) {}
+
+void DensityPyramid::reserve(std::size_t chunks) {
+  levels_[0].reserve(chunks); // the levels above have at most as many tiles, and usually far fewer
+}
+
+void DensityPyramid::clear() {
+  for (CoordinateMap<long long>& tiles : levels_) {
+    tiles.clear();
+  }
+}
+
+long long DensityPyramid::population(int level, int x, int y) const {
+  const long long* population = this->level(level).find(x, y);
+  return population ? *population : 0;
+}
+
+const CoordinateMap<long long>& DensityPyramid::level(int level) const {
+  if (level < 0 || level >= LEVELS) {
+    throw std::out_of_range("There is no such level in the density pyramid");
+  }
+  return levels_[level];
+}
+
+std::size_t DensityPyramid::memoryUsage() const noexcept {
+  std::size_t bytes = 0;
+  for (const CoordinateMap<long long>& level : levels_) {
+    bytes += level.memoryUsage();
+  }
+  return bytes;
+}
+
+void DensityPyramid::setChunkPopulation(int x, int y, long long population) {
+  const long long* old = levels_[0].find(x, y);
+  long long delta = population - (old ? *old : 0);
+  if (delta == 0) return;
+  
+  for (int level = 0; level < LEVELS; level++) {
+    int tileX = floorDiv(x, 1 << level), tileY = floorDiv(y, 1 << level);
+    long long& tile = levels_[level].findOrInsert(tileX, tileY);
+    tile += delta;
+    if (tile == 0) {
+      levels_[level].erase(tileX, tileY);
+    }
+  }
+}
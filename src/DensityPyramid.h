@@ -0,0 +1,42 @@
+#ifndef GAME_OF_LIFE_DENSITYPYRAMID_H
+#define GAME_OF_LIFE_DENSITYPYRAMID_H
+
+#include <vector>
+
+#include "CoordinateMap.h"
+
+// The populations of a field of chunks at several resolutions, for drawing it zoomed out without looking at any cells.
+// Level k has a tile per 2^k x 2^k chunks, holding their total population: the tile (x, y) covers the chunks from
+// (x * 2^k, y * 2^k) to ((x + 1) * 2^k - 1, (y + 1) * 2^k - 1), so level 0 is the chunks themselves. Only non-empty
+// tiles are kept. It's kept up to date a chunk at a time, from the chunks in Simulation's frames, with each chunk's
+// population going up through every level as a difference from what it was.
+class DensityPyramid {
+public:
+  static constexpr int LEVELS = 12; // the last level has a tile per 2048 x 2048 chunks
+  
+  DensityPyramid();
+  
+  // Set the population of the chunk at (x, y), bringing every level up to date.
+  void setChunkPopulation(int x, int y, long long population);
+  
+  // Make room for the populations of this many chunks, ahead of setting them all.
+  void reserve(std::size_t chunks);
+  
+  // Forget every population.
+  void clear();
+  
+  // Get the total population of the tile (x, y) of level, or 0 if it's empty.
+  // Throw std::out_of_range if level isn't in [0, LEVELS).
+  long long population(int level, int x, int y) const;
+  
+  // Get the non-empty tiles of level, by tile coordinates. Throw std::out_of_range if level isn't in [0, LEVELS).
+  const CoordinateMap<long long>& level(int level) const;
+  
+  // Get the bytes taken up by every level's map.
+  std::size_t memoryUsage() const noexcept;
+  
+private:
+  std::vector<CoordinateMap<long long>> levels_;
+};
+
+#endif //GAME_OF_LIFE_DENSITYPYRAMID_H
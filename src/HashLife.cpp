@@ -0,0 +1,498 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "HashLife.h"
+
+constexpr long long HashLife::MAX_COORDINATE;
+constexpr unsigned int HashLife::MAX_LOG2_STEP;
+constexpr unsigned int HashLife::MIN_ROOT_LEVEL;
+constexpr unsigned int HashLife::MAX_LEVEL;
+constexpr std::size_t HashLife::DEFAULT_MAX_NODES;
+
+bool HashLife::supports(const Ruleset& ruleset) {
+  const NeighbourhoodType& type = ruleset.getNeighbourhoodType();
+  // Empty regions must stay empty, or nothing could be skipped
+  return dynamic_cast<const MooreNeighbourhoodType*>(&type) != nullptr && type.getRadius() == 1
+      && !ruleset.isBornWith(0);
+}
+
+HashLife::HashLife(const Ruleset& ruleset)
+    : dead_{nullptr, nullptr, nullptr, nullptr, nullptr, 0, 0, false},
+      alive_{nullptr, nullptr, nullptr, nullptr, nullptr, 1, 0, false} {
+  setRules(ruleset);
+  emptyNodes_.push_back(&dead_);
+  root_ = empty(MIN_ROOT_LEVEL);
+}
+
+HashLife::~HashLife() {
+  for (Node* node : nodes_) {
+    delete node;
+  }
+}
+
+void HashLife::setRules(const Ruleset& ruleset) {
+  if (!supports(ruleset)) {
+    throw std::invalid_argument("HashLife only supports Moore radius 1 rulesets where cells aren't born with 0 "
+        "neighbours");
+  }
+  
+  bool changed = false;
+  for (unsigned int count = 0; count <= 8; count++) {
+    bool born = ruleset.isBornWith(count), survives = ruleset.survivesWith(count);
+    changed = changed || born != born_[count] || survives != survives_[count];
+    born_[count] = born;
+    survives_[count] = survives;
+  }
+  if (changed) {
+    clearResults(); // they were for the old rules
+  }
+}
+
+// Stepping
+
+void HashLife::tick() {
+  step(0);
+}
+
+void HashLife::step(unsigned int log2Generations) {
+  if (log2Generations > MAX_LOG2_STEP) {
+    throw std::invalid_argument("Cannot step HashLife by more than 2^MAX_LOG2_STEP generations at once");
+  }
+  if (nodes_.size() > maxNodes_) {
+    garbageCollect(); // only between steps, so nothing we're still using can be collected
+  }
+  if (log2Generations != stepLog_) {
+    clearResults(); // they were for a different number of generations
+    stepLog_ = log2Generations;
+  }
+  
+  // The successor of the root is its central half, but the pattern can spread by up to one cell per generation.
+  // So pad until the pattern is in the central half and the root is big enough to step this far, then pad once more,
+  // so it's in the central quarter and can't spread out of the central half.
+  while (root_->level < stepLog_ + 2 || !inInnerHalf(root_)) {
+    root_ = expand(root_);
+  }
+  root_ = expand(root_);
+  root_ = successor(root_);
+  
+  // Trim the padding back off, so the next step doesn't have to step it
+  while (root_->level > MIN_ROOT_LEVEL && inInnerHalf(root_)) {
+    root_ = centre(root_);
+  }
+  
+  generation_ += 1LL << stepLog_;
+}
+
+HashLife::Node* HashLife::successor(Node* node) {
+  if (node->population == 0) {
+    return empty(node->level - 1);
+  }
+  if (node->next != nullptr) {
+    return node->next;
+  }
+  if (node->level == 2) {
+    node->next = baseSuccessor(node);
+    return node->next;
+  }
+  
+  // The nine overlapping level - 1 squares of node, each stepped and centred: c11 is the north-west one, c12 north,
+  // and so on, so together they cover the central 3/4 of node, one level down
+  Node* nw = node->nw, * ne = node->ne, * sw = node->sw, * se = node->se;
+  Node* c11 = successor(nw);
+  Node* c12 = successor(join(nw->ne, ne->nw, nw->se, ne->sw));
+  Node* c13 = successor(ne);
+  Node* c21 = successor(join(nw->sw, nw->se, sw->nw, sw->ne));
+  Node* c22 = successor(join(nw->se, ne->sw, sw->ne, se->nw));
+  Node* c23 = successor(join(ne->sw, ne->se, se->nw, se->ne));
+  Node* c31 = successor(sw);
+  Node* c32 = successor(join(sw->ne, se->nw, sw->se, se->sw));
+  Node* c33 = successor(se);
+  
+  Node* result;
+  if (stepLog_ < node->level - 2) {
+    // The nine squares have already been stepped far enough, so just take the middle of each group of four
+    result = join(join(c11->se, c12->sw, c21->ne, c22->nw), join(c12->se, c13->sw, c22->ne, c23->nw),
+        join(c21->se, c22->sw, c31->ne, c32->nw), join(c22->se, c23->sw, c32->ne, c33->nw));
+  } else {
+    // Step each group of four as far again, for 2^(level - 2) generations in total
+    result = join(successor(join(c11, c12, c21, c22)), successor(join(c12, c13, c22, c23)),
+        successor(join(c21, c22, c31, c32)), successor(join(c22, c23, c32, c33)));
+  }
+  
+  node->next = result;
+  return result;
+}
+
+HashLife::Node* HashLife::baseSuccessor(Node* node) {
+  // Read the 4x4 cells into 16 bits, bit y * 4 + x
+  unsigned int cells = 0;
+  const Node* quadrants[4] = {node->nw, node->ne, node->sw, node->se};
+  for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+    const Node* q = quadrants[quadrant];
+    const Node* leaves[4] = {q->nw, q->ne, q->sw, q->se};
+    for (unsigned int leaf = 0; leaf < 4; leaf++) {
+      unsigned int x = (quadrant & 1u) * 2 + (leaf & 1u), y = (quadrant >> 1u) * 2 + (leaf >> 1u);
+      if (leaves[leaf]->population != 0) {
+        cells |= 1u << (y * 4 + x);
+      }
+    }
+  }
+  
+  // Apply the rules to the central four cells
+  Node* next[4];
+  for (unsigned int i = 0; i < 4; i++) {
+    unsigned int x = 1 + (i & 1u), y = 1 + (i >> 1u);
+    unsigned int count = 0;
+    for (unsigned int ny = y - 1; ny <= y + 1; ny++) {
+      for (unsigned int nx = x - 1; nx <= x + 1; nx++) {
+        if ((nx != x || ny != y) && (cells >> (ny * 4 + nx) & 1u)) {
+          count++;
+        }
+      }
+    }
+    bool alive = (cells >> (y * 4 + x) & 1u) != 0;
+    next[i] = (alive ? survives_[count] : born_[count]) ? &alive_ : &dead_;
+  }
+  cellsEvaluated_ += 4;
+  return join(next[0], next[1], next[2], next[3]);
+}
+
+long long HashLife::generation() const noexcept {
+  return generation_;
+}
+
+long long HashLife::population() const noexcept {
+  return root_->population;
+}
+
+// Cells
+
+bool HashLife::getCell(long long x, long long y) const {
+  long long half = rootHalfSize();
+  if (x < -half || x >= half || y < -half || y >= half) {
+    return false;
+  }
+  return getCell(root_, x + half, y + half);
+}
+
+bool HashLife::getCell(const Node* node, long long x, long long y) {
+  while (node->level > 0) {
+    if (node->population == 0) return false;
+    long long quarter = 1LL << (node->level - 1);
+    bool east = x >= quarter, south = y >= quarter;
+    node = south ? (east ? node->se : node->sw) : (east ? node->ne : node->nw);
+    if (east) x -= quarter;
+    if (south) y -= quarter;
+  }
+  return node->population != 0;
+}
+
+void HashLife::setCell(long long x, long long y, bool value) {
+  if (x < -MAX_COORDINATE || x >= MAX_COORDINATE || y < -MAX_COORDINATE || y >= MAX_COORDINATE) {
+    throw std::out_of_range("Cannot set a HashLife cell further than MAX_COORDINATE from the origin");
+  }
+  while (x < -rootHalfSize() || x >= rootHalfSize() || y < -rootHalfSize() || y >= rootHalfSize()) {
+    root_ = expand(root_);
+  }
+  root_ = setCell(root_, x + rootHalfSize(), y + rootHalfSize(), value);
+}
+
+HashLife::Node* HashLife::setCell(Node* node, long long x, long long y, bool value) {
+  if (node->level == 0) {
+    return value ? &alive_ : &dead_;
+  }
+  
+  long long half = 1LL << (node->level - 1);
+  Node* nw = node->nw, * ne = node->ne, * sw = node->sw, * se = node->se;
+  if (y < half) {
+    if (x < half) nw = setCell(nw, x, y, value);
+    else ne = setCell(ne, x - half, y, value);
+  } else {
+    if (x < half) sw = setCell(sw, x, y - half, value);
+    else se = setCell(se, x - half, y - half, value);
+  }
+  return join(nw, ne, sw, se);
+}
+
+void HashLife::load(std::vector<Cell> liveCells) {
+  long long furthest = furthestExtent(liveCells);
+  unsigned int level = MIN_ROOT_LEVEL;
+  while ((1LL << (level - 1)) < furthest) {
+    level++;
+  }
+  long long half = 1LL << (level - 1);
+  root_ = build(level, -half, -half, liveCells.begin(), liveCells.end());
+  generation_ = 0;
+}
+
+void HashLife::add(std::vector<Cell> liveCells) {
+  long long furthest = furthestExtent(liveCells);
+  while (rootHalfSize() < furthest) {
+    root_ = expand(root_);
+  }
+  long long half = rootHalfSize();
+  root_ = merge(root_, build(root_->level, -half, -half, liveCells.begin(), liveCells.end()));
+}
+
+long long HashLife::furthestExtent(const std::vector<Cell>& cells) {
+  long long furthest = 0;
+  for (const Cell& cell : cells) {
+    if (cell.first < -MAX_COORDINATE || cell.first >= MAX_COORDINATE || cell.second < -MAX_COORDINATE
+        || cell.second >= MAX_COORDINATE) {
+      throw std::out_of_range("Cannot load a HashLife cell further than MAX_COORDINATE from the origin");
+    }
+    furthest = std::max({furthest, cell.first < 0 ? -cell.first : cell.first + 1,
+        cell.second < 0 ? -cell.second : cell.second + 1});
+  }
+  return furthest;
+}
+
+HashLife::Node* HashLife::merge(Node* a, Node* b) {
+  if (b->population == 0 || a == b) return a;
+  if (a->population == 0) return b;
+  if (a->level == 0) return &alive_; // both are alive
+  return join(merge(a->nw, b->nw), merge(a->ne, b->ne), merge(a->sw, b->sw), merge(a->se, b->se));
+}
+
+HashLife::Node* HashLife::build(unsigned int level, long long x, long long y, std::vector<Cell>::iterator begin,
+    std::vector<Cell>::iterator end) {
+  if (begin == end) {
+    return empty(level);
+  }
+  if (level == 0) {
+    return &alive_;
+  }
+  
+  // Split the cells into quadrants, north then south, each west then east
+  long long half = 1LL << (level - 1);
+  auto south = std::partition(begin, end, [y, half] (const Cell& cell) { return cell.second < y + half; });
+  auto northEast = std::partition(begin, south, [x, half] (const Cell& cell) { return cell.first < x + half; });
+  auto southEast = std::partition(south, end, [x, half] (const Cell& cell) { return cell.first < x + half; });
+  
+  Node* nw = build(level - 1, x, y, begin, northEast);
+  Node* ne = build(level - 1, x + half, y, northEast, south);
+  Node* sw = build(level - 1, x, y + half, south, southEast);
+  Node* se = build(level - 1, x + half, y + half, southEast, end);
+  return join(nw, ne, sw, se);
+}
+
+void HashLife::clear() {
+  root_ = empty(MIN_ROOT_LEVEL);
+  generation_ = 0;
+  garbageCollect();
+}
+
+void HashLife::forEachCell(const std::function<void(long long, long long)>& action) const {
+  forEachCell(root_, -rootHalfSize(), -rootHalfSize(), action);
+}
+
+void HashLife::forEachCell(const Node* node, long long x, long long y,
+    const std::function<void(long long, long long)>& action) const {
+  if (node->population == 0) return;
+  if (node->level == 0) {
+    action(x, y);
+    return;
+  }
+  
+  long long half = 1LL << (node->level - 1);
+  forEachCell(node->nw, x, y, action);
+  forEachCell(node->ne, x + half, y, action);
+  forEachCell(node->sw, x, y + half, action);
+  forEachCell(node->se, x + half, y + half, action);
+}
+
+void HashLife::forEachLeaf(const std::function<void(long long, long long, std::uint64_t)>& action) const {
+  forEachLeaf(root_, -rootHalfSize(), -rootHalfSize(), action);
+}
+
+void HashLife::forEachLeaf(const Node* node, long long x, long long y,
+    const std::function<void(long long, long long, std::uint64_t)>& action) const {
+  if (node->population == 0) return;
+  if (node->level == 3) {
+    std::uint64_t cells = 0;
+    leafCells(node, 0, 0, cells);
+    action(x, y, cells);
+    return;
+  }
+  
+  long long half = 1LL << (node->level - 1);
+  forEachLeaf(node->nw, x, y, action);
+  forEachLeaf(node->ne, x + half, y, action);
+  forEachLeaf(node->sw, x, y + half, action);
+  forEachLeaf(node->se, x + half, y + half, action);
+}
+
+void HashLife::leafCells(const Node* node, int x, int y, std::uint64_t& cells) {
+  if (node->population == 0) return;
+  if (node->level == 0) {
+    cells |= std::uint64_t(1) << (8 * y + x);
+    return;
+  }
+  
+  int half = 1 << (node->level - 1);
+  leafCells(node->nw, x, y, cells);
+  leafCells(node->ne, x + half, y, cells);
+  leafCells(node->sw, x, y + half, cells);
+  leafCells(node->se, x + half, y + half, cells);
+}
+
+// Macrocell
+
+void HashLife::writeMacrocell(std::ostream& out) const {
+  std::unordered_map<const Node*, std::size_t> indices;
+  std::size_t count = 0;
+  if (writeMacrocell(out, root_, indices, count) == 0) {
+    out << "$\n"; // an empty leaf, so there's a root
+  }
+}
+
+std::size_t HashLife::writeMacrocell(std::ostream& out, const Node* node,
+    std::unordered_map<const Node*, std::size_t>& indices, std::size_t& count) {
+  if (node->population == 0) {
+    return 0;
+  }
+  auto found = indices.find(node);
+  if (found != indices.end()) {
+    return found->second;
+  }
+  
+  if (node->level == 3) {
+    // A leaf: each row of the 8x8 as . and *, ended by $, leaving off trailing dead cells and rows
+    std::string leaf, emptyRows;
+    for (int y = 0; y < 8; y++) {
+      std::string row;
+      for (int x = 0; x < 8; x++) {
+        row += getCell(node, x, y) ? '*' : '.';
+      }
+      row.erase(row.find_last_not_of('.') + 1);
+      if (row.empty()) {
+        emptyRows += '$'; // only written if a later row has something
+      } else {
+        leaf += emptyRows + row + '$';
+        emptyRows.clear();
+      }
+    }
+    out << leaf << '\n';
+  } else {
+    std::size_t nw = writeMacrocell(out, node->nw, indices, count);
+    std::size_t ne = writeMacrocell(out, node->ne, indices, count);
+    std::size_t sw = writeMacrocell(out, node->sw, indices, count);
+    std::size_t se = writeMacrocell(out, node->se, indices, count);
+    out << node->level << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
+  }
+  indices.emplace(node, ++count);
+  return count;
+}
+
+// Node management
+
+std::size_t HashLife::NodeHash::operator()(const Node* node) const noexcept {
+  std::size_t hash = std::hash<const Node*>()(node->nw);
+  for (const Node* child : {node->ne, node->sw, node->se}) {
+    hash ^= std::hash<const Node*>()(child) + 0x9e3779b9 + (hash << 6u) + (hash >> 2u); // boost's hash_combine
+  }
+  return hash;
+}
+
+bool HashLife::NodeEqual::operator()(const Node* a, const Node* b) const noexcept {
+  return a->nw == b->nw && a->ne == b->ne && a->sw == b->sw && a->se == b->se;
+}
+
+HashLife::Node* HashLife::join(Node* nw, Node* ne, Node* sw, Node* se) {
+  Node key{nw, ne, sw, se, nullptr, 0, 0, false};
+  auto it = nodes_.find(&key);
+  if (it != nodes_.end()) {
+    return *it;
+  }
+  
+  Node* node = new Node{nw, ne, sw, se, nullptr, nw->population + ne->population + sw->population + se->population,
+      nw->level + 1, false};
+  nodes_.insert(node);
+  return node;
+}
+
+HashLife::Node* HashLife::empty(unsigned int level) {
+  while (emptyNodes_.size() <= level) {
+    Node* below = emptyNodes_.back();
+    emptyNodes_.push_back(join(below, below, below, below));
+  }
+  return emptyNodes_[level];
+}
+
+HashLife::Node* HashLife::expand(Node* node) {
+  if (node->level >= MAX_LEVEL) {
+    throw std::overflow_error("HashLife pattern has grown too big");
+  }
+  Node* e = empty(node->level - 1);
+  return join(join(e, e, e, node->nw), join(e, e, node->ne, e), join(e, node->sw, e, e), join(node->se, e, e, e));
+}
+
+HashLife::Node* HashLife::centre(Node* node) {
+  return join(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+bool HashLife::inInnerHalf(const Node* node) {
+  return node->population == node->nw->se->population + node->ne->sw->population + node->sw->ne->population
+      + node->se->nw->population;
+}
+
+long long HashLife::rootHalfSize() const noexcept {
+  return 1LL << (root_->level - 1);
+}
+
+std::size_t HashLife::nodeCount() const noexcept {
+  return nodes_.size();
+}
+
+unsigned long long HashLife::cellsEvaluated() const noexcept {
+  return cellsEvaluated_;
+}
+
+std::size_t HashLife::memoryUsage() const noexcept {
+  // Each node, plus the table's own node holding the pointer to it (a link, the pointer and maybe a cached hash)
+  return nodes_.size() * (sizeof(Node) + 3 * sizeof(void*)) + nodes_.bucket_count() * sizeof(void*);
+}
+
+std::size_t HashLife::maxNodes() const noexcept {
+  return maxNodes_;
+}
+
+void HashLife::setMaxNodes(std::size_t maxNodes) {
+  maxNodes_ = maxNodes;
+}
+
+void HashLife::clearResults() {
+  for (Node* node : nodes_) {
+    node->next = nullptr;
+  }
+}
+
+void HashLife::mark(Node* node) {
+  if (node->level == 0 || node->marked) return;
+  node->marked = true;
+  mark(node->nw);
+  mark(node->ne);
+  mark(node->sw);
+  mark(node->se);
+}
+
+void HashLife::garbageCollect() {
+  mark(root_);
+  for (Node* node : emptyNodes_) {
+    mark(node);
+  }
+  
+  // The memoized results of the survivors may point at nodes which don't, so they all go
+  for (auto it = nodes_.begin(); it != nodes_.end();) {
+    Node* node = *it;
+    if (node->marked) {
+      node->marked = false;
+      node->next = nullptr;
+      ++it;
+    } else {
+      it = nodes_.erase(it);
+      delete node;
+    }
+  }
+}
@@ -0,0 +1,171 @@
+#ifndef GAME_OF_LIFE_HASHLIFE_H
+#define GAME_OF_LIFE_HASHLIFE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Ruleset.h"
+
+// An implementation of Gosper's HashLife: the universe is a quadtree whose nodes are hash-consed, so identical regions
+// are stored once, and each node memoizes its own future, so repeated regions are only ever evolved once. This lets it
+// jump through 2^k generations in one step, which is what unbounded patterns like guns and breeders need.
+// It has the same surface as Automaton (tick, generation, population, getCell/setCell), plus HashLife::step to jump.
+// It only handles totalistic Moore radius-1 rulesets in which no cell is born with 0 neighbours, on an unbounded
+// plane; check with HashLife::supports(const Ruleset&). Cells are addressed by cell (not chunk) coordinates, and
+// must be within MAX_COORDINATE of the origin.
+// The node cache is bounded: when it has grown past maxNodes() at the start of a step, every node no longer part of
+// the universe is garbage-collected, along with all the memoized results.
+class HashLife {
+public:
+  typedef std::pair<long long, long long> Cell; // (x, y) of a live cell
+  
+  static constexpr long long MAX_COORDINATE = 1LL << 60; // cells must be in [-MAX_COORDINATE, MAX_COORDINATE)
+  static constexpr unsigned int MAX_LOG2_STEP = 56; // the most generations one step can take is 2^MAX_LOG2_STEP
+  
+  // Can HashLife evolve an automaton with this ruleset?
+  static bool supports(const Ruleset& ruleset);
+  
+  // Initialize an empty universe with the born and survive rules of ruleset, which aren't tied to it afterwards.
+  // Throw std::invalid_argument if the ruleset isn't supported.
+  explicit HashLife(const Ruleset& ruleset);
+  
+  ~HashLife(); // delete all the nodes
+  
+  HashLife(const HashLife&) = delete;
+  HashLife& operator=(const HashLife&) = delete;
+  
+  // Take the born and survive rules from ruleset. If they've changed, forget the memoized results.
+  // Throw std::invalid_argument if the ruleset isn't supported.
+  void setRules(const Ruleset& ruleset);
+  
+  // Advance the universe to the next generation.
+  void tick();
+  
+  // Advance the universe by 2^log2Generations generations at once.
+  // Throw std::invalid_argument if log2Generations > MAX_LOG2_STEP, or std::overflow_error if the pattern would grow
+  // past MAX_COORDINATE.
+  void step(unsigned int log2Generations);
+  
+  long long generation() const noexcept; // Get the current generation. The first generation is 0.
+  long long population() const noexcept; // Get the total number of live cells.
+  
+  // Get the value of the cell at (x, y).
+  bool getCell(long long x, long long y) const;
+  
+  // Set the value of the cell at (x, y). Throw std::out_of_range if it's not within MAX_COORDINATE of the origin.
+  void setCell(long long x, long long y, bool value);
+  
+  // Replace the whole universe with one whose live cells are exactly liveCells, building the tree in one pass
+  // instead of one path per cell. Throw std::out_of_range if any is not within MAX_COORDINATE of the origin.
+  void load(std::vector<Cell> liveCells);
+  
+  // Make the cells in liveCells live too, keeping the ones already live, the generation count and the memoized
+  // results. Building up a big universe a batch at a time means the whole list of its cells is never needed.
+  // Throw std::out_of_range if any is not within MAX_COORDINATE of the origin.
+  void add(std::vector<Cell> liveCells);
+  
+  // Kill every cell and reset the generation count.
+  void clear();
+  
+  // Call action(x, y) for every live cell, skipping empty regions whole.
+  void forEachCell(const std::function<void(long long, long long)>& action) const;
+  
+  // Call action(x, y, cells) for every 8x8 leaf with live cells, where (x, y) is its top-left corner (both multiples
+  // of 8) and the cell at (x + i, y + j) is bit 8 * j + i of cells. A call per leaf rather than per cell, for copying
+  // the universe out.
+  void forEachLeaf(const std::function<void(long long, long long, std::uint64_t)>& action) const;
+  
+  // Write the universe as the node lines of a Macrocell file: 8x8 leaves, then each node after its children, with the
+  // root last. Like Golly, the root is centred on the origin. The header and rule lines are up to the caller.
+  void writeMacrocell(std::ostream& out) const;
+  
+  std::size_t nodeCount() const noexcept; // Get the number of nodes in the cache.
+  // Get the number of cells worked out from their neighbours so far: four for each 4x4 square stepped by hand. All
+  // the rest of a step is looked up or put together from these.
+  unsigned long long cellsEvaluated() const noexcept;
+  std::size_t memoryUsage() const noexcept; // Estimate the bytes taken up by the nodes and the table of them.
+  std::size_t maxNodes() const noexcept; // Get the number of nodes the cache may hold before it's garbage-collected.
+  void setMaxNodes(std::size_t maxNodes); // Set the above.
+  
+  // Delete every node not part of the current universe and forget all the memoized results.
+  void garbageCollect();
+  
+private:
+  // A node of the quadtree, covering a 2^level by 2^level square. Level 0 nodes are single cells with no children.
+  // Nodes are immutable apart from the memo and mark, and are shared between every place their pattern appears.
+  struct Node {
+    Node* nw; // the children, by compass direction; y grows southwards
+    Node* ne;
+    Node* sw;
+    Node* se;
+    Node* next; // memoized successor for the current step size, or nullptr
+    long long population;
+    unsigned int level;
+    bool marked; // reachable, during garbage collection
+  };
+  
+  // Hash-consing: nodes are identified by their children
+  struct NodeHash {
+    std::size_t operator()(const Node* node) const noexcept;
+  };
+  struct NodeEqual {
+    bool operator()(const Node* a, const Node* b) const noexcept;
+  };
+  
+  static constexpr unsigned int MIN_ROOT_LEVEL = 3;
+  static constexpr unsigned int MAX_LEVEL = 62;
+  static constexpr std::size_t DEFAULT_MAX_NODES = 1u << 22;
+  
+  Node* join(Node* nw, Node* ne, Node* sw, Node* se); // get the unique node with these children
+  Node* empty(unsigned int level); // get the empty node of this level
+  Node* expand(Node* node); // get the node one level up with node in its centre; throw if it would be too big
+  Node* centre(Node* node); // get the node one level down in the centre of node
+  static bool inInnerHalf(const Node* node); // is all of node's population in its central half?
+  
+  // Get the centre of node (one level down) advanced by 2^min(stepLog_, level - 2) generations, memoized.
+  Node* successor(Node* node);
+  Node* baseSuccessor(Node* node); // successor for a level 2 node, by hand
+  
+  Node* setCell(Node* node, long long x, long long y, bool value); // x and y relative to node's top-left
+  Node* build(unsigned int level, long long x, long long y, std::vector<Cell>::iterator begin,
+      std::vector<Cell>::iterator end); // build a node with top-left (x, y) from the live cells in [begin, end)
+  void forEachCell(const Node* node, long long x, long long y,
+      const std::function<void(long long, long long)>& action) const;
+  void forEachLeaf(const Node* node, long long x, long long y,
+      const std::function<void(long long, long long, std::uint64_t)>& action) const;
+  // Set the bits of cells for the live cells of node, of level 3 or less, at (x, y) in a leaf packed as by forEachLeaf.
+  static void leafCells(const Node* node, int x, int y, std::uint64_t& cells);
+  Node* merge(Node* a, Node* b); // get the node, of a's level, live wherever a or b is
+  static long long furthestExtent(const std::vector<Cell>& cells); // the smallest root half-size holding them all
+  // Write node and everything below it that isn't in indices yet as Macrocell lines, numbering them from count + 1.
+  // Return its number, or 0 if it's empty.
+  static std::size_t writeMacrocell(std::ostream& out, const Node* node,
+      std::unordered_map<const Node*, std::size_t>& indices, std::size_t& count);
+  static bool getCell(const Node* node, long long x, long long y); // x and y relative to node's top-left
+  
+  long long rootHalfSize() const noexcept; // the root covers [-rootHalfSize(), rootHalfSize()) in both x and y
+  void clearResults(); // forget every memoized successor
+  static void mark(Node* node);
+  
+  bool born_[9] = {}; // born_[i]: is a dead cell with i live neighbours born?
+  bool survives_[9] = {}; // survives_[i]: does a live cell with i live neighbours survive?
+  
+  Node dead_; // the two leaves
+  Node alive_;
+  std::unordered_set<Node*, NodeHash, NodeEqual> nodes_; // every non-leaf node; we own these
+  std::vector<Node*> emptyNodes_; // emptyNodes_[level] is the empty node of that level
+  
+  Node* root_;
+  unsigned int stepLog_ = 0; // the step size the memoized results are for
+  long long generation_ = 0;
+  unsigned long long cellsEvaluated_ = 0;
+  std::size_t maxNodes_ = DEFAULT_MAX_NODES;
+};
+
+#endif //GAME_OF_LIFE_HASHLIFE_H
@@ -0,0 +1,231 @@
+#include <stdexcept>
+
+#include "Kernel.h"
+#include "util.h"
+
+constexpr int SummedAreaKernel::MAX_RADIUS;
+
+// Kernel
+
+Kernel::Kernel(const Ruleset& ruleset, ChunkArray& chunkArray) : ruleset_(ruleset), chunkArray_(chunkArray) {}
+
+// NeighbourhoodKernel
+
+NeighbourhoodKernel::NeighbourhoodKernel(const Ruleset& ruleset, ChunkArray& chunkArray, Neighbourhood* neighbourhood)
+    : Kernel(ruleset, chunkArray), neighbourhood_(neighbourhood) {}
+
+void NeighbourhoodKernel::generate(Chunk& chunk) {
+  chunk.generate(ruleset_, *neighbourhood_);
+}
+
+void NeighbourhoodKernel::generate(Chunk& chunk, const Side& side, unsigned int affectingDistance) {
+  chunk.generate(ruleset_, *neighbourhood_, side, affectingDistance);
+}
+
+// RowKernel
+
+RowKernel::RowKernel(const Ruleset& ruleset, ChunkArray& chunkArray, int halo)
+    : Kernel(ruleset, chunkArray), halo_(halo) {}
+
+void RowKernel::generate(Chunk& chunk) {
+  generateRows(chunk, 0, CHUNK_SIZE, Chunk::ROW_MASK);
+}
+
+void RowKernel::generate(Chunk& chunk, const Side& side, unsigned int affectingDistance) {
+  // Only the band of cells within affectingDistance of the side, as in Chunk::generate's Side& version
+  int distance = affectingDistance < CHUNK_SIZE ? (int) affectingDistance : CHUNK_SIZE;
+  Chunk::Row band = (Chunk::Row(1) << distance) - 1;
+  switch (side) {
+    case Side::BOTTOM:
+    default:
+      generateRows(chunk, CHUNK_SIZE - distance, CHUNK_SIZE, Chunk::ROW_MASK);
+      break;
+    case Side::TOP:
+      generateRows(chunk, 0, distance, Chunk::ROW_MASK);
+      break;
+    case Side::LEFT:
+      generateRows(chunk, 0, CHUNK_SIZE, band);
+      break;
+    case Side::RIGHT:
+      generateRows(chunk, 0, CHUNK_SIZE, band << (CHUNK_SIZE - distance));
+      break;
+  }
+}
+
+void RowKernel::findNeighbours(const Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask,
+    Neighbours& neighbours) const {
+  // Only look up the neighbours we'll actually read from, so we don't queue chunks we'd never touch
+  Chunk::Row haloMask = (Chunk::Row(1) << halo_) - 1;
+  bool needTop = yBegin < halo_, needBottom = yEnd > CHUNK_SIZE - halo_;
+  bool needLeft = (columnMask & haloMask) != 0, needRight = (columnMask >> (CHUNK_SIZE - halo_) & haloMask) != 0;
+  
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      const Chunk*& neighbour = neighbours[1 + dy][1 + dx];
+      neighbour = nullptr;
+      if ((dy == -1 && !needTop) || (dy == 1 && !needBottom) || (dx == -1 && !needLeft) || (dx == 1 && !needRight)) {
+        continue;
+      }
+      
+      neighbour = chunk.neighbour(dx, dy);
+      if (neighbour == nullptr) {
+        // treated as empty, but insert it later like Neighbourhood::getCell
+        chunkArray_.queueForInsertion(chunk.chunkX + dx, chunk.chunkY + dy);
+      }
+    }
+  }
+}
+
+Chunk::Row RowKernel::paddedRow(const Neighbours& neighbours, int y) const noexcept {
+  int rowIndex = 1;
+  if (y < 0) {
+    rowIndex = 0;
+    y += CHUNK_SIZE;
+  } else if (y >= CHUNK_SIZE) {
+    rowIndex = 2;
+    y -= CHUNK_SIZE;
+  }
+  const Chunk* const* row = neighbours[rowIndex];
+  
+  // The rightmost halo_ cells of the left neighbour, the row itself, then the leftmost halo_ cells of the right one
+  Chunk::Row left = row[0] ? row[0]->row(y) >> (CHUNK_SIZE - halo_) : 0;
+  Chunk::Row centre = row[1] ? row[1]->row(y) : 0;
+  Chunk::Row right = row[2] ? row[2]->row(y) & ((Chunk::Row(1) << halo_) - 1) : 0;
+  return left | centre << halo_ | right << (CHUNK_SIZE + halo_);
+}
+
+// BitwiseMooreKernel
+
+BitwiseMooreKernel::BitwiseMooreKernel(const Ruleset& ruleset, ChunkArray& chunkArray)
+    : RowKernel(ruleset, chunkArray, 1) {
+  for (unsigned int count = 0; count <= 8; count++) {
+    born_[count] = ruleset.isBornWith(count);
+    survives_[count] = ruleset.survivesWith(count);
+  }
+}
+
+void BitwiseMooreKernel::generateRows(Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask) {
+  Neighbours neighbours;
+  findNeighbours(chunk, yBegin, yEnd, columnMask, neighbours);
+  
+  // With a halo of 1, the three cells above cell x are bits x, x + 1 and x + 2 of the padded row above
+  Chunk::Row above = paddedRow(neighbours, yBegin - 1), here = paddedRow(neighbours, yBegin);
+  for (int y = yBegin; y < yEnd; y++) {
+    Chunk::Row below = paddedRow(neighbours, y + 1);
+    
+    // Sum the eight neighbours of every cell at once into a four-bit count: ones, twos, fours, eights
+    Chunk::Row onesAbove, twosAbove, onesBelow, twosBelow;
+    fullAdd(above, above >> 1u, above >> 2u, onesAbove, twosAbove);
+    fullAdd(below, below >> 1u, below >> 2u, onesBelow, twosBelow);
+    Chunk::Row onesHere = here ^ here >> 2u, twosHere = here & here >> 2u;
+    
+    Chunk::Row ones, twosCarry;
+    fullAdd(onesAbove, onesBelow, onesHere, ones, twosCarry);
+    
+    Chunk::Row twosA = twosAbove ^ twosBelow, foursA = twosAbove & twosBelow;
+    Chunk::Row twosB = twosHere ^ twosCarry, foursB = twosHere & twosCarry;
+    Chunk::Row twos = twosA ^ twosB, foursC = twosA & twosB;
+    
+    Chunk::Row fours, eights;
+    fullAdd(foursA, foursB, foursC, fours, eights);
+    
+    // Apply the rules: select the cells with each relevant count and keep the ones which are born or survive
+    Chunk::Row alive = here >> 1u, next = 0;
+    for (unsigned int count = 0; count <= 8; count++) {
+      if (!born_[count] && !survives_[count]) continue;
+      Chunk::Row withCount = (count & 1u ? ones : ~ones) & (count & 2u ? twos : ~twos)
+          & (count & 4u ? fours : ~fours) & (count & 8u ? eights : ~eights);
+      next |= withCount & ((born_[count] ? ~alive : 0) | (survives_[count] ? alive : 0));
+    }
+    chunk.setNextRow(y, next, columnMask);
+    
+    above = here;
+    here = below;
+  }
+}
+
+// SummedAreaKernel
+
+SummedAreaKernel::SummedAreaKernel(const Ruleset& ruleset, ChunkArray& chunkArray, Shape shape, int radius)
+    : RowKernel(ruleset, chunkArray, radius), shape_(shape), radius_(radius), paddedSize_(CHUNK_SIZE + 2*radius) {
+  if (radius < 1 || radius > MAX_RADIUS) {
+    throw std::invalid_argument("SummedAreaKernel radius must be in [1, SummedAreaKernel::MAX_RADIUS]");
+  }
+  unsigned int numCells = shape == Shape::MOORE ? (2*radius + 1)*(2*radius + 1) - 1 : 2*radius*(radius + 1);
+  born_.resize(numCells + 1);
+  survives_.resize(numCells + 1);
+  for (unsigned int count = 0; count <= numCells; count++) {
+    born_[count] = ruleset.isBornWith(count);
+    survives_[count] = ruleset.survivesWith(count);
+  }
+}
+
+void SummedAreaKernel::generateRows(Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask) {
+  Neighbours neighbours;
+  findNeighbours(chunk, yBegin, yEnd, columnMask, neighbours);
+  buildTable(neighbours, yBegin, yEnd);
+  
+  for (int y = yBegin; y < yEnd; y++) {
+    Chunk::Row alive = chunk.row(y), next = 0;
+    int row = y - yBegin + radius_; // the cell's row in the table
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      if (!(columnMask >> x & 1u)) continue;
+      
+      // The square around the cell, or the square around it in the turned grid, then take away the centre cell
+      int column = x + radius_, count;
+      if (shape_ == Shape::MOORE) {
+        count = countIn(row - radius_, column - radius_, row + radius_ + 1, column + radius_ + 1);
+      } else {
+        int u = row + column, v = row - column + paddedSize_ - 1;
+        count = countIn(u - radius_, v - radius_, u + radius_ + 1, v + radius_ + 1);
+      }
+      bool isAlive = (alive >> x & 1u) != 0;
+      count -= isAlive;
+      
+      if (isAlive ? survives_[count] : born_[count]) {
+        next |= Chunk::Row(1) << x;
+      }
+    }
+    chunk.setNextRow(y, next, columnMask);
+  }
+}
+
+void SummedAreaKernel::buildTable(const Neighbours& neighbours, int yBegin, int yEnd) {
+  int rows = yEnd - yBegin + 2*radius_;
+  if (shape_ == Shape::MOORE) {
+    tableWidth_ = paddedSize_ + 1;
+    table_.assign((std::size_t) (rows + 1) * tableWidth_, 0);
+    for (int row = 0; row < rows; row++) {
+      Chunk::Row padded = paddedRow(neighbours, yBegin - radius_ + row);
+      const std::uint16_t* above = &table_[row * tableWidth_];
+      std::uint16_t* here = &table_[(row + 1) * tableWidth_];
+      int rowSum = 0;
+      for (int column = 0; column < paddedSize_; column++) {
+        rowSum += (int) (padded >> column & 1u);
+        here[column + 1] = (std::uint16_t) (above[column + 1] + rowSum);
+      }
+    }
+    return;
+  }
+  
+  // Turned, the cell at (column, row) is at (row + column, row - column + paddedSize_ - 1), so that both are
+  // non-negative. Put a 1 at each live cell, then sum them up in place.
+  int size = rows + paddedSize_ - 1;
+  tableWidth_ = size + 1;
+  table_.assign((std::size_t) (size + 1) * tableWidth_, 0);
+  for (int row = 0; row < rows; row++) {
+    for (Chunk::Row bits = paddedRow(neighbours, yBegin - radius_ + row); bits != 0; bits &= bits - 1) {
+      int column = countTrailingZeros(bits);
+      table_[(row + column + 1) * tableWidth_ + row - column + paddedSize_] = 1;
+    }
+  }
+  for (int i = 1; i <= size; i++) {
+    const std::uint16_t* above = &table_[(i - 1) * tableWidth_];
+    std::uint16_t* here = &table_[i * tableWidth_];
+    int rowSum = 0;
+    for (int j = 1; j <= size; j++) {
+      rowSum += here[j];
+      here[j] = (std::uint16_t) (above[j] + rowSum);
+    }
+  }
+}
@@ -0,0 +1,210 @@
+#ifndef GAME_OF_LIFE_KERNEL_H
+#define GAME_OF_LIFE_KERNEL_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Chunk.h"
+#include "Neighbourhood.h"
+#include "Ruleset.h"
+#include "Side.h"
+
+// A Kernel evaluates whole Chunks for one generation. Exactly one is made per tick, by
+// NeighbourhoodType::makeKernel(const Ruleset&, ChunkArray&), so the choice of algorithm for the neighbourhood type and
+// radius is made once per tick and not once per cell. Like Neighbourhood, a Kernel must be destroyed before the
+// ChunkArray and Ruleset it was made with, and must not outlive a change to the Ruleset.
+class Kernel {
+public:
+  // Evaluate all the cells in the Chunk and prime it to update, like Chunk::generate(const Ruleset&, Neighbourhood&).
+  virtual void generate(Chunk& chunk) = 0;
+  
+  // Evaluate only the cells within affectingDistance of side, like the Side& version of Chunk::generate.
+  virtual void generate(Chunk& chunk, const Side& side, unsigned int affectingDistance) = 0;
+  
+  virtual ~Kernel() = default;
+  
+protected:
+  Kernel(const Ruleset& ruleset, ChunkArray& chunkArray);
+  
+  const Ruleset& ruleset_;
+  ChunkArray& chunkArray_;
+};
+
+// The fallback Kernel for neighbourhoods without a specialized kernel: it walks a Neighbourhood over each Chunk.
+class NeighbourhoodKernel : public Kernel {
+public:
+  // Take ownership of the neighbourhood, which must have been made for chunkArray.
+  NeighbourhoodKernel(const Ruleset& ruleset, ChunkArray& chunkArray, Neighbourhood* neighbourhood);
+  
+  void generate(Chunk& chunk) override;
+  void generate(Chunk& chunk, const Side& side, unsigned int affectingDistance) override;
+  
+private:
+  std::unique_ptr<Neighbourhood> neighbourhood_;
+};
+
+// An abstract Kernel which evaluates a band of whole rows at once, reading the neighbouring chunks' edges directly.
+// Subclasses implement RowKernel::generateRows; sides are translated into bands of rows or columns here.
+class RowKernel : public Kernel {
+public:
+  void generate(Chunk& chunk) override;
+  void generate(Chunk& chunk, const Side& side, unsigned int affectingDistance) override;
+  
+protected:
+  // Initialize the RowKernel, which reads up to halo cells past each edge of a Chunk.
+  RowKernel(const Ruleset& ruleset, ChunkArray& chunkArray, int halo);
+  
+  // The neighbours of a Chunk: neighbours[1 + dy][1 + dx] is the chunk at (chunkX + dx, chunkY + dy), and
+  // nullptr is treated as an empty chunk.
+  typedef const Chunk* Neighbours[3][3];
+  
+  // Evaluate the cells of chunk in rows [yBegin, yEnd) whose columns are set in columnMask.
+  virtual void generateRows(Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask) = 0;
+  
+  // Find the neighbours which evaluating rows [yBegin, yEnd) and columnMask reads from, using the chunk's neighbour
+  // links. Missing ones are queued for insertion, as in Neighbourhood::getCell, and left as nullptr, as are those
+  // which aren't needed.
+  void findNeighbours(const Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask, Neighbours& neighbours) const;
+  
+  // Get row y (-halo <= y < CHUNK_SIZE + halo) with halo cells of each neighbour on either side, so that the cell
+  // at x is bit x + halo.
+  Chunk::Row paddedRow(const Neighbours& neighbours, int y) const noexcept;
+  
+  const int halo_;
+};
+
+// Evaluates totalistic Moore radius-1 rulesets a whole row at a time, summing each cell's neighbours with bitwise
+// full adders over the packed rows.
+class BitwiseMooreKernel : public RowKernel {
+public:
+  BitwiseMooreKernel(const Ruleset& ruleset, ChunkArray& chunkArray);
+  
+protected:
+  void generateRows(Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask) override;
+  
+private:
+  bool born_[9]; // born_[i]: is a dead cell with i live neighbours born? Copied from the ruleset
+  bool survives_[9]; // survives_[i]: does a live cell with i live neighbours survive?
+};
+
+// The shapes of neighbourhoods for CountingKernel, describing how far a neighbourhood extends in each row.
+struct MooreShape {
+  static constexpr int numCells(int radius) { return (2*radius + 1)*(2*radius + 1) - 1; }
+  static constexpr int halfWidth(int radius, int) { return radius; }
+};
+
+struct VonNeumannShape {
+  static constexpr int numCells(int radius) { return 2*radius*(radius + 1); }
+  static constexpr int halfWidth(int radius, int dy) { return radius - (dy < 0 ? -dy : dy); }
+};
+
+// Evaluates a neighbourhood of a fixed Shape and Radius by counting from per-row prefix sums over the Chunk and its
+// halo. Since the shape and radius are compile-time constants, the counting loops have constant bounds and there are
+// no virtual calls or checks per cell.
+template<typename Shape, int Radius>
+class CountingKernel : public RowKernel {
+  static_assert(Radius > 0 && Radius < CHUNK_SIZE, "CountingKernel radius must be in [1, CHUNK_SIZE)");
+  static_assert(CHUNK_SIZE + 2*Radius <= 64, "CountingKernel can't pack a row and its halo into a Chunk::Row");
+  
+  static constexpr int NUM_CELLS = Shape::numCells(Radius);
+  static constexpr int PADDED_SIZE = CHUNK_SIZE + 2*Radius;
+  
+public:
+  CountingKernel(const Ruleset& ruleset, ChunkArray& chunkArray) : RowKernel(ruleset, chunkArray, Radius) {
+    for (unsigned int count = 0; count <= NUM_CELLS; count++) {
+      born_[count] = ruleset.isBornWith(count);
+      survives_[count] = ruleset.survivesWith(count);
+    }
+  }
+  
+protected:
+  void generateRows(Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask) override {
+    Neighbours neighbours;
+    findNeighbours(chunk, yBegin, yEnd, columnMask, neighbours);
+    
+    // rowSums[Radius + y][i] is the number of live cells in row y of the padded chunk before padded column i
+    unsigned char rowSums[PADDED_SIZE][PADDED_SIZE + 1];
+    for (int y = yBegin - Radius; y < yEnd + Radius; y++) {
+      Chunk::Row padded = paddedRow(neighbours, y);
+      unsigned char* sums = rowSums[Radius + y];
+      sums[0] = 0;
+      for (int i = 0; i < PADDED_SIZE; i++) {
+        sums[i + 1] = (unsigned char) (sums[i] + (padded >> i & 1u));
+      }
+    }
+    
+    for (int y = yBegin; y < yEnd; y++) {
+      Chunk::Row alive = chunk.row(y), next = 0;
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        if (!(columnMask >> x & 1u)) continue;
+        
+        // Add up the run of the neighbourhood in each row, then take away the centre cell
+        int count = 0;
+        for (int dy = -Radius; dy <= Radius; dy++) {
+          const unsigned char* sums = rowSums[Radius + y + dy];
+          int halfWidth = Shape::halfWidth(Radius, dy);
+          count += sums[Radius + x + halfWidth + 1] - sums[Radius + x - halfWidth];
+        }
+        bool isAlive = (alive >> x & 1u) != 0;
+        count -= isAlive;
+        
+        if (isAlive ? survives_[count] : born_[count]) {
+          next |= Chunk::Row(1) << x;
+        }
+      }
+      chunk.setNextRow(y, next, columnMask);
+    }
+  }
+  
+private:
+  std::array<bool, NUM_CELLS + 1> born_; // born_[i]: is a dead cell with i live neighbours born?
+  std::array<bool, NUM_CELLS + 1> survives_; // survives_[i]: does a live cell with i live neighbours survive?
+};
+
+// Evaluates Moore and von Neumann neighbourhoods of any radius the halo can hold in constant time per cell, however
+// large the radius, from a summed-area table over the rows being evaluated and their halo: the live cells in any
+// rectangle of the table are four lookups. A Moore neighbourhood is a square, so its table is over the grid itself. A
+// von Neumann neighbourhood is a diamond, which turned 45 degrees is a square too, so its table is over the turned
+// grid, where the cell at (x, y) is at (x + y, x - y) and the points between cells are empty.
+// Building a table costs about as much as evaluating a cell per entry, which is why the smallest radii are left to
+// CountingKernel, which goes through each row of the neighbourhood instead.
+class SummedAreaKernel : public RowKernel {
+public:
+  // Whether it counts squares (Moore) or diamonds (von Neumann).
+  enum class Shape {
+    MOORE, VON_NEUMANN
+  };
+  
+  // The largest radius there's a halo for: the neighbours' rows have to reach it, and fit in a Chunk::Row with it.
+  static constexpr int MAX_RADIUS = CHUNK_SIZE < (64 - CHUNK_SIZE) / 2 ? CHUNK_SIZE : (64 - CHUNK_SIZE) / 2;
+  
+  // Throw std::invalid_argument if radius isn't in [1, MAX_RADIUS].
+  SummedAreaKernel(const Ruleset& ruleset, ChunkArray& chunkArray, Shape shape, int radius);
+  
+protected:
+  void generateRows(Chunk& chunk, int yBegin, int yEnd, Chunk::Row columnMask) override;
+  
+private:
+  // Fill table_ with the summed-area table of the padded rows [yBegin - radius_, yEnd + radius_), turned 45 degrees
+  // if the shape is a diamond. Entry (i, j) of the table, at table_[i * tableWidth_ + j], is the number of live cells
+  // in rows (or turned rows) before i and columns before j.
+  void buildTable(const Neighbours& neighbours, int yBegin, int yEnd);
+  
+  // Get the number of live cells in rows [top, bottom) and columns [left, right) of the table.
+  int countIn(int top, int left, int bottom, int right) const noexcept {
+    return table_[bottom * tableWidth_ + right] - table_[top * tableWidth_ + right]
+        - table_[bottom * tableWidth_ + left] + table_[top * tableWidth_ + left];
+  }
+  
+  const Shape shape_;
+  const int radius_;
+  const int paddedSize_; // CHUNK_SIZE + 2 * radius_: the width of a padded row
+  std::vector<char> born_; // born_[i]: is a dead cell with i live neighbours born? Copied from the ruleset
+  std::vector<char> survives_; // survives_[i]: does a live cell with i live neighbours survive?
+  std::vector<std::uint16_t> table_; // kept between calls so it isn't reallocated for every chunk
+  int tableWidth_ = 0; // entries per row of table_
+};
+
+#endif //GAME_OF_LIFE_KERNEL_H
@@ -1,6 +1,8 @@
 #include <stdexcept>
+#include <string>
 
 #include "Chunk.h"
+#include "Kernel.h"
 #include "Neighbourhood.h"
 
 // I sincerely apologize, future self, for all the DRY violations.
@@ -18,6 +20,7 @@ void Neighbourhood::moveTo(int chunkX, int chunkY, int x, int y) {
   y_ = y;
   chunkX_ = chunkX;
   chunkY_ = chunkY;
+  chunk_ = &chunkArray_.at(chunkX, chunkY);
   ready_ = true;
   reinitialize();
 }
@@ -118,7 +121,8 @@ void Neighbourhood::moveToSide(const Side& side) {
 
 // Initialize the chunk array, but set ready_ to false
 Neighbourhood::Neighbourhood(ChunkArray& chunkArray)
-  : chunkArray_(chunkArray), x_(0), y_(0), chunkX_(0), chunkY_(0), liveCount_(0), ready_(false) {}
+  : chunkArray_(chunkArray), x_(0), y_(0), chunkX_(0), chunkY_(0), chunk_(nullptr), liveCount_(0),
+    ready_(false) {}
 
 void Neighbourhood::verifyReady() const {
   if (!ready_) {
@@ -160,12 +164,19 @@ bool Neighbourhood::getCell(int dx, int dy) const {
     ny %= CHUNK_SIZE;
   }
   
-  if (chunkArray_.contains(ncx, ncy)) {
+  // The adjacent chunks are linked directly; anything further away (only for huge radii) has to be looked up
+  int dcx = ncx - chunkX_, dcy = ncy - chunkY_;
+  if (dcx >= -1 && dcx <= 1 && dcy >= -1 && dcy <= 1) {
+    const Chunk* chunk = chunk_->neighbour(dcx, dcy);
+    if (chunk != nullptr) {
+      return chunk->getCell(nx, ny);
+    }
+  } else if (chunkArray_.contains(ncx, ncy)) {
     return chunkArray_.at(ncx, ncy).getCell(nx, ny);
-  } else {
-    chunkArray_.queueForInsertion(ncx, ncy); // insert it later so we don't process it this time
-    return false; // default is empty - TODO this is specified both here and when EMPTY is returned in ChunkArray
   }
+  
+  chunkArray_.queueForInsertion(ncx, ncy); // insert it later so we don't process it this time
+  return false; // default is empty - TODO this is specified both here and when EMPTY is returned in ChunkArray
 }
 
 // NeighbourhoodType
@@ -185,11 +196,16 @@ int NeighbourhoodType::getRadius() const noexcept {
   return radius_;
 }
 
+Kernel* NeighbourhoodType::makeKernel(const Ruleset& ruleset, ChunkArray& chunkArray) const {
+  return new NeighbourhoodKernel(ruleset, chunkArray, makeNeighbourhood(chunkArray));
+}
+
 // Helper function for error checking
 namespace { // local to this file
   void checkRadius(int radius) {
-    if (radius <= 0) {
-      throw std::invalid_argument("Radius of neighbourhood must be positive");
+    if (radius <= 0 || radius > SummedAreaKernel::MAX_RADIUS) {
+      throw std::invalid_argument("Radius of neighbourhood must be from 1 to "
+          + std::to_string(SummedAreaKernel::MAX_RADIUS));
     }
   }
 }
@@ -206,6 +222,19 @@ Neighbourhood* MooreNeighbourhoodType::makeNeighbourhood(ChunkArray& chunkArray)
   return new MooreNeighbourhood(chunkArray, radius_);
 }
 
+Kernel* MooreNeighbourhoodType::makeKernel(const Ruleset& ruleset, ChunkArray& chunkArray) const {
+  switch (radius_) {
+    case 1:
+      return new BitwiseMooreKernel(ruleset, chunkArray);
+    case 2:
+      return new CountingKernel<MooreShape, 2>(ruleset, chunkArray);
+    case 3:
+      return new CountingKernel<MooreShape, 3>(ruleset, chunkArray);
+    default:
+      return new SummedAreaKernel(ruleset, chunkArray, SummedAreaKernel::Shape::MOORE, radius_);
+  }
+}
+
 MooreNeighbourhoodType* MooreNeighbourhoodType::clone() const {
   return new MooreNeighbourhoodType(*this);
 }
@@ -274,6 +303,19 @@ Neighbourhood* VonNeumannNeighbourhoodType::makeNeighbourhood(ChunkArray& chunkA
   return new VonNeumannNeighbourhood(chunkArray, radius_);
 }
 
+Kernel* VonNeumannNeighbourhoodType::makeKernel(const Ruleset& ruleset, ChunkArray& chunkArray) const {
+  switch (radius_) {
+    case 1:
+      return new CountingKernel<VonNeumannShape, 1>(ruleset, chunkArray);
+    case 2:
+      return new CountingKernel<VonNeumannShape, 2>(ruleset, chunkArray);
+    case 3:
+      return new CountingKernel<VonNeumannShape, 3>(ruleset, chunkArray);
+    default:
+      return new SummedAreaKernel(ruleset, chunkArray, SummedAreaKernel::Shape::VON_NEUMANN, radius_);
+  }
+}
+
 VonNeumannNeighbourhoodType* VonNeumannNeighbourhoodType::clone() const {
   return new VonNeumannNeighbourhoodType(*this);
 }
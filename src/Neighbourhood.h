@@ -5,7 +5,10 @@
 
 // we only have references to ChunkArray so it's safe to forward declare it without including Chunk.h
 // this resolves a circular dependency chain: Neighbourhood->ChunkArray->Chunk->Neighbourhood
+class Chunk;
 class ChunkArray;
+class Kernel;
+class Ruleset;
 
 // This is an abstract base class representing the neighbourhood of a cell. Neighbourhoods can be moved around a
 // ChunkArray in order to save time. One Neighbourhood is created for each generation. Note that after creating a
@@ -68,13 +71,15 @@ protected:
   virtual void translateDown() = 0;
   virtual void translateUp() = 0;
   
-  // Get the value of a cell by its offset from (x_, y_).
+  // Get the value of a cell by its offset from (x_, y_). Cells in the adjacent chunks are found through chunk_'s
+  // neighbour links rather than by looking them up in the ChunkArray.
   bool getCell(int dx, int dy) const;
   
   int x_;
   int y_;
   int chunkX_;
   int chunkY_;
+  const Chunk* chunk_; // the Chunk at (chunkX_, chunkY_)
   unsigned int liveCount_;
   ChunkArray& chunkArray_;
   
@@ -91,6 +96,12 @@ public:
   // Neighbourhood must be destroyed before the ChunkArray passed here - otherwise, the Neighbourhood will error.
   virtual Neighbourhood* makeNeighbourhood(ChunkArray& chunkArray) const = 0;
   
+  // Create the Kernel which evaluates whole Chunks for this neighbourhood type with the given ruleset, for one tick.
+  // Caller is responsible for managing the pointer, which must be destroyed before the ruleset and chunkArray. By
+  // default, this is a NeighbourhoodKernel walking a Neighbourhood from makeNeighbourhood(ChunkArray&); subclasses
+  // return faster specialized kernels where they have them.
+  virtual Kernel* makeKernel(const Ruleset& ruleset, ChunkArray& chunkArray) const;
+  
   // Get the total number of cells in Neighbourhoods of this type.
   unsigned int getNumCells() const noexcept;
   
@@ -124,13 +135,17 @@ class MooreNeighbourhood; // forward declaration for MooreNeighbourhoodType
 class MooreNeighbourhoodType : public NeighbourhoodType {
 public:
   // Initialize a MooreNeighbourhoodType creating neighbourhoods with the specified radius.
-  // Throw std::invalid_argument if radius is not positive.
+  // Throw std::invalid_argument if radius is not in [1, SummedAreaKernel::MAX_RADIUS].
   explicit MooreNeighbourhoodType(int radius);
   
   // Make a MooreNeighbourhood with the radius specified in the constructor.
   // (It's not covariant because of compiler weirdness, and we'll never use covariance anyways.)
   Neighbourhood* makeNeighbourhood(ChunkArray& chunkArray) const override;
   
+  // Make a BitwiseMooreKernel for radius 1, a CountingKernel for radii 2 and 3, or a SummedAreaKernel for larger
+  // radii.
+  Kernel* makeKernel(const Ruleset& ruleset, ChunkArray& chunkArray) const override;
+  
   MooreNeighbourhoodType* clone() const override;
 };
 
@@ -167,12 +182,15 @@ class VonNeumannNeighbourhood; // forward declaration for VonNeumannNeighbourhoo
 class VonNeumannNeighbourhoodType : public NeighbourhoodType {
 public:
   // Initialize the VonNeumannNeighbourhoodType creating neighbourhoods with the specified radius.
-  // Throw std::invalid_argument if the radius is negative or zero.
+  // Throw std::invalid_argument if the radius is not in [1, SummedAreaKernel::MAX_RADIUS].
   explicit VonNeumannNeighbourhoodType(int radius);
   
   // Make a VonNeumannNeighbourhood with the radius specified in the constructor.
   Neighbourhood* makeNeighbourhood(ChunkArray& chunkArray) const override;
   
+  // Make a CountingKernel for radii 1 to 3, or a SummedAreaKernel for larger radii.
+  Kernel* makeKernel(const Ruleset& ruleset, ChunkArray& chunkArray) const override;
+  
   VonNeumannNeighbourhoodType* clone() const override;
 };
 
@@ -1,6 +1,6 @@
 #include <QPushButton>
 
-#include "Chunk.h"
+#include "Kernel.h"
 #include "NeighbourhoodDialog.h"
 #include "ui_neighbourhooddialog.h"
 
@@ -11,7 +11,7 @@ NeighbourhoodDialog::NeighbourhoodDialog(NeighbourhoodType& current, Automaton*
   ui_->setupUi(this);
   window()->setFixedSize(window()->width(), window()->height());
   
-  ui_->radiusSpinbox->setMaximum(CHUNK_SIZE-1); // above this probably won't work
+  ui_->radiusSpinbox->setMaximum(SummedAreaKernel::MAX_RADIUS); // the kernels can't reach further than this
   
   // make the radio buttons mutually exclusive
   typeGroup_->addButton(ui_->mooreButton);
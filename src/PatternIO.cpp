@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HashLife.h"
+#include "PatternIO.h"
+#include "util.h"
+
+constexpr std::string::size_type PatternIO::RLE_LINE_LENGTH;
+
+namespace { // local to this file
+  // Gathers live cells into rows of chunks and hands each one to Automaton::addLiveCells when the cells move on to
+  // another, so a run of cells costs one call per chunk it crosses instead of one per cell.
+  class RowSink {
+  public:
+    explicit RowSink(Automaton& automaton) : automaton_(automaton) {}
+    
+    // Make the length cells from (x, y) eastwards live.
+    void addRun(long long x, long long y, long long length) {
+      long long chunkY = floorDiv<long long>(y, CHUNK_SIZE);
+      int row = (int) (y - chunkY * CHUNK_SIZE);
+      while (length > 0) {
+        long long chunkX = floorDiv<long long>(x, CHUNK_SIZE);
+        int cellX = (int) (x - chunkX * CHUNK_SIZE);
+        long long count = std::min<long long>(length, CHUNK_SIZE - cellX);
+        add(chunkX, chunkY, row, ((Chunk::Row(1) << count) - 1) << cellX);
+        x += count;
+        length -= count;
+      }
+    }
+    
+    // Hand over the row being gathered, if there is one.
+    void flush() {
+      if (pending_) {
+        pending_ = false;
+        automaton_.addLiveCells(chunkX_, chunkY_, row_, bits_);
+      }
+    }
+  
+  private:
+    void add(long long chunkX, long long chunkY, int row, Chunk::Row bits) {
+      if (chunkX < INT_MIN || chunkX > INT_MAX || chunkY < INT_MIN || chunkY > INT_MAX) {
+        throw std::out_of_range("Cannot read a pattern cell this far from the origin");
+      }
+      if (pending_ && chunkX == chunkX_ && chunkY == chunkY_ && row == row_) {
+        bits_ |= bits;
+        return;
+      }
+      flush();
+      pending_ = true;
+      chunkX_ = (int) chunkX;
+      chunkY_ = (int) chunkY;
+      row_ = row;
+      bits_ = bits;
+    }
+    
+    Automaton& automaton_;
+    bool pending_ = false; // is there a row being gathered?
+    int chunkX_ = 0, chunkY_ = 0, row_ = 0; // where it is
+    Chunk::Row bits_ = 0;
+  };
+  
+  // Read a line, without any carriage return Windows left on the end.
+  bool nextLine(std::istream& in, std::string& line) {
+    if (!std::getline(in, line)) {
+      return false;
+    }
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    return true;
+  }
+  
+  bool isBlank(const std::string& line) {
+    return std::all_of(line.begin(), line.end(), [] (char c) { return isspace((unsigned char) c) != 0; });
+  }
+  
+  bool startsWith(const std::string& string, const char* prefix) {
+    return string.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+  }
+  
+  // Get the text after the first '=' at or after start, without spaces, up to the next ',' or ':' (after which Golly
+  // puts the topology).
+  std::string valueAfter(const std::string& line, std::string::size_type start) {
+    std::string value;
+    std::string::size_type equals = line.find('=', start);
+    if (equals == std::string::npos) {
+      return value;
+    }
+    for (char c : line.substr(equals + 1)) {
+      if (c == ',' || c == ':') break;
+      if (!isspace((unsigned char) c)) value += c;
+    }
+    return value;
+  }
+  
+  // Get a rule string in B/S notation. Older patterns give their rules as survive counts, then born counts, with no
+  // letters, like 23/3 for Life; those are turned around. Anything else is left as it is, for Ruleset::setRules to
+  // judge.
+  std::string toBSNotation(const std::string& rule) {
+    std::string::size_type slash = rule.find('/');
+    bool digitsAndSlash = slash != std::string::npos && rule.find('/', slash + 1) == std::string::npos
+        && std::all_of(rule.begin(), rule.end(), [] (char c) { return c == '/' || isdigit((unsigned char) c); });
+    if (!digitsAndSlash) {
+      return rule;
+    }
+    return "B" + rule.substr(slash + 1) + "/S" + rule.substr(0, slash);
+  }
+  
+  // Parse a whole number starting at text, moving text past it. Throw std::invalid_argument if there isn't one.
+  long long parseNumber(const char*& text) {
+    char* end;
+    long long number = std::strtoll(text, &end, 10);
+    if (end == text) {
+      throw std::invalid_argument("Expected a number in the pattern");
+    }
+    text = end;
+    return number;
+  }
+  
+  // RLE: a header, then rows of cells as runs like 3o (three live), 2b (two dead) and $ (next row), up to a !
+  
+  // Takes the cells of an RLE pattern a character at a time.
+  class RLEBody {
+  public:
+    RLEBody(RowSink& sink, long long x, long long y) : sink_(sink), left_(x), x_(x), y_(y) {}
+    
+    // Take the next character. Return false if it was the end of the pattern.
+    bool feed(char c) {
+      if (isdigit((unsigned char) c)) {
+        run_ = run_ * 10 + (c - '0');
+        if (run_ > INT_MAX) {
+          throw std::invalid_argument("RLE run is too long");
+        }
+        return true;
+      }
+      long long count = run_ == 0 ? 1 : run_;
+      run_ = 0;
+      if (c == 'b' || c == '.') {
+        x_ += count;
+      } else if (c == '$') {
+        x_ = left_;
+        y_ += count;
+      } else if (c == '!') {
+        return false;
+      } else if (isalpha((unsigned char) c)) { // o, or any state of a multi-state rule, is alive
+        sink_.addRun(x_, y_, count);
+        x_ += count;
+      } else if (!isspace((unsigned char) c)) {
+        throw std::invalid_argument(std::string("Unexpected character in RLE pattern: ") + c);
+      }
+      return true;
+    }
+  
+  private:
+    RowSink& sink_;
+    long long run_ = 0; // the count being read, or 0 if there isn't one
+    long long left_; // where rows start
+    long long x_, y_; // the next cell
+  };
+  
+  std::string readRLE(std::istream& in, std::string line, RowSink& sink, long long x, long long y) {
+    // Comments and the header line come first; the cells start on the first line which is neither
+    std::string rule;
+    do {
+      if (isBlank(line)) continue;
+      if (startsWith(line, "#CXRLE")) {
+        std::string::size_type pos = line.find("Pos=");
+        if (pos != std::string::npos) {
+          const char* text = line.c_str() + pos + 4;
+          x += parseNumber(text);
+          if (*text++ != ',') {
+            throw std::invalid_argument("Malformed #CXRLE position in RLE pattern");
+          }
+          y += parseNumber(text);
+        }
+      } else if (startsWith(line, "#r")) {
+        rule = line.substr(2);
+        rule.erase(std::remove_if(rule.begin(), rule.end(), [] (char c) { return isspace((unsigned char) c); }),
+            rule.end());
+      } else if (line[0] == 'x') {
+        std::string::size_type ruleStart = line.find("rule");
+        if (ruleStart != std::string::npos) {
+          rule = valueAfter(line, ruleStart);
+        }
+        line.clear(); // the cells start on the next line
+        break;
+      } else if (line[0] != '#') {
+        break; // no header, but we'll take it
+      }
+    } while (nextLine(in, line));
+    
+    RLEBody body(sink, x, y);
+    for (char c : line) {
+      if (!body.feed(c)) return rule;
+    }
+    char c;
+    while (in.get(c)) {
+      if (!body.feed(c)) return rule;
+    }
+    return rule; // no !, but close enough
+  }
+  
+  // Life 1.06: a line per live cell, "x y"
+  
+  void readLife106(std::istream& in, RowSink& sink, long long x, long long y) {
+    std::string line;
+    while (nextLine(in, line)) {
+      if (isBlank(line) || line[0] == '#') continue;
+      const char* text = line.c_str();
+      long long cellX = parseNumber(text);
+      long long cellY = parseNumber(text);
+      while (isspace((unsigned char) *text)) text++;
+      if (*text != '\0') {
+        throw std::invalid_argument("Unexpected text after a cell in Life 1.06 pattern: " + line);
+      }
+      sink.addRun(x + cellX, y + cellY, 1);
+    }
+  }
+  
+  // Macrocell: a quadtree, a node per line, each after its children, with the root last. Leaves are 8x8 blocks of
+  // cells, written as rows of . and * ended by $; the rest are "level nw ne sw se", numbering nodes from 1 in the
+  // order they come and 0 for an empty one.
+  
+  struct MacrocellNode {
+    unsigned int level; // 3 for a leaf
+    std::size_t children[4]; // nw, ne, sw, se
+    std::uint64_t leaf; // bit 8*y + x is the cell at (x, y)
+  };
+  
+  constexpr unsigned int MACROCELL_LEAF_LEVEL = 3;
+  constexpr unsigned int MACROCELL_MAX_LEVEL = 62; // any bigger and the coordinates don't fit in a long long
+  
+  MacrocellNode parseMacrocellLeaf(const std::string& line) {
+    MacrocellNode node{MACROCELL_LEAF_LEVEL, {0, 0, 0, 0}, 0};
+    int x = 0, y = 0;
+    for (char c : line) {
+      if (c == '$') {
+        x = 0;
+        y++;
+      } else if (c == '.' || c == '*') {
+        if (x >= 8 || y >= 8) {
+          throw std::invalid_argument("Macrocell leaf is bigger than 8x8: " + line);
+        }
+        if (c == '*') {
+          node.leaf |= std::uint64_t(1) << (8 * y + x);
+        }
+        x++;
+      } else if (!isspace((unsigned char) c)) {
+        throw std::invalid_argument("Unexpected character in Macrocell leaf: " + line);
+      }
+    }
+    return node;
+  }
+  
+  MacrocellNode parseMacrocellNode(const std::string& line, const std::vector<MacrocellNode>& nodes) {
+    const char* text = line.c_str();
+    MacrocellNode node{0, {0, 0, 0, 0}, 0};
+    long long level = parseNumber(text);
+    if (level <= MACROCELL_LEAF_LEVEL || level > MACROCELL_MAX_LEVEL) {
+      throw std::invalid_argument("Macrocell node has an unsupported level (multi-state patterns aren't supported): "
+          + line);
+    }
+    node.level = (unsigned int) level;
+    for (std::size_t& child : node.children) {
+      long long index = parseNumber(text);
+      if (index < 0 || index > (long long) nodes.size()) {
+        throw std::invalid_argument("Macrocell node refers to a node which doesn't come before it: " + line);
+      }
+      if (index > 0 && nodes[index - 1].level != node.level - 1) {
+        throw std::invalid_argument("Macrocell node has a child of the wrong level: " + line);
+      }
+      child = (std::size_t) index;
+    }
+    return node;
+  }
+  
+  // Add the cells of node number index, of the given level, with its top-left at (x, y).
+  void placeMacrocellNode(const std::vector<MacrocellNode>& nodes, std::size_t index, long long x, long long y,
+      RowSink& sink) {
+    if (index == 0) {
+      return;
+    }
+    const MacrocellNode& node = nodes[index - 1];
+    if (node.level == MACROCELL_LEAF_LEVEL) {
+      for (int row = 0; row < 8; row++) {
+        std::uint64_t bits = node.leaf >> (8 * row) & 0xFFu;
+        while (bits != 0) {
+          int start = countTrailingZeros(bits);
+          int length = countTrailingZeros(~(bits >> start));
+          sink.addRun(x + start, y + row, length);
+          bits &= ~(((std::uint64_t(1) << length) - 1) << start);
+        }
+      }
+      return;
+    }
+    long long half = 1LL << (node.level - 1);
+    placeMacrocellNode(nodes, node.children[0], x, y, sink);
+    placeMacrocellNode(nodes, node.children[1], x + half, y, sink);
+    placeMacrocellNode(nodes, node.children[2], x, y + half, sink);
+    placeMacrocellNode(nodes, node.children[3], x + half, y + half, sink);
+  }
+  
+  std::string readMacrocell(std::istream& in, RowSink& sink, long long x, long long y) {
+    std::string line, rule;
+    std::vector<MacrocellNode> nodes;
+    while (nextLine(in, line)) {
+      if (isBlank(line)) continue;
+      if (line[0] == '#') {
+        if (startsWith(line, "#R")) {
+          rule = line.substr(2);
+          rule.erase(std::remove_if(rule.begin(), rule.end(), [] (char c) { return isspace((unsigned char) c); }),
+              rule.end());
+        }
+        continue;
+      }
+      nodes.push_back(isdigit((unsigned char) line[0]) ? parseMacrocellNode(line, nodes) : parseMacrocellLeaf(line));
+    }
+    
+    if (!nodes.empty()) {
+      // The root is centred on the origin
+      long long half = 1LL << (nodes.back().level - 1);
+      placeMacrocellNode(nodes, nodes.size(), x - half, y - half, sink);
+    }
+    return rule;
+  }
+  
+  // Writing
+  
+  // Get the non-empty chunks in rows, north to south, each west to east.
+  std::vector<const Chunk*> sortedChunks(Automaton& automaton) {
+    std::vector<const Chunk*> chunks;
+    for (auto& entry : automaton.chunkArray()) {
+      if (!entry.value->isEmpty()) {
+        chunks.push_back(entry.value);
+      }
+    }
+    std::sort(chunks.begin(), chunks.end(), [] (const Chunk* a, const Chunk* b) {
+      return a->chunkY != b->chunkY ? a->chunkY < b->chunkY : a->chunkX < b->chunkX;
+    });
+    return chunks;
+  }
+  
+  // Call action(x, y, length) for each run of live cells in chunks, as sorted by sortedChunks, row by row from north to
+  // south and west to east along each. A run crossing into the next chunk comes as two.
+  template<typename Action>
+  void forEachRun(const std::vector<const Chunk*>& chunks, Action action) {
+    for (std::size_t bandStart = 0; bandStart < chunks.size();) {
+      // A band of chunks with the same y
+      std::size_t bandEnd = bandStart;
+      while (bandEnd < chunks.size() && chunks[bandEnd]->chunkY == chunks[bandStart]->chunkY) {
+        bandEnd++;
+      }
+      for (int row = 0; row < CHUNK_SIZE; row++) {
+        long long y = (long long) chunks[bandStart]->chunkY * CHUNK_SIZE + row;
+        for (std::size_t i = bandStart; i < bandEnd; i++) {
+          std::uint64_t bits = chunks[i]->row(row);
+          while (bits != 0) {
+            int start = countTrailingZeros(bits);
+            int length = countTrailingZeros(~(bits >> start));
+            action((long long) chunks[i]->chunkX * CHUNK_SIZE + start, y, length);
+            bits &= ~(((std::uint64_t(1) << length) - 1) << start);
+          }
+        }
+      }
+      bandStart = bandEnd;
+    }
+  }
+  
+  // Writes RLE tokens, keeping lines to PatternIO::RLE_LINE_LENGTH.
+  class RLETokens {
+  public:
+    explicit RLETokens(std::ostream& out) : out_(out) {}
+    
+    void write(long long count, char tag) {
+      std::string token = (count > 1 ? std::to_string(count) : std::string()) + tag;
+      if (lineLength_ + token.size() > PatternIO::RLE_LINE_LENGTH) {
+        out_ << '\n';
+        lineLength_ = 0;
+      }
+      out_ << token;
+      lineLength_ += token.size();
+    }
+  
+  private:
+    std::ostream& out_;
+    std::string::size_type lineLength_ = 0;
+  };
+  
+  void writeRLE(std::ostream& out, Automaton& automaton) {
+    std::vector<const Chunk*> chunks = sortedChunks(automaton);
+    std::string rule = automaton.ruleset().getRuleString();
+    if (chunks.empty()) {
+      out << "x = 0, y = 0, rule = " << rule << "\n!\n";
+      return;
+    }
+    
+    // The bounding box, from each chunk's rows
+    long long minX = LLONG_MAX, minY = LLONG_MAX, maxX = LLONG_MIN, maxY = LLONG_MIN;
+    for (const Chunk* chunk : chunks) {
+      Chunk::Row columns = 0;
+      for (int row = 0; row < CHUNK_SIZE; row++) {
+        if (chunk->row(row) != 0) {
+          columns |= chunk->row(row);
+          minY = std::min(minY, (long long) chunk->chunkY * CHUNK_SIZE + row);
+          maxY = std::max(maxY, (long long) chunk->chunkY * CHUNK_SIZE + row);
+        }
+      }
+      int highest = CHUNK_SIZE - 1;
+      while ((columns >> highest & 1u) == 0) highest--;
+      minX = std::min(minX, (long long) chunk->chunkX * CHUNK_SIZE + countTrailingZeros(columns));
+      maxX = std::max(maxX, (long long) chunk->chunkX * CHUNK_SIZE + highest);
+    }
+    out << "#CXRLE Pos=" << minX << ',' << minY << " Gen=" << automaton.generation() << '\n';
+    out << "x = " << maxX - minX + 1 << ", y = " << maxY - minY + 1 << ", rule = " << rule << '\n';
+    
+    // Runs which meet across chunks are joined up before they're written
+    RLETokens tokens(out);
+    long long rowY = minY, cursorX = minX; // where the tokens so far leave off
+    long long runY = 0, runStart = 0, runEnd = 0;
+    bool hasRun = false;
+    auto writeRun = [&] () {
+      if (runY > rowY) {
+        tokens.write(runY - rowY, '$');
+        rowY = runY;
+        cursorX = minX;
+      }
+      if (runStart > cursorX) {
+        tokens.write(runStart - cursorX, 'b');
+      }
+      tokens.write(runEnd - runStart, 'o');
+      cursorX = runEnd;
+    };
+    forEachRun(chunks, [&] (long long x, long long y, long long length) {
+      if (hasRun && y == runY && x == runEnd) {
+        runEnd += length;
+        return;
+      }
+      if (hasRun) {
+        writeRun();
+      }
+      hasRun = true;
+      runY = y;
+      runStart = x;
+      runEnd = x + length;
+    });
+    writeRun(); // there's at least one, as there are non-empty chunks
+    tokens.write(1, '!');
+    out << '\n';
+  }
+  
+  void writeLife106(std::ostream& out, Automaton& automaton) {
+    out << "#Life 1.06\n";
+    forEachRun(sortedChunks(automaton), [&out] (long long x, long long y, long long length) {
+      for (long long i = 0; i < length; i++) {
+        out << x + i << ' ' << y << '\n';
+      }
+    });
+  }
+  
+  void writeMacrocell(std::ostream& out, Automaton& automaton) {
+    // HashLife has the tree, so let it build one; it needs rules it can run, but they don't come into writing it
+    Ruleset life(new MooreNeighbourhoodType(1));
+    life.setRules("B3/S23");
+    HashLife tree(life);
+    automaton.copyCellsTo(tree);
+    
+    out << "[M2] (game_of_life)\n";
+    out << "#R " << automaton.ruleset().getRuleString() << '\n';
+    out << "#G " << automaton.generation() << '\n';
+    tree.writeMacrocell(out);
+  }
+}
+
+PatternIO::Info PatternIO::read(std::istream& in, Automaton& automaton, int x, int y) {
+  std::string line;
+  while (nextLine(in, line) && isBlank(line)) {}
+  
+  RowSink sink(automaton);
+  Info info{Format::RLE, std::string()};
+  try {
+    if (startsWith(line, "#Life 1.06")) {
+      info.format = Format::LIFE_106;
+      readLife106(in, sink, x, y);
+    } else if (startsWith(line, "[M2]")) {
+      info.format = Format::MACROCELL;
+      info.rule = readMacrocell(in, sink, x, y);
+    } else if (startsWith(line, "#Life")) {
+      throw std::invalid_argument("Only Life 1.06 patterns are supported, not " + line);
+    } else {
+      info.rule = readRLE(in, line, sink, x, y);
+    }
+  } catch (...) {
+    sink.flush(); // keep what was read before
+    throw;
+  }
+  sink.flush();
+  info.rule = toBSNotation(info.rule);
+  return info;
+}
+
+void PatternIO::write(std::ostream& out, Format format, Automaton& automaton) {
+  switch (format) {
+    case Format::RLE:
+    default:
+      writeRLE(out, automaton);
+      break;
+    case Format::LIFE_106:
+      writeLife106(out, automaton);
+      break;
+    case Format::MACROCELL:
+      writeMacrocell(out, automaton);
+      break;
+  }
+}
+
+PatternIO::Format PatternIO::formatForFileName(const std::string& name) {
+  std::string::size_type dot = name.rfind('.');
+  std::string extension = dot == std::string::npos ? std::string() : name.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), [] (char c) { return (char) tolower(c); });
+  if (extension == "mc") {
+    return Format::MACROCELL;
+  } else if (extension == "lif" || extension == "life") {
+    return Format::LIFE_106;
+  }
+  return Format::RLE;
+}
@@ -0,0 +1,45 @@
+#ifndef GAME_OF_LIFE_PATTERNIO_H
+#define GAME_OF_LIFE_PATTERNIO_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "Automaton.h"
+
+// Reads and writes patterns as RLE, Life 1.06 and Macrocell files, streaming both ways: reading puts the live cells
+// straight into the automaton's chunks a row of a chunk at a time (see Automaton::addLiveCells), and writing walks the
+// chunks in spatial order and encodes straight from their rows, so neither ever holds a list of every cell. Macrocell
+// files are written from a HashLife tree, built up from the chunks a batch at a time.
+// Patterns only carry live cells and a rule string; reading never kills cells or changes the rules itself.
+class PatternIO {
+public:
+  enum class Format {
+    RLE, // run-length encoded rows, as most patterns are shared
+    LIFE_106, // one "x y" line per live cell
+    MACROCELL // a HashLife quadtree, as written by Golly; best for huge, repetitive patterns
+  };
+  
+  // What a pattern file says besides its cells.
+  struct Info {
+    Format format;
+    std::string rule; // in B/S notation (see Ruleset::setRules), even if the file uses S/B, or empty if it doesn't say
+  };
+  
+  // Read a pattern, in whichever format it turns out to be, making its live cells live in automaton, moved by (x, y).
+  // RLE patterns start at their #CXRLE position if they have one, and at the origin otherwise; the others say where
+  // their cells are themselves. Throw std::invalid_argument if the pattern is malformed, or std::out_of_range if a cell
+  // is outside the automaton's topology. Either way, the cells read before it are left in.
+  static Info read(std::istream& in, Automaton& automaton, int x = 0, int y = 0);
+  
+  // Write every live cell of automaton, with its rule string, as a pattern in format.
+  static void write(std::ostream& out, Format format, Automaton& automaton);
+  
+  // Guess the format of a file from its name: .mc is Macrocell, .lif and .life are Life 1.06 and anything else is RLE.
+  static Format formatForFileName(const std::string& name);
+  
+  // Patterns which are going to be read by other programs should keep their lines shorter than this.
+  static constexpr std::string::size_type RLE_LINE_LENGTH = 70;
+};
+
+#endif //GAME_OF_LIFE_PATTERNIO_H
@@ -1,5 +1,8 @@
 #include <algorithm>
+#include <cctype>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "Ruleset.h"
 
@@ -49,6 +52,7 @@ Ruleset& Ruleset::operator=(const Ruleset& toCopy) {
   
   std::copy(toCopy.born_, toCopy.born_ + arrSize, born_);
   std::copy(toCopy.survive_, toCopy.survive_ + arrSize, survive_);
+  revision_++;
   
   return *this;
 }
@@ -77,6 +81,7 @@ Ruleset& Ruleset::operator=(Ruleset&& toMove) noexcept {
   toMove.neighbourhoodType_ = nullptr;
   toMove.born_ = nullptr;
   toMove.survive_ = nullptr;
+  revision_++;
   
   return *this;
 }
@@ -87,6 +92,10 @@ NeighbourhoodType& Ruleset::getNeighbourhoodType() {
   return *neighbourhoodType_;
 }
 
+const NeighbourhoodType& Ruleset::getNeighbourhoodType() const {
+  return *neighbourhoodType_;
+}
+
 void Ruleset::setNeighbourhoodType(NeighbourhoodType* neighbourhoodType) {
   // Take ownership of neighbourhoodType and reinitialize born_ and survive_
   delete neighbourhoodType_;
@@ -99,6 +108,7 @@ void Ruleset::setNeighbourhoodType(NeighbourhoodType* neighbourhoodType) {
   unsigned int arrSize = neighbourhoodType_->getNumCells() + 1;
   born_ = new bool[arrSize]();
   survive_ = new bool[arrSize]();
+  revision_++;
 }
 
 // Retrieving and setting rules
@@ -116,11 +126,100 @@ bool Ruleset::survivesWith(unsigned int numNeighbours) const {
 void Ruleset::setBornWith(unsigned int numNeighbours, bool value) {
   checkNumNeighboursInRange(numNeighbours);
   born_[numNeighbours] = value;
+  revision_++;
 }
 
 void Ruleset::setSurvivesWith(unsigned int numNeighbours, bool value) {
   checkNumNeighboursInRange(numNeighbours);
   survive_[numNeighbours] = value;
+  revision_++;
+}
+
+// Rule strings
+
+namespace { // local to this file
+  // Parse the numbers of one half of a rule string, after its B or S, into counts.
+  void parseRuleCounts(const std::string& half, std::vector<unsigned int>& counts) {
+    bool commas = half.find(',') != std::string::npos;
+    std::string::size_type i = 1;
+    while (i < half.size()) {
+      if (!isdigit((unsigned char) half[i])) {
+        throw std::invalid_argument("Rule string has a character which isn't a number: " + half);
+      }
+      unsigned int count = 0;
+      if (commas) {
+        for (; i < half.size() && isdigit((unsigned char) half[i]); i++) {
+          count = count * 10 + (half[i] - '0');
+          if (count > 100000) { // no neighbourhood is anywhere near this big; just don't overflow
+            throw std::invalid_argument("Rule string has a number which is far too big: " + half);
+          }
+        }
+        if (i < half.size() && (half[i] != ',' || ++i == half.size())) {
+          throw std::invalid_argument("Rule string has a malformed list of numbers: " + half);
+        }
+      } else {
+        count = half[i++] - '0';
+      }
+      counts.push_back(count);
+    }
+  }
+}
+
+void Ruleset::setRules(const std::string& rule) {
+  std::string::size_type slash = rule.find('/');
+  if (slash == std::string::npos || rule.find('/', slash + 1) != std::string::npos) {
+    throw std::invalid_argument("Rule string must have exactly one '/': " + rule);
+  }
+  std::string halves[2] = {rule.substr(0, slash), rule.substr(slash + 1)};
+  
+  std::vector<unsigned int> bornCounts, surviveCounts;
+  bool seenBorn = false, seenSurvive = false;
+  for (const std::string& half : halves) {
+    char letter = half.empty() ? '\0' : (char) toupper((unsigned char) half[0]);
+    if (letter == 'B' && !seenBorn) {
+      seenBorn = true;
+      parseRuleCounts(half, bornCounts);
+    } else if (letter == 'S' && !seenSurvive) {
+      seenSurvive = true;
+      parseRuleCounts(half, surviveCounts);
+    } else {
+      throw std::invalid_argument("Rule string must have one half starting with B and one with S: " + rule);
+    }
+  }
+  
+  // Check everything before changing anything
+  for (unsigned int count : bornCounts) checkNumNeighboursInRange(count);
+  for (unsigned int count : surviveCounts) checkNumNeighboursInRange(count);
+  
+  unsigned int arrSize = neighbourhoodType_->getNumCells() + 1;
+  std::fill(born_, born_ + arrSize, false);
+  std::fill(survive_, survive_ + arrSize, false);
+  for (unsigned int count : bornCounts) born_[count] = true;
+  for (unsigned int count : surviveCounts) survive_[count] = true;
+  revision_++;
+}
+
+std::string Ruleset::getRuleString() const {
+  unsigned int numCells = neighbourhoodType_->getNumCells();
+  bool commas = numCells > 9;
+  std::string rule;
+  for (int half = 0; half < 2; half++) {
+    const bool* rules = half == 0 ? born_ : survive_;
+    rule += half == 0 ? "B" : "/S";
+    bool first = true;
+    for (unsigned int count = 0; count <= numCells; count++) {
+      if (rules[count]) {
+        if (commas && !first) rule += ',';
+        rule += std::to_string(count);
+        first = false;
+      }
+    }
+  }
+  return rule;
+}
+
+unsigned long long Ruleset::revision() const noexcept {
+  return revision_;
 }
 
 // Utility
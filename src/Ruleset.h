@@ -1,6 +1,8 @@
 #ifndef GAME_OF_LIFE_RULESET_H
 #define GAME_OF_LIFE_RULESET_H
 
+#include <string>
+
 #include "Neighbourhood.h"
 
 // A Ruleset represents the rules of the current cellular automaton, including the neighbourhood type and whether
@@ -28,6 +30,7 @@ public:
   
   // Retrieve the NeighbourhoodType passed in, as a reference. Callers must not delete or (somehow) modify it.
   NeighbourhoodType& getNeighbourhoodType();
+  const NeighbourhoodType& getNeighbourhoodType() const;
   
   // Set the NeighbourhoodType. Destroy the old NeighbourhoodType and take ownership of this one.
   // Reinitialize the born and survive rules to false.
@@ -51,6 +54,21 @@ public:
   // Throw std::invalid_argument if numNeighbours is greater than the total number of cells of the neighbourhood.
   void setSurvivesWith(unsigned int numNeighbours, bool value);
   
+  // Rule strings
+  
+  // Replace the born and survive rules with those of a rule string in B/S notation, like "B3/S23" for Conway's Game of
+  // Life (the halves may come in either order). Each number is a single digit, unless a half has commas, in which
+  // case they're comma-separated, for neighbourhoods with more than 9 cells: "B34,35/S33,34,35,36".
+  // Throw std::invalid_argument if it's malformed or any number is out of range, leaving the rules as they were.
+  void setRules(const std::string& rule);
+  
+  // Get the born and survive rules as a rule string in the notation setRules takes, with commas if they're needed.
+  std::string getRuleString() const;
+  
+  // Get a number which changes whenever the neighbourhood type or rules might have, so anything which depends on them
+  // can tell when to start over without being told.
+  unsigned long long revision() const noexcept;
+  
 private:
   // Check that numNeighbours <= total number of cells of neighbourhood, throw std::invalid_argument otherwise.
   void checkNumNeighboursInRange(unsigned int numNeighbours) const;
@@ -63,6 +81,8 @@ private:
   // These arrays are the same size as neighbourhoodType_->getNumCells() + 1.
   bool* born_; // born_[i]: should a dead cell with i live neighbours become alive?
   bool* survive_; // survive_[i]: should a live cell with i live neighbours survive?
+  
+  unsigned long long revision_ = 0; // see revision()
 };
 
 #endif //GAME_OF_LIFE_RULESET_H
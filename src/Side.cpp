@@ -6,16 +6,6 @@ const Side Side::CONST_TOP(Side::TOP);
 const Side Side::CONST_LEFT(Side::LEFT);
 const Side Side::CONST_RIGHT(Side::RIGHT);
 
-constexpr Side::Side(Value value) noexcept : value_(value) {}
-
-constexpr bool Side::operator==(const Side& side) const {
-  return value_ == side.value_;
-}
-
-constexpr bool Side::operator!=(const Side& side) const {
-  return value_ != side.value_;
-}
-
 void Side::transform(int& x, int& y, int width, int height) const {
   if (value_ == LEFT || value_ == RIGHT) {
     std::swap(x, y);
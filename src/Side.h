@@ -9,12 +9,14 @@ public:
   enum Value : unsigned int {
     BOTTOM, TOP, LEFT, RIGHT
   };
-  constexpr Side(Value value) noexcept; // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+  // NOLINTNEXTLINE(google-explicit-constructor,hicpp-explicit-conversions)
+  constexpr Side(Value value) noexcept : value_(value) {}
   operator Value() const noexcept { return value_; } // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
   explicit operator bool() const = delete; // don't allow if (side)
   
-  constexpr bool operator==(const Side& side) const;
-  constexpr bool operator!=(const Side& side) const;
+  // constexpr, so these (and the constructor) have to be defined here for other files to use them
+  constexpr bool operator==(const Side& side) const { return value_ == side.value_; }
+  constexpr bool operator!=(const Side& side) const { return value_ != side.value_; }
   
   // Transform x and y, relative to the bottom, to relative to this Side.
   void transform(int& x, int& y, int width, int height) const;
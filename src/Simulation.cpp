@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "Simulation.h"
+
+constexpr std::chrono::milliseconds Simulation::PUBLISH_RETRY_DELAY;
+constexpr std::chrono::milliseconds Simulation::DEFAULT_FRAME_INTERVAL;
+constexpr unsigned long long Simulation::MAX_STEP_SIZE;
+
+// AutomatonLock
+
+Simulation::AutomatonLock::AutomatonLock(Simulation& simulation) : simulation_(simulation) {
+  simulation_.waitingLocks_++; // so a step of as many generations as fit stops early for us
+  simulation_.automatonMutex_.lock();
+  simulation_.waitingLocks_--;
+}
+
+Simulation::AutomatonLock::~AutomatonLock() {
+  {
+    std::lock_guard<std::mutex> lock(simulation_.mutex_);
+    simulation_.changedDirectly_ = true;
+  }
+  simulation_.automatonMutex_.unlock();
+  simulation_.wake_.notify_one();
+}
+
+// Simulation
+
+Simulation::Simulation(Automaton* automaton) : frame_(new Frame), automaton_(automaton) {
+  if (automaton == nullptr) {
+    throw std::invalid_argument("Cannot simulate a null automaton");
+  }
+  spare_ = frame_.get();
+  setAutomaton(automaton);
+  worker_ = std::thread(&Simulation::workerLoop, this);
+}
+
+Simulation::~Simulation() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+}
+
+void Simulation::setAutomaton(Automaton* automaton) {
+  if (automaton == nullptr) {
+    throw std::invalid_argument("Cannot simulate a null automaton");
+  }
+  AutomatonLock lock(*this);
+  if (automaton_ != automaton) {
+    automaton_->setProfiler(nullptr);
+  }
+  automaton_ = automaton;
+  automaton->setProfiler(profiler_);
+  {
+    std::lock_guard<std::mutex> stateLock(mutex_);
+    unfinished_ = 0; // the rest of a step of the old automaton
+  }
+  
+  // Whatever was recorded before is news to nobody: the next frame has every chunk anyway
+  ChunkArray& chunkArray = automaton->chunkArray();
+  chunkArray.setRecordingChanges(true);
+  chunkArray.takeChanges(changes_);
+  unpublished_.clear();
+  unpublished_.reserve(chunkArray.size());
+  for (auto& entry : chunkArray) {
+    unpublished_.insert(entry.x(), entry.y(), true);
+  }
+  resetPending_ = true;
+}
+
+void Simulation::play() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    playing_ = true;
+  }
+  wake_.notify_one();
+}
+
+void Simulation::pause() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  playing_ = false;
+}
+
+bool Simulation::playing() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return playing_;
+}
+
+void Simulation::step() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    steps_++;
+  }
+  wake_.notify_one();
+}
+
+void Simulation::setStepDelay(std::chrono::milliseconds delay) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stepDelay_ = delay;
+  }
+  wake_.notify_one();
+}
+
+void Simulation::setStepSize(unsigned long long generations) {
+  if (generations > MAX_STEP_SIZE) {
+    throw std::invalid_argument("Cannot step by more than MAX_STEP_SIZE generations");
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  stepSize_ = generations;
+}
+
+void Simulation::setProfiler(TickProfiler* profiler) {
+  AutomatonLock lock(*this);
+  profiler_ = profiler;
+  automaton_->setProfiler(profiler);
+}
+
+void Simulation::setFrameInterval(std::chrono::milliseconds interval) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frameInterval_ = interval;
+  }
+  wake_.notify_one();
+}
+
+void Simulation::edit(int x, int y, Edit edit) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    edits_.push_back(CellEdit{x, y, edit});
+  }
+  wake_.notify_one();
+}
+
+bool Simulation::takeFrame(Frame& frame) {
+  Frame* published = published_.exchange(nullptr, std::memory_order_acquire);
+  if (published == nullptr) {
+    return false;
+  }
+  std::swap(frame, *published); // and the worker gets our old vectors to fill next time
+  spare_.store(published, std::memory_order_release);
+  return true;
+}
+
+// The worker
+
+void Simulation::workerLoop() {
+  Clock::time_point nextStep = Clock::now();
+  Clock::time_point lastPublished; // long ago
+  bool pending = true; // is there anything the reader hasn't been sent? At first, the whole automaton
+  
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    Clock::time_point now = Clock::now();
+    bool step = unfinished_ > 0 || steps_ > 0 || (playing_ && now >= nextStep);
+    // While playing, frames keep to the frame interval; otherwise every change goes out as soon as it's made
+    Clock::time_point publishFrom = playing_ ? lastPublished + frameInterval_ : now;
+    if (!step && edits_.empty() && !changedDirectly_) {
+      if (pending && now >= publishFrom) {
+        // Nothing new, but it's time for a frame, and the reader may have made room for it since we last tried
+        lock.unlock();
+        {
+          std::lock_guard<std::recursive_mutex> automatonLock(automatonMutex_);
+          pending = !publish();
+        }
+        lock.lock();
+        if (!pending) {
+          lastPublished = now;
+          continue;
+        }
+      }
+      
+      Clock::time_point wakeAt = playing_ ? nextStep : Clock::time_point::max();
+      if (pending) {
+        wakeAt = std::min(wakeAt, std::max(publishFrom, now + PUBLISH_RETRY_DELAY));
+      }
+      if (wakeAt == Clock::time_point::max()) {
+        wake_.wait(lock);
+      } else {
+        wake_.wait_until(lock, wakeAt);
+      }
+      continue;
+    }
+    
+    unsigned long long generations = stepSize_;
+    Clock::time_point deadline = now + frameInterval_; // for a step of as many generations as fit
+    if (unfinished_ > 0) {
+      generations = unfinished_; // finish the step which broke off before starting another
+    } else if (step) {
+      if (steps_ > 0) {
+        steps_--;
+      } else {
+        nextStep = now + stepDelay_; // from the start of this step, so the delay includes it
+      }
+    }
+    applying_.swap(edits_);
+    changedDirectly_ = false;
+    lock.unlock();
+    
+    {
+      std::lock_guard<std::recursive_mutex> automatonLock(automatonMutex_);
+      for (const CellEdit& edit : applying_) {
+        bool value = edit.edit == Edit::REVIVE
+            || (edit.edit == Edit::TOGGLE && !automaton_->getCell(edit.x, edit.y));
+        try {
+          automaton_->setCell(edit.x, edit.y, value);
+        } catch (std::out_of_range&) {} // outside the topology; there's no cell to edit
+      }
+      applying_.clear();
+      if (step) {
+        unsigned long long unfinished = advance(generations, deadline);
+        std::lock_guard<std::mutex> stateLock(mutex_); // while we still have the automaton, so it's still its step
+        unfinished_ = unfinished;
+      }
+      pending = true; // the ChunkArray keeps the changes until publish gathers them
+      if (Clock::now() >= publishFrom && publish()) {
+        pending = false;
+        lastPublished = Clock::now();
+      }
+    }
+    
+    lock.lock();
+  }
+}
+
+unsigned long long Simulation::advance(unsigned long long generations, Clock::time_point deadline) {
+  if (generations == 0) {
+    // At least one tick, so every step gets somewhere however slow the ticks are
+    do {
+      automaton_->tick();
+    } while (Clock::now() < deadline && !interrupted());
+    return 0;
+  }
+  if (automaton_->engine() == Automaton::Engine::HASHLIFE) {
+    for (unsigned int log2 = 0; generations >> log2 != 0; log2++) {
+      if ((generations >> log2) & 1) {
+        automaton_->jump(log2);
+      }
+    }
+    return 0;
+  }
+  
+  // The others tick every generation of a jump anyway, and a big step would keep everyone else waiting for minutes
+  do {
+    automaton_->tick();
+    generations--;
+  } while (generations > 0 && !interrupted());
+  return generations;
+}
+
+bool Simulation::interrupted() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stopping_ || !edits_.empty() || waitingLocks_.load(std::memory_order_relaxed) > 0;
+}
+
+void Simulation::gatherChanges() {
+  automaton_->chunkArray().takeChanges(changes_);
+  unpublished_.reserve(unpublished_.size() + changes_.events.size() + changes_.changed.size());
+  for (const ChunkArray::ChunkEvent& event : changes_.events) {
+    unpublished_.insert(event.x, event.y, true);
+  }
+  for (const auto& coordinates : changes_.changed) {
+    unpublished_.insert(coordinates.first, coordinates.second, true);
+  }
+}
+
+bool Simulation::publish() {
+  Frame* frame = spare_.exchange(nullptr, std::memory_order_acquire);
+  if (frame == nullptr) {
+    return false; // the reader hasn't taken the last one yet
+  }
+  
+  // Only now, since looking at the chunks brings them up to date with the grid or HashLife, all of them at once
+  gatherChanges();
+  ChunkArray& chunkArray = automaton_->chunkArray();
+  frame->reset = resetPending_;
+  frame->chunks.clear();
+  for (auto& entry : unpublished_) {
+    ChunkCells cells{};
+    cells.x = entry.x();
+    cells.y = entry.y();
+    cells.present = chunkArray.contains(cells.x, cells.y);
+    if (cells.present) {
+      const Chunk& chunk = chunkArray.at(cells.x, cells.y);
+      cells.population = chunk.population();
+      std::copy(chunk.rows(), chunk.rows() + CHUNK_SIZE, cells.rows);
+    }
+    frame->chunks.push_back(cells);
+  }
+  frame->generation = automaton_->generation();
+  frame->population = automaton_->population();
+  frame->chunkCount = chunkArray.size();
+  frame->memoryUsage = automaton_->memoryUsage();
+  frame->engine = automaton_->engine();
+  unpublished_.clear();
+  resetPending_ = false;
+  
+  published_.store(frame, std::memory_order_release);
+  return true;
+}
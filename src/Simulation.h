@@ -0,0 +1,181 @@
+#ifndef GAME_OF_LIFE_SIMULATION_H
+#define GAME_OF_LIFE_SIMULATION_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Automaton.h"
+#include "CoordinateMap.h"
+
+// Runs an Automaton on a worker thread of its own, so a slow tick never holds up whoever is showing it. The worker
+// publishes what changed as Frames: the cells of every chunk inserted, erased or changed since the last frame, copied
+// out so the reader never touches the chunks. Frames are handed over lock-free through a single slot: the worker only
+// fills a frame once the reader has taken the last one, and meanwhile keeps gathering the chunks which changed, so a
+// reader which falls behind just gets bigger frames. The reader shows one frame while the worker computes the next.
+// Each step advances the automaton by the step size, which can be many generations (or as many as fit in one frame
+// interval), and only the state it ends up in is published. HashLife leaps a step a power of two at a time, but the
+// chunks and the grid tick it one generation at a time, and break off whenever something is waiting for the
+// automaton, carrying on with the rest of the step once it's had its turn. While playing, frames are published at most once a frame
+// interval, so however fast the worker steps, the reader gets frames at a steady rate, and the worker spends its time
+// stepping instead of copying out states nobody will see.
+// Cell edits are queued and applied by the worker between steps. Anything else which touches the automaton directly
+// must hold an AutomatonLock while it does.
+class Simulation {
+public:
+  // The cells of one chunk as they are in a frame.
+  struct ChunkCells {
+    int x, y;
+    bool present; // or erased, in which case the rest is meaningless
+    int population;
+    Chunk::Row rows[CHUNK_SIZE];
+  };
+  
+  // What changed in the automaton between two frames, and where it's got to.
+  struct Frame {
+    bool reset = false; // is this a different automaton? If so, forget every chunk from earlier frames first
+    std::vector<ChunkCells> chunks; // inserted, erased or changed since the last frame, each once
+    long long generation = 0;
+    long long population = 0;
+    std::size_t chunkCount = 0;
+    std::size_t memoryUsage = 0; // the automaton's estimate, in bytes
+    Automaton::Engine engine = Automaton::Engine::CHUNKS;
+  };
+  
+  // What a queued edit does to its cell.
+  enum class Edit {
+    KILL, REVIVE, TOGGLE
+  };
+  
+  // Keeps the worker off the automaton for as long as it's alive (waiting for it to finish the step it's on, if
+  // need be), so the automaton can be read and changed directly on this thread. Once it's gone, whatever changed
+  // goes out in the next frame. Locks can be nested on one thread.
+  class AutomatonLock {
+  public:
+    explicit AutomatonLock(Simulation& simulation);
+    ~AutomatonLock();
+    
+    AutomatonLock(const AutomatonLock&) = delete;
+    AutomatonLock& operator=(const AutomatonLock&) = delete;
+  
+  private:
+    Simulation& simulation_;
+  };
+  
+  // Start the worker on automaton, which we don't own and which must outlive us or be replaced with setAutomaton
+  // first. It starts paused, with a frame of every chunk.
+  explicit Simulation(Automaton* automaton);
+  
+  // Stop and join the worker, waiting for the step it's on.
+  ~Simulation();
+  
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+  
+  // Switch to automaton, which we don't own, so the old one can be deleted once this returns. The next frame resets
+  // the reader's chunks to all of the new automaton's.
+  void setAutomaton(Automaton* automaton);
+  
+  void play(); // Start stepping over and over, waiting the step delay between steps.
+  void pause(); // Stop stepping after the current step. Queued edits are still applied.
+  bool playing() const; // Is it stepping over and over?
+  
+  // Step once, after any edits already queued.
+  void step();
+  
+  // Set how long to wait between the starts of steps while playing. 0, the default, steps as fast as possible.
+  void setStepDelay(std::chrono::milliseconds delay);
+  
+  // Set how many generations each step advances. They're jumped a power of two at a time, so HashLife leaps them
+  // rather than ticking each. 0 steps as many generations as fit in a frame interval, one tick at a time. The default
+  // is 1. Throw std::invalid_argument if it's more than MAX_STEP_SIZE.
+  void setStepSize(unsigned long long generations);
+  
+  // Record every tick to profiler, which we don't own and which must outlive us or be replaced first, whichever
+  // automaton is running; nullptr stops.
+  void setProfiler(TickProfiler* profiler);
+  
+  // Set the shortest time between frames while playing. When paused, every step and edit is published straight away.
+  void setFrameInterval(std::chrono::milliseconds interval);
+  
+  // Queue an edit to the cell at (x, y), in cell coordinates, for the worker to make before its next step. Edits
+  // to cells outside the automaton's topology are dropped.
+  void edit(int x, int y, Edit edit);
+  
+  // If a frame has been published since the last call, swap it into frame and return true; otherwise return false
+  // and leave frame alone. Never waits for the worker. Only one thread may take frames.
+  bool takeFrame(Frame& frame);
+  
+  // How long the worker waits before trying again to publish changes the reader hasn't made room for yet.
+  static constexpr std::chrono::milliseconds PUBLISH_RETRY_DELAY{5};
+  
+  // The default frame interval, for about 60 frames a second.
+  static constexpr std::chrono::milliseconds DEFAULT_FRAME_INTERVAL{16};
+  
+  // The most generations a step can advance: one jump of each size up to the biggest HashLife can make.
+  static constexpr unsigned long long MAX_STEP_SIZE = (2ULL << HashLife::MAX_LOG2_STEP) - 1;
+  
+private:
+  struct CellEdit {
+    int x, y;
+    Edit edit;
+  };
+  
+  typedef std::chrono::steady_clock Clock;
+  
+  void workerLoop(); // the loop run by the worker thread
+  
+  // Advance the automaton by generations, or if that's 0, tick until deadline or until stepping should stop to let
+  // something else happen. Return how many of the generations are left to go because stepping stopped early, which
+  // only happens off HashLife. Needs automatonMutex_ but not mutex_.
+  unsigned long long advance(unsigned long long generations, Clock::time_point deadline);
+  
+  // Should a step of as many generations as fit stop early: is the worker stopping, or is an edit or an AutomatonLock
+  // waiting?
+  bool interrupted() const;
+  
+  // Add the chunks the automaton's ChunkArray recorded as changed to unpublished_. Needs automatonMutex_.
+  // This brings the chunks up to date if the grid or HashLife engine is running, so it's only done by publish.
+  void gatherChanges();
+  
+  // Gather the changes and publish a frame of unpublished_ if the reader has taken the last one, returning whether it
+  // did.
+  // Needs automatonMutex_.
+  bool publish();
+  
+  std::recursive_mutex automatonMutex_; // held by whoever is touching the automaton; guards the block after the slots
+  std::atomic<int> waitingLocks_{0}; // AutomatonLocks waiting for automatonMutex_
+  
+  mutable std::mutex mutex_; // guards everything below until the frame slots
+  std::condition_variable wake_; // signalled whenever the worker has something new to do
+  std::vector<CellEdit> edits_; // queued since the worker last looked
+  bool playing_ = false;
+  unsigned long long steps_ = 0; // single steps asked for with step()
+  std::chrono::milliseconds stepDelay_{0};
+  unsigned long long stepSize_ = 1; // or 0 for as many generations as fit in a frame interval
+  std::chrono::milliseconds frameInterval_ = DEFAULT_FRAME_INTERVAL;
+  unsigned long long unfinished_ = 0; // generations of a step which broke off early, to go before the next step
+  bool stopping_ = false;
+  bool changedDirectly_ = false; // has the automaton been changed under an AutomatonLock since the worker looked?
+  
+  // The frame slots: the worker fills spare_ and moves it to published_, and the reader swaps it out and puts it back
+  std::atomic<Frame*> published_{nullptr};
+  std::atomic<Frame*> spare_{nullptr};
+  std::unique_ptr<Frame> frame_; // the frame in one slot or the other, owned here
+  
+  // Guarded by automatonMutex_
+  Automaton* automaton_;
+  CoordinateMap<bool> unpublished_; // the chunks changed since the last frame; the values are unused
+  bool resetPending_ = true; // does the next frame reset the reader?
+  ChunkArray::Changes changes_; // kept between steps so its vectors aren't reallocated every step
+  std::vector<CellEdit> applying_; // the edits being applied, swapped with edits_
+  TickProfiler* profiler_ = nullptr; // given to each automaton; not ours
+  
+  std::thread worker_; // last, so it starts once everything above is ready
+};
+
+#endif //GAME_OF_LIFE_SIMULATION_H
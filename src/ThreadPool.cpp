@@ -0,0 +1,130 @@
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads) {
+  if (threads == 0) {
+    throw std::invalid_argument("Cannot create a ThreadPool with no threads");
+  }
+  for (unsigned int worker = 0; worker < threads; worker++) {
+    queues_.emplace_back(new WorkQueue);
+  }
+  for (unsigned int worker = 1; worker < threads; worker++) {
+    threads_.emplace_back(&ThreadPool::workerLoop, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+unsigned int ThreadPool::size() const noexcept {
+  return (unsigned int) queues_.size();
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t grain, const Task& task) {
+  if (count == 0) return;
+  if (grain == 0) grain = 1;
+  if (queues_.size() == 1) {
+    task(0, count, 0); // nobody to share with
+    return;
+  }
+  
+  // The task must be published before any batch is, since stragglers from the last round may still be looking
+  std::size_t numBatches = (count + grain - 1) / grain;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    error_ = nullptr;
+    remaining_ = numBatches;
+    round_++;
+  }
+  
+  // Deal the batches out round-robin; stealing evens out any imbalance
+  for (std::size_t i = 0; i < numBatches; i++) {
+    std::size_t begin = i * grain;
+    std::size_t end = begin + grain < count ? begin + grain : count;
+    WorkQueue& queue = *queues_[i % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.batches.emplace_back(begin, end);
+  }
+  wake_.notify_all();
+  
+  runBatches(0);
+  
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] () { return remaining_ == 0; });
+    task_ = nullptr;
+    error = error_;
+    error_ = nullptr;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::workerLoop(unsigned int worker) {
+  unsigned long long seenRound = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this, seenRound] () { return stopping_ || round_ != seenRound; });
+      if (stopping_) return;
+      seenRound = round_;
+    }
+    runBatches(worker);
+  }
+}
+
+void ThreadPool::runBatches(unsigned int worker) {
+  Batch batch;
+  while (takeBatch(worker, batch)) {
+    try {
+      (*task_)(batch.first, batch.second, worker);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+    }
+    
+    if (--remaining_ == 0) {
+      std::lock_guard<std::mutex> lock(mutex_); // so the wakeup can't slip in before parallelFor starts waiting
+      done_.notify_all();
+    }
+  }
+}
+
+bool ThreadPool::takeBatch(unsigned int worker, Batch& batch) {
+  {
+    // Our own work first, from the back
+    WorkQueue& own = *queues_[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.batches.empty()) {
+      batch = own.batches.back();
+      own.batches.pop_back();
+      return true;
+    }
+  }
+  
+  // Then steal from the front of everybody else's, starting with our neighbour
+  for (std::size_t i = 1; i < queues_.size(); i++) {
+    WorkQueue& victim = *queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.batches.empty()) {
+      batch = victim.batches.front();
+      victim.batches.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,70 @@
+#ifndef GAME_OF_LIFE_THREADPOOL_H
+#define GAME_OF_LIFE_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A fixed-size pool of worker threads which splits ranges of indices between them with work stealing. Each worker has
+// its own deque of batches; it takes from the back of its own and, once that's empty, steals from the front of the
+// others', so workers which get cheap batches (like empty chunks) help out the ones which get expensive ones.
+// The thread calling ThreadPool::parallelFor works too, as worker 0.
+class ThreadPool {
+public:
+  // The function run on each batch: task(begin, end, worker) handles indices [begin, end) on the given worker, where
+  // 0 <= worker < size(). Each worker runs one batch at a time, so per-worker state can be indexed by worker.
+  typedef std::function<void(std::size_t, std::size_t, unsigned int)> Task;
+  
+  // Initialize the pool with the given total number of workers, including the calling thread, so threads - 1 threads
+  // are started. Throw std::invalid_argument if threads is 0.
+  explicit ThreadPool(unsigned int threads);
+  
+  // Stop and join all the threads.
+  ~ThreadPool();
+  
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  
+  // Get the number of workers, including the calling thread.
+  unsigned int size() const noexcept;
+  
+  // Run task over [0, count) in batches of at most grain indices, spread over all the workers, and return when every
+  // batch is done. If any batch throws, the first exception is rethrown here once the others have finished.
+  // Only one thread may call this at a time.
+  void parallelFor(std::size_t count, std::size_t grain, const Task& task);
+  
+private:
+  typedef std::pair<std::size_t, std::size_t> Batch; // [begin, end)
+  
+  // The queue of batches belonging to one worker; other workers steal from it when theirs is empty.
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Batch> batches;
+  };
+  
+  void workerLoop(unsigned int worker); // the loop run by each started thread
+  void runBatches(unsigned int worker); // run batches until there are none left to take or steal
+  bool takeBatch(unsigned int worker, Batch& batch); // take our own batch or steal one; return false if none left
+  
+  std::vector<std::unique_ptr<WorkQueue>> queues_; // one per worker
+  std::vector<std::thread> threads_; // workers 1 to size() - 1
+  
+  std::mutex mutex_; // guards everything below except remaining_
+  std::condition_variable wake_; // signalled when a new round of batches starts or the pool is stopping
+  std::condition_variable done_; // signalled when the last batch of a round finishes
+  const Task* task_ = nullptr; // the task of the current round
+  unsigned long long round_ = 0; // incremented for every call to parallelFor
+  bool stopping_ = false;
+  std::exception_ptr error_; // the first exception thrown by a batch this round
+  std::atomic<std::size_t> remaining_{0}; // batches not yet finished this round
+};
+
+#endif //GAME_OF_LIFE_THREADPOOL_H
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+#include "TickProfiler.h"
+
+constexpr std::size_t TickProfiler::PHASES;
+constexpr std::size_t TickProfiler::DEFAULT_CAPACITY;
+
+namespace { // local to this file
+  const char* PHASE_NAMES[TickProfiler::PHASES] = {
+      "generate", "insertQueued", "generateQueued", "update", "pruneAndPad", "hashLife", "grid"
+  };
+  
+  // Write time in microseconds, which is what traces are in, to the nanosecond.
+  void writeMicroseconds(std::ostream& out, std::chrono::nanoseconds time) {
+    long long nanoseconds = time.count();
+    out << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000 << std::setfill(' ');
+  }
+  
+  // Write the start of a complete event in a trace, up to its arguments.
+  void writeCompleteEvent(std::ostream& out, const char* name, std::chrono::nanoseconds start,
+      std::chrono::nanoseconds duration) {
+    out << "{\"name\": \"" << name << "\", \"cat\": \"tick\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": ";
+    writeMicroseconds(out, start);
+    out << ", \"dur\": ";
+    writeMicroseconds(out, duration);
+  }
+}
+
+TickProfiler::TickProfiler(std::size_t capacity) : capacity_(capacity) {
+  if (capacity == 0) {
+    throw std::invalid_argument("A TickProfiler must keep at least one tick");
+  }
+}
+
+const char* TickProfiler::phaseName(Phase phase) noexcept {
+  return PHASE_NAMES[(int) phase];
+}
+
+// Recording
+
+void TickProfiler::beginTick() {
+  current_ = Tick();
+  current_.start = sinceEpoch();
+  currentPhase_ = -1;
+}
+
+void TickProfiler::beginPhase(Phase phase) {
+  std::chrono::nanoseconds now = sinceEpoch();
+  if (currentPhase_ >= 0) {
+    current_.phaseDuration[currentPhase_] += now - current_.phaseStart[currentPhase_];
+  }
+  currentPhase_ = (int) phase;
+  current_.phaseStart[currentPhase_] = now;
+}
+
+void TickProfiler::endTick(long long generation, long long generations, std::size_t chunkCount,
+    const Counters& counters) {
+  std::chrono::nanoseconds now = sinceEpoch();
+  if (currentPhase_ >= 0) {
+    current_.phaseDuration[currentPhase_] += now - current_.phaseStart[currentPhase_];
+    currentPhase_ = -1;
+  }
+  current_.duration = now - current_.start;
+  current_.generation = generation;
+  current_.generations = generations;
+  current_.chunkCount = chunkCount;
+  current_.counters = counters;
+  
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ticks_.size() < capacity_) {
+    ticks_.push_back(current_);
+  } else {
+    ticks_[next_] = current_;
+  }
+  next_ = (next_ + 1) % capacity_;
+  if (csv_ != nullptr) {
+    writeCsvRow(*csv_, current_);
+  }
+}
+
+std::chrono::nanoseconds TickProfiler::sinceEpoch() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch_);
+}
+
+// Reading
+
+std::vector<TickProfiler::Tick> TickProfiler::ticks() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Tick> ticks;
+  ticks.reserve(ticks_.size());
+  if (ticks_.size() == capacity_) {
+    ticks.insert(ticks.end(), ticks_.begin() + next_, ticks_.end()); // the oldest, once it's wrapped around
+  }
+  ticks.insert(ticks.end(), ticks_.begin(), ticks_.begin() + (ticks_.size() == capacity_ ? next_ : ticks_.size()));
+  return ticks;
+}
+
+TickProfiler::Summary TickProfiler::summarize(std::chrono::nanoseconds window) const {
+  std::chrono::nanoseconds now = sinceEpoch(), from = now - window;
+  Summary summary;
+  summary.span = std::min(window, now);
+  
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < ticks_.size(); i++) {
+    const Tick& tick = ticks_[(next_ + ticks_.size() - 1 - i) % ticks_.size()]; // newest first
+    if (tick.start < from) break;
+    
+    summary.ticks++;
+    summary.generations += tick.generations;
+    summary.busy += tick.duration;
+    for (std::size_t phase = 0; phase < PHASES; phase++) {
+      summary.phaseDuration[phase] += tick.phaseDuration[phase];
+    }
+    summary.counters.chunksGenerated += tick.counters.chunksGenerated;
+    summary.counters.cellsEvaluated += tick.counters.cellsEvaluated;
+    summary.counters.chunksSkipped += tick.counters.chunksSkipped;
+    summary.counters.memoHits += tick.counters.memoHits;
+    summary.counters.hashLookups += tick.counters.hashLookups;
+    summary.counters.chunksInserted += tick.counters.chunksInserted;
+    summary.counters.chunksErased += tick.counters.chunksErased;
+    if (i + 1 == capacity_) {
+      summary.span = now - tick.start; // the window goes back further than we do
+    }
+  }
+  return summary;
+}
+
+void TickProfiler::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ticks_.clear();
+  next_ = 0;
+}
+
+// Exporting
+
+void TickProfiler::writeChromeTrace(std::ostream& out) const {
+  std::vector<Tick> kept = ticks(); // so the lock isn't held while writing
+  
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  for (const Tick& tick : kept) {
+    out << (first ? "" : ",\n");
+    first = false;
+    
+    writeCompleteEvent(out, "tick", tick.start, tick.duration);
+    out << ", \"args\": {\"generation\": " << tick.generation
+        << ", \"generations\": " << tick.generations
+        << ", \"chunks\": " << tick.chunkCount
+        << ", \"chunksGenerated\": " << tick.counters.chunksGenerated
+        << ", \"cellsEvaluated\": " << tick.counters.cellsEvaluated
+        << ", \"chunksSkipped\": " << tick.counters.chunksSkipped
+        << ", \"memoHits\": " << tick.counters.memoHits
+        << ", \"hashLookups\": " << tick.counters.hashLookups
+        << ", \"chunksInserted\": " << tick.counters.chunksInserted
+        << ", \"chunksErased\": " << tick.counters.chunksErased << "}}";
+    for (std::size_t phase = 0; phase < PHASES; phase++) {
+      if (tick.phaseDuration[phase].count() == 0) continue; // it didn't run
+      out << ",\n";
+      writeCompleteEvent(out, PHASE_NAMES[phase], tick.phaseStart[phase], tick.phaseDuration[phase]);
+      out << '}';
+    }
+    out << ",\n{\"name\": \"chunks\", \"ph\": \"C\", \"pid\": 1, \"ts\": ";
+    writeMicroseconds(out, tick.start + tick.duration);
+    out << ", \"args\": {\"chunks\": " << tick.chunkCount << "}}";
+  }
+  out << "\n]}\n";
+}
+
+void TickProfiler::setCsvOutput(std::ostream* csv) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  csv_ = csv;
+  if (csv_ == nullptr) return;
+  
+  *csv_ << "generation,generations,start_us,duration_us";
+  for (const char* name : PHASE_NAMES) {
+    *csv_ << ',' << name << "_us";
+  }
+  *csv_ << ",chunks,chunks_generated,cells_evaluated,chunks_skipped,memo_hits,hash_lookups,chunks_inserted,"
+      "chunks_erased\n";
+}
+
+void TickProfiler::writeCsvRow(std::ostream& out, const Tick& tick) {
+  out << tick.generation << ',' << tick.generations << ',';
+  writeMicroseconds(out, tick.start);
+  out << ',';
+  writeMicroseconds(out, tick.duration);
+  for (std::chrono::nanoseconds duration : tick.phaseDuration) {
+    out << ',';
+    writeMicroseconds(out, duration);
+  }
+  out << ',' << tick.chunkCount << ',' << tick.counters.chunksGenerated << ',' << tick.counters.cellsEvaluated
+      << ',' << tick.counters.chunksSkipped << ',' << tick.counters.memoHits << ',' << tick.counters.hashLookups
+      << ',' << tick.counters.chunksInserted << ',' << tick.counters.chunksErased << '\n';
+}
@@ -0,0 +1,122 @@
+#ifndef GAME_OF_LIFE_TICKPROFILER_H
+#define GAME_OF_LIFE_TICKPROFILER_H
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Times the phases of each Automaton::tick and counts what they did, so a real run shows where its time goes without
+// attaching a profiler. An Automaton given one with Automaton::setProfiler records a Tick to it for every tick (and
+// every HashLife or grid step, which can be many generations). The last few ticks are kept, to be written out as a
+// Chrome trace (for chrome://tracing or Perfetto); each tick can also be written as a CSV row as soon as it's done,
+// for a log of a whole run.
+// Ticks are recorded by one thread at a time, and can be read from any thread meanwhile.
+class TickProfiler {
+public:
+  // The phases of a tick, in the order they run. A HashLife step has HASHLIFE in place of the generating, and a grid
+  // step is all GRID.
+  enum class Phase {
+    GENERATE, // every chunk present: non-empty ones generated whole, empty ones along the sides by non-empty ones
+    INSERT_QUEUED, // inserting the chunks queued by generating
+    GENERATE_QUEUED, // generating the inserted chunks along their sides
+    UPDATE, // swapping in every chunk's next generation
+    PRUNE_AND_PAD, // erasing isolated empty chunks and inserting empty ones around non-empty ones
+    HASHLIFE, // stepping HashLife, which leaves the chunks to be brought up to date when they're next looked at
+    GRID // stepping the grid engine, which leaves the chunks to be brought up to date when they're next looked at
+  };
+  
+  static constexpr std::size_t PHASES = 7;
+  
+  // Get the name of phase, as it appears in traces.
+  static const char* phaseName(Phase phase) noexcept;
+  
+  // What a tick did.
+  struct Counters {
+    unsigned long long chunksGenerated = 0; // chunks generated whole or along any side
+    unsigned long long cellsEvaluated = 0; // cells the kernels computed the next generation of
+    unsigned long long chunksSkipped = 0; // chunks replayed instead, since everything around them repeated
+    unsigned long long memoHits = 0; // chunks whose next generation was copied from ChunkMemo instead
+    unsigned long long hashLookups = 0; // lookups of chunks by coordinates; see ChunkArray::OperationCounts
+    unsigned long long chunksInserted = 0;
+    unsigned long long chunksErased = 0;
+  };
+  
+  // One tick, as recorded. Times are since the profiler was made.
+  struct Tick {
+    long long generation = 0; // the generation ticked to
+    long long generations = 0; // how many generations it moved on
+    std::chrono::nanoseconds start{0};
+    std::chrono::nanoseconds duration{0};
+    std::chrono::nanoseconds phaseStart[PHASES] = {};
+    std::chrono::nanoseconds phaseDuration[PHASES] = {}; // 0 for phases which didn't run
+    Counters counters;
+    std::size_t chunkCount = 0; // chunks present afterwards
+  };
+  
+  // The kept ticks which started within some window, added up.
+  struct Summary {
+    std::size_t ticks = 0;
+    long long generations = 0;
+    std::chrono::nanoseconds busy{0}; // spent ticking
+    std::chrono::nanoseconds span{0}; // the window, or less if the ticks kept don't go back that far
+    std::chrono::nanoseconds phaseDuration[PHASES] = {};
+    Counters counters;
+  };
+  
+  // Initialize the profiler to keep the last capacity ticks. Throw std::invalid_argument if it's 0.
+  explicit TickProfiler(std::size_t capacity = DEFAULT_CAPACITY);
+  
+  TickProfiler(const TickProfiler&) = delete;
+  TickProfiler& operator=(const TickProfiler&) = delete;
+  
+  // Recording, for Automaton. A tick is beginTick, then beginPhase for each phase (which ends the one before), then
+  // endTick with what it did.
+  void beginTick();
+  void beginPhase(Phase phase);
+  void endTick(long long generation, long long generations, std::size_t chunkCount, const Counters& counters);
+  
+  // Get the kept ticks, oldest first.
+  std::vector<Tick> ticks() const;
+  
+  // Add up the kept ticks which started within window of now, for sampling a running automaton: generations / span
+  // is the rate, and busy / span how much of the time went on ticking. Only goes through those ticks.
+  Summary summarize(std::chrono::nanoseconds window) const;
+  
+  // Forget the kept ticks.
+  void clear();
+  
+  // Write the kept ticks as a Chrome trace-event JSON document: a complete event per tick with what it did as its
+  // arguments, one per phase inside it, and a counter of the chunks present.
+  void writeChromeTrace(std::ostream& out) const;
+  
+  // Write each tick to csv as a row as soon as it's recorded, after writing the header now; nullptr stops. The stream
+  // must outlive the profiler or be replaced first.
+  void setCsvOutput(std::ostream* csv);
+  
+  static constexpr std::size_t DEFAULT_CAPACITY = 10000;
+  
+private:
+  typedef std::chrono::steady_clock Clock;
+  
+  // Write tick as a CSV row.
+  static void writeCsvRow(std::ostream& out, const Tick& tick);
+  
+  // Get the time since epoch_.
+  std::chrono::nanoseconds sinceEpoch() const;
+  
+  const Clock::time_point epoch_ = Clock::now();
+  
+  // The tick being recorded; only touched by the thread ticking
+  Tick current_;
+  int currentPhase_ = -1; // the Phase running, or -1 for none
+  
+  mutable std::mutex mutex_; // guards everything below
+  std::vector<Tick> ticks_; // the kept ticks, oldest at next_ once it's full
+  std::size_t capacity_;
+  std::size_t next_ = 0; // where the next tick goes
+  std::ostream* csv_ = nullptr;
+};
+
+#endif //GAME_OF_LIFE_TICKPROFILER_H
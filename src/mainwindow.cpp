@@ -1,11 +1,14 @@
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdio>
-#include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
 
 #include <QAction>
 #include <QDialog>
+#include <QMessageBox>
 #include <QString>
 
 #include "mainwindow.h"
@@ -22,8 +25,12 @@
 // Dear future me who knows to avoid tight coupling and other cool software engineering patterns: I'm sorry
 
 constexpr int MainWindow::MAX_PLAY_DELAY;
+constexpr int MainWindow::FRAME_INTERVAL;
+constexpr int MainWindow::MAX_STEP_SIZE;
+constexpr int MainWindow::PERFORMANCE_INTERVAL;
+constexpr int MainWindow::PERFORMANCE_WINDOW;
 
-MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui_(new Ui::MainWindow), tickTimer_(new QTimer(this)),
+MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui_(new Ui::MainWindow), frameTimer_(new QTimer(this)),
     // default is unbounded topology with radius-1 Moore neighbourhood (Life setup)
     automaton_(new Automaton(new UnboundedTopology,
         new MooreNeighbourhoodType(1))) {
@@ -32,6 +39,9 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui_(new Ui::MainW
   automaton_->ruleset().setBornWith(3, true);
   automaton_->ruleset().setSurvivesWith(2, true);
   automaton_->ruleset().setSurvivesWith(3, true);
+  simulation_ = new Simulation(automaton_); // from here on, the automaton belongs to its thread
+  simulation_->setStepDelay(std::chrono::milliseconds(playDelay_));
+  simulation_->setFrameInterval(std::chrono::milliseconds(FRAME_INTERVAL)); // no point publishing faster than we look
   
   ui_->setupUi(this);
   QMainWindow::centralWidget()->layout()->setContentsMargins(0, 0, 0, 0); // make it flush
@@ -45,11 +55,22 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui_(new Ui::MainW
   ui_->toolBar->insertWidget(ui_->actionPause, speedSlider_);
   connect(speedSlider_, &QSlider::valueChanged, this, &MainWindow::updatePlaySpeed);
   
+  // how many generations go by between frames; 0 is as many as the CPU can get through in one
+  stepSizeBox_ = new QSpinBox(ui_->toolBar);
+  stepSizeBox_->setRange(0, MAX_STEP_SIZE);
+  stepSizeBox_->setValue(1);
+  stepSizeBox_->setSpecialValueText("Max");
+  stepSizeBox_->setSuffix(" gen/step");
+  stepSizeBox_->setToolTip("Generations per step (Max: as many as fit in a frame)");
+  ui_->toolBar->insertWidget(ui_->actionPause, stepSizeBox_);
+  connect(stepSizeBox_, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this,
+      &MainWindow::updateStepSize);
+  
   scene_ = new AutomatonScene(automaton_, this);
   ui_->graphics->setScene(scene_);
-  connect(scene_, &AutomatonScene::cellUpdated, this, &MainWindow::updateStatusBar);
-  
-  connectAutomaton();
+  connect(scene_, &AutomatonScene::cellClicked, this, [this] (int x, int y) {
+    simulation_->edit(x, y, Simulation::Edit::TOGGLE);
+  });
   
   connect(ui_->actionNextGeneration, &QAction::triggered, this, &MainWindow::nextGeneration);
   connect(ui_->actionPlay, &QAction::triggered, this, &MainWindow::play);
@@ -58,7 +79,9 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui_(new Ui::MainW
   connect(ui_->actionChangeRules, &QAction::triggered, this, &MainWindow::launchChangeRulesDialog);
   connect(ui_->actionChangeNeighbourhood, &QAction::triggered, this, &MainWindow::launchChangeNeighbourhoodTypeDialog);
   connect(ui_->actionChangeTopology, &QAction::triggered, this, &MainWindow::launchChangeTopologyDialog);
+  connect(ui_->actionUseHashLife, &QAction::triggered, this, &MainWindow::toggleHashLife);
   connect(ui_->actionShowChunkBoundaries, &QAction::triggered, this, &MainWindow::toggleChunkBoxes);
+  connect(ui_->actionShowPerformance, &QAction::triggered, this, &MainWindow::togglePerformance);
   
   // make all the theme actions mutually exclusive via a QActionGroup
   themeGroup_ = new QActionGroup(this);
@@ -102,26 +125,38 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui_(new Ui::MainW
   }
 #endif
   
+  // the performance panel is hidden until asked for, and nothing is profiled until then
+  performanceLabel_ = new QLabel(this);
+  performanceLabel_->setVisible(false);
+  statusBar()->addPermanentWidget(performanceLabel_);
+  performanceTimer_ = new QTimer(this);
+  connect(performanceTimer_, &QTimer::timeout, this, &MainWindow::updatePerformance);
+  
   ui_->actionPause->setEnabled(false);
-  connect(tickTimer_, &QTimer::timeout, this, &MainWindow::nextGeneration);
+  connect(frameTimer_, &QTimer::timeout, this, &MainWindow::showFrame);
+  frameTimer_->setTimerType(Qt::PreciseTimer); // a steady frame rate, rather than one within 5% either way
+  frameTimer_->start(FRAME_INTERVAL);
   
   updateStatusBar();
-  
-  // Add one chunk at (0, 0) to ward off QGraphicsView weirdness
-  automaton_->chunkArray().insertOrNoop(0, 0);
 }
 
 MainWindow::~MainWindow() {
-  // We don't delete all the ChunkGraphicsItems here because when we delete automaton_, the ChunkArray is destructed,
-  // which emits a chunkRemoved signal for each chunk, which is connected to removeChunkGraphicsItem, which deletes
-  // all the items.
-  tickTimer_->stop();
-  delete tickTimer_;
-  tickTimer_ = nullptr;
+  frameTimer_->stop();
+  delete frameTimer_;
+  frameTimer_ = nullptr;
+  performanceTimer_->stop();
+  delete performanceTimer_;
+  performanceTimer_ = nullptr;
+  delete performanceLabel_;
+  performanceLabel_ = nullptr;
   delete speedSlider_;
   speedSlider_ = nullptr;
+  delete stepSizeBox_;
+  stepSizeBox_ = nullptr;
   delete themeGroup_;
   themeGroup_ = nullptr;
+  delete simulation_; // stops its thread, so it's done with automaton_ and profiler_
+  simulation_ = nullptr;
   delete automaton_;
   automaton_ = nullptr;
   delete scene_;
@@ -130,70 +165,53 @@ MainWindow::~MainWindow() {
   ui_ = nullptr;
 }
 
-void MainWindow::addChunkGraphicsItem(int x, int y) {
-  std::pair<int, int> xy(x, y);
-  if (chunkGIMap_.count(xy)) {
-    // this is bad, chunkGIMap_ isn't properly sync'd with the ChunkArray
-    std::cerr << "MainWindow's map of ChunkGraphicsItems is out of sync with ChunkArray: trying to add "
-                 "ChunkGraphicsItem at (" << x << ", " << y << "), but it's already there! Removing and re-adding."
-                 << std::endl;
-    chunkGIMap_.erase(xy);
-  }
-  auto* item = new ChunkGraphicsItem(automaton_->chunkArray().at(x, y));
-  scene_->addItem(item);
-  chunkGIMap_.emplace(xy, item);
-}
-
-void MainWindow::removeChunkGraphicsItem(int x, int y) {
-  std::pair<int, int> xy(x, y);
-  if (!chunkGIMap_.count(xy)) {
-    // also bad + out of sync
-    std::cerr << "MainWindow's map of ChunkGraphicsItems is out of sync with ChunkArray: trying to remove "
-                 "ChunkGraphicsItem at (" << x << ", " << y << "), but there isn't one there!" << std::endl;
-    return;
-  }
-  ChunkGraphicsItem* item = chunkGIMap_.at(xy);
-  scene_->removeItem(item);
-  delete item;
-  chunkGIMap_.erase(xy);
+void MainWindow::showFrame() {
+  if (!simulation_->takeFrame(frame_)) return;
+  scene_->applyFrame(frame_);
+  // the automaton drops HashLife by itself if the rules change to ones it can't run
+  ui_->actionUseHashLife->setChecked(frame_.engine == Automaton::Engine::HASHLIFE);
+  updateStatusBar();
 }
 
 void MainWindow::nextGeneration() {
-  automaton_->tick();
-  updateStatusBar();
+  simulation_->step();
 }
 
 void MainWindow::play() {
-  tickTimer_->start(playDelay_);
+  simulation_->play();
   ui_->actionPlay->setEnabled(false);
   ui_->actionNextGeneration->setEnabled(false);
   ui_->actionPause->setEnabled(true);
 }
 
 void MainWindow::pause() {
-  tickTimer_->stop();
+  simulation_->pause();
   ui_->actionPause->setEnabled(false);
   ui_->actionPlay->setEnabled(true);
   ui_->actionNextGeneration->setEnabled(true);
 }
 
 void MainWindow::reset() {
-  // Stop the timer, reset the automaton, and re-add chunk (0, 0) to avoid bugging out
+  // Stop playing and reset the automaton
   pauseIfRunning();
+  Simulation::AutomatonLock lock(*simulation_);
   automaton_->reset();
-  automaton_->chunkArray().insertOrNoop(0, 0);
-  updateStatusBar();
 }
 
 void MainWindow::updatePlaySpeed(int value) { // 0 <= value <= 1000
   // We decompose according to the following formula: delay = MAX_PLAY_DELAY(1 - value/1000)^2
   double valuePct = value / 1000.0;
   playDelay_ = (int) (MAX_PLAY_DELAY*(1-valuePct)*(1-valuePct));
-  tickTimer_->setInterval(playDelay_);
+  simulation_->setStepDelay(std::chrono::milliseconds(playDelay_));
+}
+
+void MainWindow::updateStepSize(int value) { // 0 <= value <= MAX_STEP_SIZE
+  simulation_->setStepSize((unsigned long long) value);
 }
 
 void MainWindow::launchChangeRulesDialog() {
   pauseIfRunning();
+  Simulation::AutomatonLock lock(*simulation_); // for as long as the dialog is open
   RulesDialog dialog(automaton_->ruleset(), this);
   dialog.setModal(true);
   dialog.exec();
@@ -201,6 +219,7 @@ void MainWindow::launchChangeRulesDialog() {
 
 void MainWindow::launchChangeNeighbourhoodTypeDialog() {
   pauseIfRunning();
+  Simulation::AutomatonLock lock(*simulation_);
   NeighbourhoodDialog dialog(automaton_->ruleset().getNeighbourhoodType(), automaton_, this);
   dialog.setModal(true);
   dialog.exec();
@@ -208,6 +227,7 @@ void MainWindow::launchChangeNeighbourhoodTypeDialog() {
 
 void MainWindow::launchChangeTopologyDialog() {
   pauseIfRunning();
+  Simulation::AutomatonLock lock(*simulation_);
   TopologyDialog dialog(*automaton_, this);
   connect(&dialog, &TopologyDialog::automatonUpdated, this, &MainWindow::updateAutomaton);
   dialog.setModal(true);
@@ -215,11 +235,25 @@ void MainWindow::launchChangeTopologyDialog() {
 }
 
 void MainWindow::updateAutomaton(Automaton* newAutomaton) {
-  delete automaton_; // will remove all the ChunkGraphicsItems
+  simulation_->setAutomaton(newAutomaton); // the next frame replaces all of the old automaton's chunks
+  delete automaton_;
   automaton_ = newAutomaton;
   scene_->updateAutomaton(automaton_);
-  connectAutomaton(); // *must* go before inserting any chunks
-  automaton_->chunkArray().insertOrNoop(0, 0); // prevent buggy behaviour when there's no chunks
+  ui_->actionUseHashLife->setChecked(false); // new automata never start on HashLife
+}
+
+void MainWindow::toggleHashLife(bool enabled) {
+  Simulation::AutomatonLock lock(*simulation_);
+  if (!enabled && automaton_->engine() != Automaton::Engine::HASHLIFE) {
+    return; // leave the grid engine alone
+  }
+  try {
+    automaton_->setEngine(enabled ? Automaton::Engine::HASHLIFE : Automaton::Engine::CHUNKS);
+  } catch (std::invalid_argument&) {
+    ui_->actionUseHashLife->setChecked(false);
+    QMessageBox::warning(this, tr("HashLife"), tr("HashLife can only run Moore radius 1 rules in which cells "
+        "aren't born with 0 neighbours, in an unbounded topology."));
+  }
 }
 
 void MainWindow::toggleChunkBoxes() {
@@ -233,19 +267,59 @@ void MainWindow::setTheme(GraphicsProperties::Theme theme) {
   scene_->update();
 }
 
-void MainWindow::connectAutomaton() {
-  connect(&automaton_->chunkArray(), &ChunkArray::chunkAdded, this, &MainWindow::addChunkGraphicsItem);
-  connect(&automaton_->chunkArray(), &ChunkArray::chunkRemoved, this, &MainWindow::removeChunkGraphicsItem);
-}
-
 void MainWindow::pauseIfRunning() {
-  if (tickTimer_->isActive()) {
+  if (simulation_->playing()) {
     pause();
   }
 }
 
 void MainWindow::updateStatusBar() const {
   statusBar()->showMessage(
-      tr("Generation:") + " " + QString::number(automaton_->generation()) + " | "
-      + tr("Population:") + " " + QString::number(automaton_->population()));
+      tr("Generation:") + " " + QString::number(frame_.generation) + " | "
+      + tr("Population:") + " " + QString::number(frame_.population));
+}
+
+void MainWindow::togglePerformance(bool shown) {
+  simulation_->setProfiler(shown ? &profiler_ : nullptr);
+  performanceLabel_->setVisible(shown);
+  if (!shown) {
+    performanceTimer_->stop();
+    return;
+  }
+  
+  // Start afresh, so the first sample isn't of whenever the panel was last shown
+  profiler_.clear();
+  qint64 nanoseconds;
+  int paints;
+  scene_->automatonItem().takePaintTime(nanoseconds, paints);
+  performanceClock_.start();
+  performanceTimer_->start(PERFORMANCE_INTERVAL);
+  updatePerformance();
+}
+
+void MainWindow::updatePerformance() {
+  // The simulation's side: how fast it's going, and how much of the time it spends ticking (near 100% means it can't
+  // go any faster)
+  TickProfiler::Summary summary = profiler_.summarize(std::chrono::milliseconds(PERFORMANCE_WINDOW));
+  double span = std::chrono::duration<double>(summary.span).count();
+  double busy = std::chrono::duration<double>(summary.busy).count();
+  double generationsPerSecond = span > 0 ? summary.generations / span : 0;
+  double msPerTick = summary.ticks > 0 ? 1000 * busy / summary.ticks : 0;
+  
+  // The drawing side: how long a paint takes, and how much of the time goes on painting
+  qint64 paintNanoseconds;
+  int paints;
+  scene_->automatonItem().takePaintTime(paintNanoseconds, paints);
+  qint64 elapsed = std::max(performanceClock_.restart(), (qint64) 1);
+  double msPerPaint = paints > 0 ? paintNanoseconds / 1e6 / paints : 0;
+  
+  double mebibytes = (frame_.memoryUsage + scene_->automatonItem().memoryUsage()) / (1024.0 * 1024.0);
+  performanceLabel_->setText(
+      QString::number(generationsPerSecond, 'f', 0) + " " + tr("gen/s") + " | "
+      + QString::number(msPerTick, 'f', 3) + " " + tr("ms/tick") + " ("
+      + QString::number(span > 0 ? 100 * busy / span : 0, 'f', 0) + "% " + tr("busy") + ") | "
+      + QString::number(msPerPaint, 'f', 2) + " " + tr("ms/paint") + " ("
+      + QString::number(paintNanoseconds / 1e4 / elapsed, 'f', 0) + "% " + tr("busy") + ") | "
+      + QString::number((qulonglong) frame_.chunkCount) + " " + tr("chunks") + " | "
+      + QString::number(mebibytes, 'f', 1) + " " + tr("MiB"));
 }
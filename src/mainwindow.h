@@ -1,26 +1,24 @@
 #ifndef GAME_OF_LIFE_MAINWINDOW_H
 #define GAME_OF_LIFE_MAINWINDOW_H
 
-#include <unordered_map>
-#include <utility>
-
 #include <QActionGroup>
+#include <QElapsedTimer>
 #include <QGraphicsItem>
+#include <QLabel>
 #include <QMainWindow>
 #include <QSlider>
+#include <QSpinBox>
 #include <QTimer>
 #include <QWidget>
 
 #include "Automaton.h"
 #include "AutomatonScene.h"
-#include "ChunkGraphicsItem.h"
 #include "GraphicsProperties.h"
-#include "util.h"
+#include "Simulation.h"
+#include "TickProfiler.h"
 
 // TODO Separate UI from model via file structure, also figure out namespaces
-// TODO Put the model on a separate thread from the UI
 // TODO Add "painting" live cells
-// TODO Allow scrolling beyond edge of ChunkGraphicsItems - https://stackoverflow.com/q/19207153?
 
 namespace Ui {
   class MainWindow; // Qt will fill this in from mainwindow.ui
@@ -35,44 +33,53 @@ public:
   ~MainWindow() override;
   
 public slots:
-  void addChunkGraphicsItem(int x, int y);
-  void removeChunkGraphicsItem(int x, int y);
-  
   // Handle all the messy parts of updating the automaton to a new one passed here.
   void updateAutomaton(Automaton* newAutomaton);
   
 private slots:
+  void showFrame(); // show the latest frame from the simulation, if there's a new one
   void nextGeneration();
   void play();
   void pause();
   void reset();
   void updatePlaySpeed(int value);
+  void updateStepSize(int value);
   
   void launchChangeRulesDialog();
   void launchChangeNeighbourhoodTypeDialog();
   void launchChangeTopologyDialog();
   
+  void toggleHashLife(bool enabled);
   void toggleChunkBoxes();
+  void togglePerformance(bool shown);
+  void updatePerformance(); // sample the profiler and the paint times into the performance panel
   
 private:
   void setTheme(GraphicsProperties::Theme theme);
   
-  void connectAutomaton(); // setup connections between the MainWindow and automaton_
   void pauseIfRunning();
-  void updateStatusBar() const; // Update "Generation: X" in the status bar
+  void updateStatusBar() const; // Update "Generation: X" in the status bar, from the last frame shown
   
-  static constexpr int MAX_PLAY_DELAY = 400; // min is 0; time in ms between updates when playing
+  static constexpr int MAX_PLAY_DELAY = 400; // min is 0; time in ms between ticks when playing
+  static constexpr int FRAME_INTERVAL = 16; // time in ms between looking for new frames, for about 60 a second
+  static constexpr int PERFORMANCE_INTERVAL = 500; // time in ms between updates of the performance panel
+  static constexpr int PERFORMANCE_WINDOW = 1000; // time in ms the performance panel averages the ticks over
+  static constexpr int MAX_STEP_SIZE = 1 << 20; // most generations per step the step size box goes up to
   int playDelay_ = 200;
   
   Ui::MainWindow* ui_;
   AutomatonScene* scene_; // where we draw the actual automaton
-  Automaton* automaton_; // the model itself
-  QTimer* tickTimer_; // for playing
+  Automaton* automaton_; // the model itself; only touch it under a Simulation::AutomatonLock
+  Simulation* simulation_; // runs automaton_ on a thread of its own
+  QTimer* frameTimer_; // for showing frames as they come
   QSlider* speedSlider_; // for controlling play speed
+  QSpinBox* stepSizeBox_; // for controlling how many generations each step advances
   QActionGroup* themeGroup_; // make the theme actions mutually exclusive
-  
-  // Analogous to ChunkArray's map, but for ChunkGraphicsItems
-  std::unordered_map<std::pair<int, int>, ChunkGraphicsItem*, pair_hash> chunkGIMap_;
+  Simulation::Frame frame_; // the last frame shown, kept so its vectors aren't reallocated every frame
+  TickProfiler profiler_; // records the ticks while the performance panel is shown
+  QLabel* performanceLabel_; // the performance panel, in the status bar
+  QTimer* performanceTimer_; // for updating the performance panel
+  QElapsedTimer performanceClock_; // the time since the performance panel was last updated
 };
 
 #endif //GAME_OF_LIFE_MAINWINDOW_H
@@ -1,18 +1,101 @@
 #ifndef GAME_OF_LIFE_UTIL_H
 #define GAME_OF_LIFE_UTIL_H
 
-#include <utility>
-#include <functional>
-
-// template hash function for std::pair for use in maps, works with all types defined in <functional>
-struct pair_hash {
-  template<typename A, typename B>
-  std::size_t operator()(const std::pair<A, B>& pair) const {
-    std::size_t hash = std::hash<A>()(pair.first);
-    // this magic is used to combine the hashes from the first and second elements
-    // apparently, it's better than a simple xor; this implementation is from boost
-    return hash ^ (std::hash<B>()(pair.second) + 0x9e3779b9 + (hash<<6u) + (hash>>2u));
-  }
-};
+#include <cstddef>
+#include <cstdint>
+
+// count the set bits in a 64-bit word; used for the populations of bit-packed rows
+inline int popcount(std::uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(bits);
+#else
+  int count = 0;
+  for (; bits; bits &= bits - 1) count++; // clear the lowest set bit until there are none left
+  return count;
+#endif
+}
+
+// count the zero bits below the lowest set bit of a 64-bit word, which mustn't be 0; used to find runs of live cells
+inline int countTrailingZeros(std::uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(bits);
+#else
+  int count = 0;
+  for (; (bits & 1u) == 0; bits >>= 1u) count++;
+  return count;
+#endif
+}
+
+// add three words bit by bit: sum gets the ones bit of each column's total and carry gets the twos bit; used to count
+// the neighbours of a whole packed row at once
+inline void fullAdd(std::uint64_t a, std::uint64_t b, std::uint64_t c, std::uint64_t& sum, std::uint64_t& carry) {
+  std::uint64_t partial = a ^ b;
+  sum = partial ^ c;
+  carry = (a & b) | (partial & c);
+}
+
+// spread the bits of value out to the even bits of a 64-bit word, for Morton codes
+inline std::uint64_t spreadBits(std::uint32_t value) {
+  std::uint64_t bits = value;
+  bits = (bits | bits << 16u) & 0x0000FFFF0000FFFFull;
+  bits = (bits | bits << 8u) & 0x00FF00FF00FF00FFull;
+  bits = (bits | bits << 4u) & 0x0F0F0F0F0F0F0F0Full;
+  bits = (bits | bits << 2u) & 0x3333333333333333ull;
+  bits = (bits | bits << 1u) & 0x5555555555555555ull;
+  return bits;
+}
+
+// the inverse of spreadBits: gather the even bits of a 64-bit word back together
+inline std::uint32_t gatherBits(std::uint64_t bits) {
+  bits &= 0x5555555555555555ull;
+  bits = (bits | bits >> 1u) & 0x3333333333333333ull;
+  bits = (bits | bits >> 2u) & 0x0F0F0F0F0F0F0F0Full;
+  bits = (bits | bits >> 4u) & 0x00FF00FF00FF00FFull;
+  bits = (bits | bits >> 8u) & 0x0000FFFF0000FFFFull;
+  bits = (bits | bits >> 16u) & 0x00000000FFFFFFFFull;
+  return (std::uint32_t) bits;
+}
+
+// pack a pair of coordinates into one Morton code: x in the even bits and y in the odd bits, each offset by 2^31 so
+// they're unsigned, so coordinates near each other get codes near each other
+inline std::uint64_t packCoordinates(int x, int y) {
+  return spreadBits((std::uint32_t) x ^ 0x80000000u) | spreadBits((std::uint32_t) y ^ 0x80000000u) << 1u;
+}
+
+// get x and y back out of packCoordinates(x, y)
+inline int unpackX(std::uint64_t key) {
+  return (int) (gatherBits(key) ^ 0x80000000u);
+}
+inline int unpackY(std::uint64_t key) {
+  return (int) (gatherBits(key >> 1u) ^ 0x80000000u);
+}
+
+// the number of shards hashShard picks from, which every table sharded by hash has
+constexpr std::size_t HASH_SHARDS = 16;
+
+// move a hash of rows of cells on by the next row, starting from 0; rows move the hash on in turn, so their order
+// matters. Used for chunks' generations in ChunkStateTable, and for chunks with their halo in ChunkMemo
+inline std::uint64_t hashRow(std::uint64_t hash, std::uint64_t row) {
+  return (hash ^ row) * 0x9E3779B97F4A7C15ull;
+}
+
+// pick which of HASH_SHARDS shards of a table a hash of rows goes in, by its top bits, which hashRow mixes the most
+inline std::size_t hashShard(std::uint64_t hash) {
+  return (std::size_t) (hash >> 60u);
+}
+static_assert(HASH_SHARDS == 16, "hashShard picks a shard by the top 4 bits of a hash");
+
+// pick which of a shard's bucketCount buckets, a power of two, a hash of rows goes in: the shards have the top bits, so
+// the buckets have the middle
+inline std::size_t hashBucket(std::uint64_t hash, std::size_t bucketCount) {
+  return (std::size_t) (hash >> 28u) & (bucketCount - 1);
+}
+
+// divide, rounding towards negative infinity rather than zero; used to find which chunk a cell is in
+template<typename T>
+inline T floorDiv(T dividend, T divisor) {
+  T quotient = dividend / divisor;
+  return quotient - (dividend % divisor != 0 && (dividend < 0) != (divisor < 0) ? 1 : 0);
+}
 
 #endif //GAME_OF_LIFE_UTIL_H
@@ -0,0 +1,95 @@
+#ifndef GAME_OF_LIFE_TEST_HELPERS_H
+#define GAME_OF_LIFE_TEST_HELPERS_H
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/Automaton.h"
+
+// What the test programs share: making the automata they check, reading their cells back out and running their checks.
+// Each check prints what went wrong if it fails; the runner prints the name of each check before it runs, and how many
+// failed at the end.
+
+typedef std::set<std::pair<int, int>> Cells;
+
+const int TEST_WIDTH = 4, TEST_HEIGHT = 3; // of the bounded topologies the tests use, in chunks
+
+enum class Shape { UNBOUNDED, FIXED, WRAPPING };
+
+// Make the topology of shape, TEST_WIDTH by TEST_HEIGHT chunks if it's bounded.
+inline Topology* makeTopology(Shape shape) {
+  switch (shape) {
+    case Shape::UNBOUNDED: return new UnboundedTopology;
+    case Shape::FIXED: return new FixedTopology(TEST_WIDTH, TEST_HEIGHT);
+    default: return new WrappingTopology(TEST_WIDTH, TEST_HEIGHT);
+  }
+}
+
+inline NeighbourhoodType* makeNeighbourhoodType(bool vonNeumann, int radius) {
+  if (vonNeumann) {
+    return new VonNeumannNeighbourhoodType(radius);
+  }
+  return new MooreNeighbourhoodType(radius);
+}
+
+// Get every live cell in the automaton's chunks.
+inline Cells liveCells(Automaton& automaton) {
+  Cells cells;
+  for (const auto& entry : automaton.chunkArray()) {
+    for (int y = 0; y < CHUNK_SIZE; y++) {
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        if (entry.value->getCell(x, y)) cells.insert({entry.x() * CHUNK_SIZE + x, entry.y() * CHUNK_SIZE + y});
+      }
+    }
+  }
+  return cells;
+}
+
+// Runs a test program's checks, printing the name of each and counting the ones which fail.
+class TestRunner {
+public:
+  // Print name and run check(), which returns whether it passed.
+  template<typename Check>
+  void run(const std::string& name, Check check) {
+    std::cout << name << "\n";
+    if (!check()) failures_++;
+  }
+  
+  // Run check(run, seed) on each case, which has a name, giving each a seed of its own for anything random.
+  template<typename Case, typename Check>
+  void runCases(const std::vector<Case>& cases, Check check) {
+    for (const Case& run : cases) {
+      unsigned int seed = nextSeed();
+      this->run(run.name, [&] { return check(run, seed); });
+    }
+  }
+  
+  // Get a seed no other check has had.
+  unsigned int nextSeed() noexcept {
+    return seed_++;
+  }
+  
+  // Count a failure found outside any one check, once it's been printed.
+  void fail() noexcept {
+    failures_++;
+  }
+  
+  // Print how many checks failed, if any did, and return the exit status for main.
+  int finish() const {
+    if (failures_ != 0) {
+      std::cout << failures_ << " failed\n";
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+private:
+  int failures_ = 0;
+  unsigned int seed_ = 1;
+};
+
+#endif //GAME_OF_LIFE_TEST_HELPERS_H